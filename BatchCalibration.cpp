@@ -0,0 +1,359 @@
+#include "Calibration.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QTime>
+
+#include <vnl/vnl_quaternion.h>
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+/*
+  Headless probe calibration, runs Calibration.h on point, rotation and translation files.
+
+  Usage: BatchCalibration [options] pointsFile rotationsFile translationsFile [outputFile]
+         BatchCalibration [options] -batch sessionsFile
+
+  pointsFile        one line per image with the crosswire pixel "x y"
+  rotationsFile     one line per image with the tracker quaternion "w x y z"
+  translationsFile  one line per image with the tracker translation "x y z"
+  outputFile        the 8 parameters in the format saved by ProbeCalibrationWidget.h
+  sessionsFile      one session per line "pointsFile rotationsFile translationsFile [outputFile]"
+
+  Options:
+  -ransac threshold   reject outlier images, threshold in mm
+  -iterations n       maximum RANSAC hypotheses
+  -threads n          sessions calibrated at the same time
+
+  One CSV line is printed for each session, in the order of the sessions file, with the
+  parameters, the number of inliers and the distance in mm from each mapped crosswire point
+  to the estimated crosswire position.
+*/
+
+/** A calibration session and its result */
+struct CalibrationSession
+{
+	QString pointsFilename;
+	QString rotationsFilename;
+	QString translationsFilename;
+	QString outputFilename;
+
+	bool ok;
+	QString error;
+	int images;
+	int inliers;
+	int time;
+	std::vector<double> parameters;
+	double rmsResidual;
+	double maxResidual;
+};
+
+/** Reads a file with one row of numbers per line */
+bool readMatrix(QString filename, int columns, std::vector< std::vector<double> > &rows)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QTextStream stream(&file);
+	while (!stream.atEnd())
+	{
+		QStringList lineList = stream.readLine().split(" ", QString::SkipEmptyParts);
+		if (lineList.isEmpty())
+			continue;
+		if (lineList.size() < columns)
+			return false;
+
+		std::vector<double> row;
+		for (int j = 0; j < columns; j++)
+			row.push_back(lineList.at(j).toDouble());
+		rows.push_back(row);
+	}
+
+	file.close();
+	return true;
+}
+
+/** Calibrates one session */
+class CalibrationSessionTask : public QRunnable
+{
+public:
+
+	CalibrationSessionTask(CalibrationSession *session, double threshold, int iterations, int threads)
+		: session(session), threshold(threshold), iterations(iterations), threads(threads)
+	{
+	}
+
+	void run()
+	{
+		QTime timer;
+		timer.start();
+
+		session->ok = false;
+		session->images = 0;
+		session->inliers = 0;
+		session->rmsResidual = 0;
+		session->maxResidual = 0;
+
+		std::vector< std::vector<double> > points;
+		std::vector< std::vector<double> > rotations;
+		std::vector< std::vector<double> > translations;
+
+		if (!readMatrix(session->pointsFilename, 2, points))
+			session->error = "could not read points";
+		else if (!readMatrix(session->rotationsFilename, 4, rotations))
+			session->error = "could not read rotations";
+		else if (!readMatrix(session->translationsFilename, 3, translations))
+			session->error = "could not read translations";
+		else if (points.size() != rotations.size() || points.size() != translations.size())
+			session->error = "different number of points and poses";
+
+		if (!session->error.isEmpty())
+			return;
+
+		session->images = points.size();
+
+		Calibration *calibrator = Calibration::New();
+		calibrator->SetVerbose(false);
+
+		// the same transformations ProbeCalibrationWidget::calibrate() gives to the calibrator
+		std::vector< vnl_matrix<double> > rotationMatrices;
+		for (int i = 0; i < session->images; i++)
+		{
+			vnl_quaternion<double> quaternion(rotations[i][1], rotations[i][2], rotations[i][3], rotations[i][0]);
+			vnl_matrix<double> rotation = quaternion.rotation_matrix_transpose();
+			rotation = rotation.transpose();
+			rotationMatrices.push_back(rotation);
+
+			vnl_vector<double> translation(3);
+			translation[0] = translations[i][0];
+			translation[1] = translations[i][1];
+			translation[2] = translations[i][2];
+
+			double p[2] = {points[i][0], points[i][1]};
+
+			calibrator->InsertTransformations(rotation, translation);
+			calibrator->InsertImagePoints(p);
+		}
+
+		std::vector<bool> inliers(session->images, true);
+
+		if (threshold > 0)
+		{
+			calibrator->SetInlierThreshold(threshold);
+			calibrator->SetMaximumIterations(iterations);
+			calibrator->SetNumberOfThreads(threads);
+			calibrator->CalibrateRANSAC();
+			inliers = calibrator->getInliers();
+		}
+		else
+		{
+			calibrator->Calibrate();
+		}
+
+		session->parameters = calibrator->getEstimatedUSCalibrationParameters();
+		delete calibrator;
+
+		if (session->parameters.size() < 11)
+		{
+			session->error = "degenerate configuration";
+			return;
+		}
+
+		// distance from each crosswire point mapped by the calibration and the tracker to t1
+		std::vector<double> &q = session->parameters;
+		vnl_quaternion<double> calibrationQuaternion(q[8], q[7], q[6]);
+		vnl_matrix<double> calibrationRotation = calibrationQuaternion.rotation_matrix_transpose();
+		calibrationRotation = calibrationRotation.transpose();
+
+		double sumSquares = 0;
+		for (int i = 0; i < session->images; i++)
+		{
+			if (!inliers[i])
+				continue;
+
+			vnl_vector<double> imagePoint(3);
+			imagePoint[0] = q[9]*points[i][0];
+			imagePoint[1] = q[10]*points[i][1];
+			imagePoint[2] = 0;
+
+			vnl_vector<double> probePoint = calibrationRotation*imagePoint;
+			probePoint[0] += q[3];
+			probePoint[1] += q[4];
+			probePoint[2] += q[5];
+
+			vnl_vector<double> trackerPoint = rotationMatrices[i]*probePoint;
+
+			double squareDistance = 0;
+			for (int d = 0; d < 3; d++)
+			{
+				double difference = trackerPoint[d] + translations[i][d] - q[d];
+				squareDistance += difference*difference;
+			}
+
+			sumSquares += squareDistance;
+			session->maxResidual = std::max(session->maxResidual, sqrt(squareDistance));
+			session->inliers++;
+		}
+
+		session->rmsResidual = sqrt(sumSquares/session->inliers);
+		session->time = timer.elapsed();
+		session->ok = true;
+
+		if (!session->outputFilename.isEmpty())
+		{
+			QFile file(session->outputFilename);
+			if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+			{
+				session->error = "could not write output";
+				return;
+			}
+
+			QTextStream out(&file);
+			for (int j = 3; j < 11; j++)
+				out<<q[j]<<"\n";
+			file.close();
+		}
+	}
+
+private:
+
+	CalibrationSession *session;
+	double threshold;
+	int iterations;
+	int threads;
+};
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList arguments = app.arguments();
+
+	double threshold = 0;
+	int iterations = 1000;
+	int threads = QThread::idealThreadCount();
+	QString sessionsFilename;
+	QStringList files;
+
+	for (int i = 1; i < arguments.size(); i++)
+	{
+		if (arguments.at(i) == "-ransac" && i + 1 < arguments.size())
+			threshold = arguments.at(++i).toDouble();
+		else if (arguments.at(i) == "-iterations" && i + 1 < arguments.size())
+			iterations = arguments.at(++i).toInt();
+		else if (arguments.at(i) == "-threads" && i + 1 < arguments.size())
+			threads = std::max(1, arguments.at(++i).toInt());
+		else if (arguments.at(i) == "-batch" && i + 1 < arguments.size())
+			sessionsFilename = arguments.at(++i);
+		else
+			files.append(arguments.at(i));
+	}
+
+	std::vector<CalibrationSession> sessions;
+
+	if (!sessionsFilename.isEmpty())
+	{
+		QFile file(sessionsFilename);
+		if (!file.open(QIODevice::ReadOnly))
+		{
+			std::cerr<<"Could not open "<<sessionsFilename.toAscii().data()<<std::endl;
+			return 1;
+		}
+
+		QTextStream stream(&file);
+		while (!stream.atEnd())
+		{
+			QStringList lineList = stream.readLine().split(" ", QString::SkipEmptyParts);
+			if (lineList.size() < 3)
+				continue;
+
+			CalibrationSession session;
+			session.pointsFilename = lineList.at(0);
+			session.rotationsFilename = lineList.at(1);
+			session.translationsFilename = lineList.at(2);
+			if (lineList.size() > 3)
+				session.outputFilename = lineList.at(3);
+			sessions.push_back(session);
+		}
+		file.close();
+	}
+	else if (files.size() >= 3)
+	{
+		CalibrationSession session;
+		session.pointsFilename = files.at(0);
+		session.rotationsFilename = files.at(1);
+		session.translationsFilename = files.at(2);
+		if (files.size() > 3)
+			session.outputFilename = files.at(3);
+		sessions.push_back(session);
+	}
+	else
+	{
+		std::cerr<<"Usage: "<<argv[0]<<" [-ransac threshold] [-iterations n] [-threads n]"
+			<<" pointsFile rotationsFile translationsFile [outputFile]"<<std::endl;
+		std::cerr<<"       "<<argv[0]<<" [-ransac threshold] [-iterations n] [-threads n]"
+			<<" -batch sessionsFile"<<std::endl;
+		return 1;
+	}
+
+	QTime timer;
+	timer.start();
+
+	// the sessions run in parallel, each RANSAC uses one thread unless there is a single session
+	int sessionThreads = sessions.size() > 1 ? 1 : threads;
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(threads);
+	for (unsigned int s = 0; s < sessions.size(); s++)
+		pool.start(new CalibrationSessionTask(&sessions[s], threshold, iterations, sessionThreads));
+	pool.waitForDone();
+
+	std::cout<<"session,status,images,inliers,time_ms,t1_x,t1_y,t1_z,t3_x,t3_y,t3_z,"
+		<<"omega_z,omega_y,omega_x,m_x,m_y,rms_residual,max_residual"<<std::endl;
+	std::cout.precision(10);
+
+	int failed = 0;
+	for (unsigned int s = 0; s < sessions.size(); s++)
+	{
+		CalibrationSession &session = sessions[s];
+
+		std::cout<<session.pointsFilename.toAscii().data()<<",";
+
+		if (!session.ok)
+		{
+			// the failed sessions keep the columns of the header
+			std::cout<<"\""<<session.error.toAscii().data()<<"\","<<session.images;
+			for (int j = 3; j < 18; j++)
+				std::cout<<",";
+			std::cout<<std::endl;
+			failed++;
+			continue;
+		}
+
+		std::cout<<"ok,"<<session.images<<","<<session.inliers<<","<<session.time;
+		for (int j = 0; j < 11; j++)
+			std::cout<<","<<session.parameters[j];
+		std::cout<<","<<session.rmsResidual<<","<<session.maxResidual<<std::endl;
+
+		if (!session.error.isEmpty())
+		{
+			std::cerr<<session.pointsFilename.toAscii().data()<<": "<<session.error.toAscii().data()<<std::endl;
+			failed++;
+		}
+	}
+
+	std::cerr<<sessions.size()<<" sessions calibrated in "<<timer.elapsed()<<" ms with "
+		<<threads<<" threads"<<std::endl;
+
+	return failed > 0 ? 1 : 0;
+}
@@ -7,14 +7,195 @@
 
 #include "Calibration.h"
 
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QTime>
+
+#include <vnl/vnl_quaternion.h>
+#include <vnl/algo/vnl_svd.h>
+
+#include <math.h>
+#include <algorithm>
+
+/** Tests RANSAC hypotheses on random minimal subsets of the images */
+class CalibrationHypothesisTask : public QRunnable
+{
+public:
+
+	CalibrationHypothesisTask(std::vector<Calibration::DataType> *data, double threshold,
+							  int iterations, unsigned int seed)
+		: data(data), threshold(threshold), iterations(iterations), seed(seed), bestCount(0)
+	{
+		setAutoDelete(false);
+	}
+
+	void run()
+	{
+		lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator estimator(threshold);
+
+		int n = data->size();
+		int s = estimator.numForEstimate();
+		double requiredIterations = iterations;
+
+		std::vector<int> indexes(n);
+		for(int i=0; i<n; i++)
+			indexes[i] = i;
+
+		std::vector<Calibration::DataType> sample(s);
+		std::vector<double> parameters;
+
+		for(int it=0; it<iterations && it<requiredIterations; it++){
+
+			// partial shuffle, the first s indexes are the minimal subset
+			for(int i=0; i<s; i++){
+				std::swap(indexes[i], indexes[i + nextRandom()%(n - i)]);
+				sample[i] = data->at(indexes[i]);
+			}
+
+			estimator.estimate(sample, parameters);
+			if(parameters.empty())
+				continue;
+
+			int count = 0;
+			for(int i=0; i<n; i++)
+				if(estimator.agree(parameters, data->at(i)))
+					count++;
+
+			if(count > bestCount){
+				bestCount = count;
+				bestParameters = parameters;
+
+				// hypotheses needed to draw an outlier free subset with probability 0.99
+				double w = pow((double)count/n, s);
+				if(w >= 1)
+					requiredIterations = 0;
+				else if(w > 0)
+					requiredIterations = log(0.01)/log(1 - w);
+			}
+		}
+	}
+
+	int bestCount;
+	std::vector<double> bestParameters;
+
+private:
+
+	/** linear congruential generator, each task has its own sequence */
+	unsigned int nextRandom()
+	{
+		seed = seed*1103515245 + 12345;
+		return (seed >> 16) & 0x7fff;
+	}
+
+	std::vector<Calibration::DataType> *data;
+	double threshold;
+	int iterations;
+	unsigned int seed;
+};
+
+/** Estimates the parameters with a subset of the images, repeated images are allowed */
+class CalibrationResampleTask : public QRunnable
+{
+public:
+
+	CalibrationResampleTask(std::vector<Calibration::DataType> *data, std::vector<int> indexes,
+							std::vector<double> *parameters)
+		: data(data), indexes(indexes), parameters(parameters)
+	{
+	}
+
+	void run()
+	{
+		std::vector<Calibration::DataType> resample;
+		for(unsigned int i=0; i<indexes.size(); i++)
+			resample.push_back(data->at(indexes[i]));
+
+		lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator usCalibration(1.0);
+		usCalibration.setLeastSquaresType(lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator::ANALYTIC);
+		usCalibration.leastSquaresEstimate(resample, *parameters);
+	}
+
+private:
+
+	std::vector<Calibration::DataType> *data;
+	std::vector<int> indexes;
+	std::vector<double> *parameters;
+};
+
+/** standard deviation of each parameter over the estimates that did not fail */
+static std::vector<double> parameterSpread(const std::vector< std::vector<double> > &estimates,
+										   std::vector<double> &mean)
+{
+	mean.assign(11, 0);
+	std::vector<double> spread(11, 0);
+	int count = 0;
+
+	for(unsigned int r=0; r<estimates.size(); r++){
+		if(estimates[r].size() != 11)
+			continue;
+		for(int j=0; j<11; j++)
+			mean[j] += estimates[r][j];
+		count++;
+	}
+
+	if(count < 2)
+		return std::vector<double>();
+
+	for(int j=0; j<11; j++)
+		mean[j] /= count;
+
+	for(unsigned int r=0; r<estimates.size(); r++){
+		if(estimates[r].size() != 11)
+			continue;
+		for(int j=0; j<11; j++)
+			spread[j] += (estimates[r][j] - mean[j])*(estimates[r][j] - mean[j]);
+	}
+
+	for(int j=0; j<11; j++)
+		spread[j] = sqrt(spread[j]/(count - 1));
+
+	return spread;
+}
+
+/** prints the estimated calibration parameters */
+static void printParameters(const std::vector<double> &parameters)
+{
+	std::cout<<"t1[x,y,z]:\n";
+	std::cout<<"\t["<<parameters[0]<<", "<<parameters[1];
+	std::cout<<", "<<parameters[2]<<"]\n";
+	std::cout<<"t3[x,y,z]:\n";
+	std::cout<<"\t["<<parameters[3]<<", "<<parameters[4];
+	std::cout<<", "<<parameters[5]<<"]\n";
+	std::cout<<"omega[z,y,x]:\n";
+	std::cout<<"\t["<<parameters[6]<<", "<<parameters[7];
+	std::cout<<", "<<parameters[8]<<"]\n";
+	std::cout<<"m[x,y]:\n";
+	std::cout<<"\t["<<parameters[9];
+	std::cout<<", "<<parameters[10]<<"]\n";
+}
+
+Calibration::Calibration()
+{
+	inlierThreshold = 1.0;
+	maximumIterations = 1000;
+	numberOfThreads = QThread::idealThreadCount();
+	verbose = true;
+	translationTolerance = 0.5;
+	angleTolerance = 0.01;
+	stableUpdates = 0;
+}
+
 void Calibration::InsertTransformations(vnl_matrix<double> rotationMatrix, vnl_vector<double> translation)
 {
-	std::cout<<std::endl;
-	std::cout<<"Rotation Matrix:"<<std::endl;
-	rotationMatrix.print(std::cout);
-	std::cout<<std::endl;
-	std::cout<<"Traslation: "<<translation[0]<<", "<<translation[1]<<", "<<translation[2]<<std::endl;
-	std::cout<<std::endl;
+	if(verbose){
+		std::cout<<std::endl;
+		std::cout<<"Rotation Matrix:"<<std::endl;
+		rotationMatrix.print(std::cout);
+		std::cout<<std::endl;
+		std::cout<<"Traslation: "<<translation[0]<<", "<<translation[1]<<", "<<translation[2]<<std::endl;
+		std::cout<<std::endl;
+	}
 	
 	lsqrRecipes::Frame f;
 
@@ -22,6 +203,9 @@ void Calibration::InsertTransformations(vnl_matrix<double> rotationMatrix, vnl_v
 	f.setTranslation(translation);
 	transformations.push_back(f);
 
+	rotationMatrices.push_back(rotationMatrix);
+	translationVectors.push_back(translation);
+
 	if(transformations.empty())
 		std::cout<<"Transformations is empty"<<std::endl<<std::endl;
   
@@ -31,6 +215,8 @@ void Calibration::InsertTransformations(vnl_matrix<double> rotationMatrix, vnl_v
 void Calibration::ClearTransformations()
 {
 	transformations.clear();
+	rotationMatrices.clear();
+	translationVectors.clear();
 	if(!transformations.empty())
 		std::cout<<"Transformations is not clear"<<std::endl<<std::endl;
 		
@@ -43,7 +229,8 @@ void Calibration::InsertImagePoints(double p[2])
 	
 	point[0]=p[0];
 	point[1]=p[1];
-	std::cout<<"Image point: "<<p[0]<<", "<<p[1]<<std::endl<<std::endl;
+	if(verbose)
+		std::cout<<"Image point: "<<p[0]<<", "<<p[1]<<std::endl<<std::endl;
 	imagePoints.push_back(p);
 	
 	if(imagePoints.empty())
@@ -61,9 +248,11 @@ bool Calibration::Calibrate()
 {
 	DataType dataElement;
 
-	std::cout<<"Calculating calibration parameters"<<std::endl<<std::endl;
+	if(verbose)
+		std::cout<<"Calculating calibration parameters"<<std::endl<<std::endl;
 	size_t n = transformations.size();
 
+	data.clear();
 	for(int i=0; i<n; i++) {
 		dataElement.T2 = transformations[i];
 		dataElement.q = imagePoints[i];
@@ -79,26 +268,392 @@ bool Calibration::Calibrate()
 	usCalibration.setLeastSquaresType(lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator::ANALYTIC);
 	usCalibration.leastSquaresEstimate(data, estimatedUSCalibrationParameters);
 
-	if(estimatedUSCalibrationParameters.size() == 0)
-		std::cout<<"DEGENERATE CONFIGURATION\n\n\n";
-	else {
-		std::cout<<"t1[x,y,z]:\n";
-		std::cout<<"\t["<<estimatedUSCalibrationParameters[0]<<", "<<estimatedUSCalibrationParameters[1];
-		std::cout<<", "<<estimatedUSCalibrationParameters[2]<<"]\n";
-		std::cout<<"t3[x,y,z]:\n";
-		std::cout<<"\t["<<estimatedUSCalibrationParameters[3]<<", "<<estimatedUSCalibrationParameters[4];
-		std::cout<<", "<<estimatedUSCalibrationParameters[5]<<"]\n";
-		std::cout<<"omega[z,y,x]:\n";
-		std::cout<<"\t["<<estimatedUSCalibrationParameters[6]<<", "<<estimatedUSCalibrationParameters[7];
-		std::cout<<", "<<estimatedUSCalibrationParameters[8]<<"]\n";
-		std::cout<<"m[x,y]:\n";
-		std::cout<<"\t["<<estimatedUSCalibrationParameters[9];
-		std::cout<<", "<<estimatedUSCalibrationParameters[10]<<"]\n";
-	}	
+	if(verbose){
+		if(estimatedUSCalibrationParameters.size() == 0)
+			std::cerr<<"DEGENERATE CONFIGURATION\n\n\n";
+		else
+			printParameters(estimatedUSCalibrationParameters);
+	}
 	
 	return 1;
 }
 
+bool Calibration::CalibrateRANSAC()
+{
+	std::vector<DataType> ransacData;
+	DataType dataElement;
+
+	if(verbose)
+		std::cout<<"Calculating calibration parameters with RANSAC"<<std::endl<<std::endl;
+	size_t n = std::min(transformations.size(), imagePoints.size());
+
+	for(size_t i=0; i<n; i++) {
+		dataElement.T2 = transformations[i];
+		dataElement.q = imagePoints[i];
+		ransacData.push_back(dataElement);
+	}
+
+	estimatedUSCalibrationParameters.clear();
+	inliers.assign(n, false);
+
+	lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator usCalibration(inlierThreshold);
+
+	if(n < usCalibration.numForEstimate()){
+		if(verbose)
+			std::cerr<<"NOT ENOUGH IMAGES\n\n\n";
+		return false;
+	}
+
+	QTime timer;
+	timer.start();
+
+	int threads = std::max(1, numberOfThreads);
+	QThreadPool pool;
+	pool.setMaxThreadCount(threads);
+
+	std::vector<CalibrationHypothesisTask *> tasks;
+	for(int t=0; t<threads; t++){
+		int iterations = (maximumIterations + threads - 1)/threads;
+		tasks.push_back(new CalibrationHypothesisTask(&ransacData, inlierThreshold, iterations, 12345 + 7919*t));
+		pool.start(tasks.back());
+	}
+	pool.waitForDone();
+
+	CalibrationHypothesisTask *best = tasks.front();
+	for(int t=1; t<threads; t++)
+		if(tasks.at(t)->bestCount > best->bestCount)
+			best = tasks.at(t);
+
+	// least squares estimate with all the images that agree with the best hypothesis
+	std::vector<DataType> inlierData;
+	if(best->bestCount > 0){
+		for(size_t i=0; i<n; i++){
+			inliers[i] = usCalibration.agree(best->bestParameters, ransacData[i]);
+			if(inliers[i])
+				inlierData.push_back(ransacData[i]);
+		}
+	}
+
+	for(int t=0; t<threads; t++)
+		delete tasks.at(t);
+
+	if(inlierData.size() >= usCalibration.numForEstimate()){
+		usCalibration.setLeastSquaresType(lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator::ANALYTIC);
+		usCalibration.leastSquaresEstimate(inlierData, estimatedUSCalibrationParameters);
+	}
+
+	int elapsed = timer.elapsed();
+
+	if(estimatedUSCalibrationParameters.size() == 0){
+		if(verbose)
+			std::cerr<<"DEGENERATE CONFIGURATION\n\n\n";
+		return false;
+	}
+
+	if(verbose){
+		std::cout<<"Inliers: "<<inlierData.size()<<" of "<<n<<" images\n";
+		for(size_t i=0; i<n; i++)
+			if(!inliers[i])
+				std::cout<<"\tImage "<<i+1<<" rejected\n";
+		std::cout<<"RANSAC time: "<<elapsed<<" ms with "<<threads<<" threads\n";
+
+		printParameters(estimatedUSCalibrationParameters);
+	}
+
+	return true;
+}
+
+void Calibration::SetInlierThreshold(double threshold)
+{
+	inlierThreshold = threshold;
+}
+
+void Calibration::SetMaximumIterations(int iterations)
+{
+	maximumIterations = std::max(1, iterations);
+}
+
+void Calibration::SetNumberOfThreads(int threads)
+{
+	numberOfThreads = std::max(1, threads);
+}
+
+void Calibration::SetVerbose(bool verbose)
+{
+	this->verbose = verbose;
+}
+
+std::vector<bool> Calibration::getInliers()
+{
+	return inliers;
+}
+
+bool Calibration::AddImage(vnl_matrix<double> rotationMatrix, vnl_vector<double> translation, double p[2])
+{
+	InsertTransformations(rotationMatrix, translation);
+	InsertImagePoints(p);
+
+	lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator usCalibration(inlierThreshold);
+	if(transformations.size() < usCalibration.numForEstimate())
+		return false;
+
+	std::vector<double> previous = estimatedUSCalibrationParameters;
+
+	// the first estimate is analytic, the next ones start from the previous estimate
+	if(previous.empty()){
+		bool wasVerbose = verbose;
+		verbose = false;
+		Calibrate();
+		verbose = wasVerbose;
+
+		if(estimatedUSCalibrationParameters.empty())
+			return false;
+	}
+
+	Refine(previous.empty() ? 10 : 3);
+
+	bool stable = false;
+	if(!previous.empty() && parameterDeviations.size() == 11){
+
+		stable = true;
+		for(int j=3; j<6; j++)
+			stable = stable && parameterDeviations[j] < translationTolerance
+				&& fabs(estimatedUSCalibrationParameters[j] - previous[j]) < translationTolerance/5;
+		for(int j=6; j<9; j++)
+			stable = stable && parameterDeviations[j] < angleTolerance
+				&& fabs(estimatedUSCalibrationParameters[j] - previous[j]) < angleTolerance/5;
+	}
+
+	stableUpdates = stable ? stableUpdates + 1 : 0;
+
+	if(verbose)
+		printParameters(estimatedUSCalibrationParameters);
+
+	return true;
+}
+
+vnl_vector<double> Calibration::Residuals(const vnl_vector<double> &parameters)
+{
+	size_t n = rotationMatrices.size();
+	vnl_vector<double> residuals(3*n);
+
+	// the same rotation QVTKImageWidget::computeTransformation() builds from omega[z,y,x]
+	vnl_quaternion<double> quaternion(parameters[8], parameters[7], parameters[6]);
+	vnl_matrix<double> rotation = quaternion.rotation_matrix_transpose();
+	rotation = rotation.transpose();
+
+	vnl_vector<double> imagePoint(3);
+	imagePoint[2] = 0;
+
+	for(size_t i=0; i<n; i++){
+
+		imagePoint[0] = parameters[9]*imagePoints[i][0];
+		imagePoint[1] = parameters[10]*imagePoints[i][1];
+
+		vnl_vector<double> probePoint = rotation*imagePoint;
+		for(int d=0; d<3; d++)
+			probePoint[d] += parameters[3 + d];
+
+		vnl_vector<double> trackerPoint = rotationMatrices[i]*probePoint;
+		for(int d=0; d<3; d++)
+			residuals[3*i + d] = trackerPoint[d] + translationVectors[i][d] - parameters[d];
+	}
+
+	return residuals;
+}
+
+void Calibration::Refine(int iterations)
+{
+	size_t n = rotationMatrices.size();
+	if(estimatedUSCalibrationParameters.size() != 11 || imagePoints.size() != n)
+		return;
+
+	vnl_vector<double> parameters(&estimatedUSCalibrationParameters[0], 11);
+	vnl_matrix<double> jacobian(3*n, 11);
+	vnl_vector<double> residuals = Residuals(parameters);
+
+	for(int it=0; it<=iterations; it++){
+
+		// forward differences, the angles are in radians and the scales near 0.1 mm/pixel
+		for(int j=0; j<11; j++){
+			double step = j < 6 ? 1e-4 : 1e-7;
+			vnl_vector<double> shifted = parameters;
+			shifted[j] += step;
+			jacobian.set_column(j, (Residuals(shifted) - residuals)/step);
+		}
+
+		if(it == iterations)
+			break;
+
+		vnl_svd<double> svd(jacobian);
+		vnl_vector<double> delta = svd.solve(residuals);
+
+		vnl_vector<double> updated = parameters - delta;
+		vnl_vector<double> updatedResiduals = Residuals(updated);
+
+		if(updatedResiduals.squared_magnitude() >= residuals.squared_magnitude())
+			break;
+
+		parameters = updated;
+		residuals = updatedResiduals;
+	}
+
+	for(int j=0; j<11; j++)
+		estimatedUSCalibrationParameters[j] = parameters[j];
+
+	// covariance sigma^2 (J^T J)^-1 with the residual variance
+	parameterDeviations.clear();
+	if(3*n > 11){
+		double variance = residuals.squared_magnitude()/(3*n - 11);
+		vnl_matrix<double> covariance = vnl_svd<double>(jacobian.transpose()*jacobian).pinverse()*variance;
+		for(int j=0; j<11; j++)
+			parameterDeviations.push_back(sqrt(fabs(covariance[j][j])));
+	}
+}
+
+bool Calibration::AnalyzePrecision(int bootstrapResamples)
+{
+	std::vector<DataType> precisionData;
+	DataType dataElement;
+
+	size_t n = std::min(transformations.size(), imagePoints.size());
+	for(size_t i=0; i<n; i++) {
+		dataElement.T2 = transformations[i];
+		dataElement.q = imagePoints[i];
+		precisionData.push_back(dataElement);
+	}
+
+	leaveOneOutDeviations.clear();
+	bootstrapDeviations.clear();
+	imageInfluences.clear();
+
+	lsqrRecipes::SingleUnknownPointTargetUSCalibrationParametersEstimator usCalibration(1.0);
+	if(n <= usCalibration.numForEstimate()){
+		if(verbose)
+			std::cerr<<"NOT ENOUGH IMAGES\n\n\n";
+		return false;
+	}
+
+	QTime timer;
+	timer.start();
+
+	std::vector<double> full;
+	std::vector< std::vector<double> > leaveOneOut(n);
+	std::vector< std::vector<double> > bootstrap(std::max(0, bootstrapResamples));
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(std::max(1, numberOfThreads));
+
+	std::vector<int> indexes;
+	for(size_t i=0; i<n; i++)
+		indexes.push_back(i);
+	pool.start(new CalibrationResampleTask(&precisionData, indexes, &full));
+
+	for(size_t left=0; left<n; left++){
+		indexes.clear();
+		for(size_t i=0; i<n; i++)
+			if(i != left)
+				indexes.push_back(i);
+		pool.start(new CalibrationResampleTask(&precisionData, indexes, &leaveOneOut[left]));
+	}
+
+	unsigned int seed = 12345;
+	for(unsigned int r=0; r<bootstrap.size(); r++){
+		indexes.clear();
+		for(size_t i=0; i<n; i++){
+			seed = seed*1103515245 + 12345;
+			indexes.push_back(((seed >> 16) & 0x7fff)%n);
+		}
+		pool.start(new CalibrationResampleTask(&precisionData, indexes, &bootstrap[r]));
+	}
+
+	pool.waitForDone();
+
+	if(full.size() != 11){
+		if(verbose)
+			std::cerr<<"DEGENERATE CONFIGURATION\n\n\n";
+		return false;
+	}
+
+	// the jackknife spread is scaled by n-1 over the sample deviation of the estimates
+	std::vector<double> mean;
+	leaveOneOutDeviations = parameterSpread(leaveOneOut, mean);
+	for(unsigned int j=0; j<leaveOneOutDeviations.size(); j++)
+		leaveOneOutDeviations[j] *= (n - 1)/sqrt((double)n);
+
+	bootstrapDeviations = parameterSpread(bootstrap, mean);
+
+	imageInfluences.assign(n, 0);
+	if(leaveOneOutDeviations.size() == 11){
+		for(size_t i=0; i<n; i++){
+			if(leaveOneOut[i].size() != 11)
+				continue;
+			for(int j=0; j<11; j++){
+				if(leaveOneOutDeviations[j] <= 0)
+					continue;
+				double change = (leaveOneOut[i][j] - full[j])/leaveOneOutDeviations[j];
+				imageInfluences[i] += change*change;
+			}
+		}
+	}
+
+	if(verbose){
+		const char *names[11] = {"t1x", "t1y", "t1z", "t3x", "t3y", "t3z",
+								 "omega_z", "omega_y", "omega_x", "mx", "my"};
+
+		std::cout<<"Precision with "<<n<<" images, "<<bootstrap.size()<<" bootstrap resamples in "
+			<<timer.elapsed()<<" ms\n";
+		for(int j=0; j<11 && leaveOneOutDeviations.size() == 11 && bootstrapDeviations.size() == 11; j++)
+			std::cout<<"\t"<<names[j]<<": "<<full[j]<<" leave-one-out sd "<<leaveOneOutDeviations[j]
+				<<" bootstrap sd "<<bootstrapDeviations[j]<<"\n";
+
+		std::vector<int> order;
+		for(size_t i=0; i<n; i++)
+			order.push_back(i);
+		for(size_t a=0; a<order.size(); a++)
+			for(size_t b=a + 1; b<order.size(); b++)
+				if(imageInfluences[order[b]] > imageInfluences[order[a]])
+					std::swap(order[a], order[b]);
+
+		std::cout<<"Most influential images:\n";
+		for(size_t k=0; k<std::min((size_t)5, n); k++)
+			std::cout<<"\tImage "<<order[k] + 1<<": "<<imageInfluences[order[k]]<<"\n";
+	}
+
+	return true;
+}
+
+std::vector<double> Calibration::getLeaveOneOutDeviations()
+{
+	return leaveOneOutDeviations;
+}
+
+std::vector<double> Calibration::getBootstrapDeviations()
+{
+	return bootstrapDeviations;
+}
+
+std::vector<double> Calibration::getImageInfluences()
+{
+	return imageInfluences;
+}
+
+std::vector<double> Calibration::getParameterDeviations()
+{
+	return parameterDeviations;
+}
+
+bool Calibration::IsStable()
+{
+	return stableUpdates >= 2;
+}
+
+void Calibration::SetStabilityTolerance(double translation, double angle)
+{
+	translationTolerance = translation;
+	angleTolerance = angle;
+}
+
 std::vector<double> Calibration::getEstimatedUSCalibrationParameters()
 {
     return estimatedUSCalibrationParameters;
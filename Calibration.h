@@ -8,6 +8,11 @@
 #include "SinglePointTargetUSCalibrationParametersEstimator.h"
 #include "RANSAC.h"
 
+#include <vector>
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
 
 //!Implements LSQRRecepies methods
 /*!
@@ -43,10 +48,67 @@ class Calibration
         ///estimate calibration parameters
 		bool Calibrate();
 
+        ///estimate calibration parameters rejecting the outlier images with RANSAC
+		bool CalibrateRANSAC();
+
+        ///set the maximum distance in mm for an image to agree with the parameters
+		void SetInlierThreshold(double threshold);
+
+        ///set the maximum number of hypotheses tested by RANSAC
+		void SetMaximumIterations(int iterations);
+
+        ///set the number of threads that test the hypotheses
+		void SetNumberOfThreads(int threads);
+
+        ///print the input data and the estimated parameters, true by default
+		void SetVerbose(bool verbose);
+
         std::vector<double> getEstimatedUSCalibrationParameters();
 
+        ///true for the images used in the last RANSAC estimate
+        std::vector<bool> getInliers();
+
+        ///add the data of one image and update the estimate, starting from the previous one.
+        ///returns false while there are not enough images
+		bool AddImage(vnl_matrix<double> rotationMatrix, vnl_vector<double> translation, double p[2]);
+
+        ///standard deviation of each estimated parameter, from the covariance of the last update
+        std::vector<double> getParameterDeviations();
+
+        ///true when the last two updates did not change the estimate and its deviation is small
+		bool IsStable();
+
+        ///set the translation (mm) and angle (rad) tolerances of IsStable()
+		void SetStabilityTolerance(double translation, double angle);
+
+        ///estimate the parameters leaving out each image and with bootstrap resamples of the images,
+        ///all the estimates run in parallel
+		bool AnalyzePrecision(int bootstrapResamples);
+
+        ///standard deviation of each parameter from the leave-one-out estimates (jackknife)
+        std::vector<double> getLeaveOneOutDeviations();
+
+        ///standard deviation of each parameter from the bootstrap estimates
+        std::vector<double> getBootstrapDeviations();
+
+        ///influence of each image, the sum over the parameters of the squared change when the image
+        ///is left out divided by the leave-one-out variance
+        std::vector<double> getImageInfluences();
+
     private:
 
+        Calibration();
+
+        double inlierThreshold;///<distance to agree with the parameters
+
+        int maximumIterations;///<hypotheses tested by RANSAC
+
+        int numberOfThreads;///<threads that test the hypotheses
+
+        bool verbose;///<print the data and the results
+
+        std::vector<bool> inliers;///<images that agree with the last RANSAC estimate
+
         std::vector<lsqrRecipes::Frame> transformations;
 
         std::vector<lsqrRecipes::Point2D> imagePoints;///<contains the crosswire point in all images
@@ -55,5 +117,29 @@ class Calibration
 
         std::vector<double> estimatedUSCalibrationParameters;//contain the estimated calibration parameters
 
+        std::vector< vnl_matrix<double> > rotationMatrices;///<rotation of each image
+
+        std::vector< vnl_vector<double> > translationVectors;///<translation of each image
+
+        std::vector<double> parameterDeviations;///<standard deviation of each parameter
+
+        double translationTolerance;///<stability tolerance of t3 in mm
+
+        double angleTolerance;///<stability tolerance of omega in rad
+
+        int stableUpdates;///<consecutive updates within the tolerances
+
+        std::vector<double> leaveOneOutDeviations;///<jackknife deviation of each parameter
+
+        std::vector<double> bootstrapDeviations;///<bootstrap deviation of each parameter
+
+        std::vector<double> imageInfluences;///<influence of each image on the estimate
+
+        ///residuals of all images for the given parameters
+        vnl_vector<double> Residuals(const vnl_vector<double> &parameters);
+
+        ///gauss-newton refinement of the estimate with all images, updates the deviations
+        void Refine(int iterations);
+
 
 };
@@ -1,11 +1,84 @@
 #include "CheckCalibrationErrorWidget.h"
 #include "EstimateSphereFromPoints.h"
+#include "SphereSegmentation.h"
 
 #include <vnl/vnl_quaternion.h>
+#include <vnl/vnl_matrix_fixed.h>
+
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
 
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QTime>
+
+/** Maps the traced pixels of one frame to tracker coordinates */
+class PointTransformTask : public QRunnable
+{
+public:
+
+	PointTransformTask(vtkPoints *points, int lastRow, double *output)
+		: points(points), lastRow(lastRow), output(output)
+	{
+	}
+
+	void run()
+	{
+		int size = points->GetNumberOfPoints();
+
+		// pixel columns and rows, truncated as the tracer points were always read
+		std::vector<double> u(size);
+		std::vector<double> v(size);
+
+		vtkDataArray *data = points->GetData();
+		if (data->GetDataType() == VTK_FLOAT && data->GetNumberOfComponents() == 3)
+		{
+			const float *xyz = static_cast<vtkFloatArray *>(data)->GetPointer(0);
+			for (int j=0; j<size; j++)
+			{
+				u[j] = (int)xyz[3*j];
+				v[j] = (int)(lastRow - xyz[3*j + 1]);
+			}
+		}
+		else
+		{
+			double p[3];
+			for (int j=0; j<size; j++)
+			{
+				points->GetPoint(j, p);
+				u[j] = (int)p[0];
+				v[j] = (int)(lastRow - p[1]);
+			}
+		}
+
+		const double m00 = transform[0][0], m01 = transform[0][1], m02 = transform[0][2];
+		const double m10 = transform[1][0], m11 = transform[1][1], m12 = transform[1][2];
+		const double m20 = transform[2][0], m21 = transform[2][1], m22 = transform[2][2];
+		const double *pu = &u[0];
+		const double *pv = &v[0];
+		double *out = output;
+
+		// no aliasing and no calls, the compiler vectorizes this loop
+		for (int j=0; j<size; j++)
+		{
+			out[3*j] = m00*pu[j] + m01*pv[j] + m02;
+			out[3*j + 1] = m10*pu[j] + m11*pv[j] + m12;
+			out[3*j + 2] = m20*pu[j] + m21*pv[j] + m22;
+		}
+	}
+
+	/** rows of the frame transform applied to (u, v, 1) */
+	double transform[3][3];
+
+private:
+
+	vtkPoints *points;
+	int lastRow;
+	double *output;
+};
 
 CheckCalibrationErrorWidget::CheckCalibrationErrorWidget(QWidget* parent) : QWidget(parent)
 {
@@ -205,9 +278,23 @@ void CheckCalibrationErrorWidget::checkError(){
 	std::cout<<"Tracked center: "<<centerX<<", "<<centerY<<", "<<centerZ<<std::endl;
 
 	estimator->setPoints(transformPoints());
-	estimator->estimateSphere();
+
+	if (ransacCheckBox->isChecked())
+	{
+		estimator->setInlierThreshold(inlierThreshold->value());
+		if (!estimator->estimateSphereRANSAC())
+		{
+			delete estimator;
+			return;
+		}
+	}
+	else
+	{
+		estimator->estimateSphere();
+	}
 
 	vnl_vector<double> sphere = estimator->getSphere();
+	delete estimator;
 
 	error.set_size(5);
 
@@ -226,6 +313,49 @@ void CheckCalibrationErrorWidget::checkError(){
 
 }
 
+void CheckCalibrationErrorWidget::segmentSphere()
+{
+	if (imageStack.empty())
+		return;
+
+	SphereSegmentation * segmentation = SphereSegmentation::New();
+	segmentation->setImageStack(imageStack);
+
+	QTime timer;
+	timer.start();
+
+	segmentation->segment();
+
+	std::vector< vtkSmartPointer<vtkPoints> > outlines = segmentation->getOutlines();
+	std::vector<SphereSegmentation::Circle> circles = segmentation->getCircles();
+	delete segmentation;
+
+	int found = 0;
+	QString str;
+
+	for (unsigned int i = 0; i < outlines.size(); i++)
+	{
+		// manually traced outlines are kept where the sphere was not found
+		if (outlines[i].GetPointer() != NULL)
+		{
+			pointsVector[i] = outlines[i];
+			found++;
+		}
+		else if (pointsVector[i].GetPointer() != NULL)
+		{
+			continue;
+		}
+
+		tableWidget->setItem(i, 0, new QTableWidgetItem(str.setNum(i)));
+		tableWidget->setItem(i, 1, new QTableWidgetItem(circles[i].found ? "Auto" : "Not found"));
+
+		if (!circles[i].found)
+			tableWidget->item(i, 1)->setBackground(Qt::yellow);
+	}
+
+	std::cout<<"Sphere found in "<<found<<" of "<<outlines.size()<<" images in "<<timer.elapsed()<<" ms"<<std::endl;
+}
+
 void CheckCalibrationErrorWidget::saveError()
 {
 
@@ -308,6 +438,9 @@ vnl_matrix<double> CheckCalibrationErrorWidget::transformPoints()
 	std::cout<<std::endl;
 	std::cout<<"Transforming points"<<std::endl;	
 
+	QTime timer;
+	timer.start();
+
 	double x = calibrationData[0];
 	double y = calibrationData[1];
 	double z = calibrationData[2];
@@ -315,111 +448,62 @@ vnl_matrix<double> CheckCalibrationErrorWidget::transformPoints()
 	double b = calibrationData[4];
 	double c = calibrationData[5];
 
-	vnl_vector<double> scale;
-	scale.set_size(2);
-
-	scale.put(0,calibrationData[6]);
-	scale.put(1,calibrationData[7]);
+	double scale[2] = {calibrationData[6], calibrationData[7]};
 
 	vnl_quaternion<double> rTpQuat(c, b, a);
-	vnl_matrix<double> rTp = rTpQuat.rotation_matrix_transpose_4();
-	rTp = rTp.transpose();
+	vnl_matrix_fixed<double,4,4> rTp = rTpQuat.rotation_matrix_transpose_4().transpose();
 	rTp.put(0, 3, x);
 	rTp.put(1, 3, y);
 	rTp.put(2, 3, z);
- 
-	vnl_vector<double> point;
-	point.set_size(4);
 
-	point[2] = 0;
-	point[3] = 1;
+	// each frame writes its points from its own row of the output
+	int frames = imageStack.size();
+	std::vector<int> offsets(frames + 1, 0);
+	for (int i=0; i<frames; i++)
+	{
+		int size = pointsVector.at(i).GetPointer() == NULL ? 0 : pointsVector.at(i)->GetNumberOfPoints();
+		offsets[i + 1] = offsets[i] + size;
+	}
 
-	vnl_vector<double> transformedPoint;
-	transformedPoint.set_size(4);
+	vnl_matrix<double> transformedPoints(offsets[frames], 3);
 
-	std::vector<vnl_vector< double > > transX;
-	std::vector<vnl_vector< double > > transY;
-	std::vector<vnl_vector< double > > transZ;
+	QThreadPool pool;
 
-	transX.reserve(imageStack.size());
-	transY.reserve(imageStack.size());
-	transZ.reserve(imageStack.size());
+	for (int i=0; i<frames; i++){
 
-	int p = 0;
+		if (offsets[i + 1] == offsets[i])
+			continue;
 
-	for (int i=0; i<imageStack.size(); i++){   
-		
 		vnl_vector<double> quaternion = rotations.get_row(i);
 		vnl_vector<double> translation = translations.get_row(i);
 
 		vnl_quaternion<double> tTrQuat(quaternion[1], quaternion[2], quaternion[3], quaternion[0]);
-		vnl_matrix<double> tTr = tTrQuat.rotation_matrix_transpose_4();
-		tTr = tTr.transpose();
+		vnl_matrix_fixed<double,4,4> tTr = tTrQuat.rotation_matrix_transpose_4().transpose();
 		tTr.put(0, 3, translation[0]);
 		tTr.put(1, 3, translation[1]);
 		tTr.put(2, 3, translation[2]);
 
-		vnl_matrix<double> tTp = tTr*rTp;
+		vnl_matrix_fixed<double,4,4> tTp = tTr*rTp;
 
-		vtkSmartPointer<vtkPoints> points = pointsVector.at(i);
-
-		int newSize = points->GetNumberOfPoints();
-			
-		vnl_vector<double> transformedPointsX;
-		vnl_vector<double> transformedPointsY;
-		vnl_vector<double> transformedPointsZ;
-		
-		transformedPointsX.set_size(newSize);
-		transformedPointsY.set_size(newSize);
-		transformedPointsZ.set_size(newSize);
+		// the image scale and the flip of the y axis are folded in the frame transform
+		int* dimension = imageStack.at(i)->GetDimensions();
 
-		int* dimension = imageStack.at(i)->GetDimensions();     
-
-		for(int j=0; j<newSize; j++){
-
-			 double * x = points->GetPoint(j);
-			 int xPos = x[0];
-			 int yPos = (dimension[1]-1) - x[1];
-
-			 point[0] = scale[0]*xPos;
-			 point[1] = scale[1]*yPos;
-
-			 transformedPoint = tTp*point;
-
-			 transformedPointsX.put(j,transformedPoint[0]);
-			 transformedPointsY.put(j,transformedPoint[1]);
-			 transformedPointsZ.put(j,transformedPoint[2]);
-
-			 p++;
+		PointTransformTask *task = new PointTransformTask(pointsVector.at(i), dimension[1] - 1,
+			transformedPoints.data_block() + 3*offsets[i]);
 
+		for (int r=0; r<3; r++)
+		{
+			task->transform[r][0] = tTp(r,0)*scale[0];
+			task->transform[r][1] = tTp(r,1)*scale[1];
+			task->transform[r][2] = tTp(r,3);
 		}
 
-		transX.push_back(transformedPointsX);
-		transY.push_back(transformedPointsY);
-		transZ.push_back(transformedPointsZ);
-    }
-
-
-	vnl_matrix<double> transformedPoints;
-	transformedPoints.set_size(p,3);
-
-	int pp = 0;
-	for(int i=0; i<imageStack.size(); i++)
-	{
-		vnl_vector<double> X = transX[i];
-		vnl_vector<double> Y = transY[i];
-		vnl_vector<double> Z = transZ[i];
-
-		for(int j=0; j<X.size(); j++)
-		{
-			transformedPoints.put(pp,0,X[j]);
-			transformedPoints.put(pp,1,Y[j]);
-			transformedPoints.put(pp,2,Z[j]);
+		pool.start(task);
+	}
 
-			pp++;
+	pool.waitForDone();
 
-		}
-	}
+	std::cout<<offsets[frames]<<" points transformed in "<<timer.elapsed()<<" ms"<<std::endl;
 
 	return transformedPoints;
-}
\ No newline at end of file
+}
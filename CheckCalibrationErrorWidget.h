@@ -105,6 +105,9 @@ private slots:
 
 	/** \brief Save the calibration error in a txt file */
     void saveError();
+
+	/** \brief Find the sphere outline in all the images with SphereSegmentation.h */
+    void segmentSphere();
 };
 
 #endif // CHECKCALIBRATIONERRORWIDGET_H
@@ -0,0 +1,301 @@
+#include "CrosswireDetector.h"
+#include "GaussianFilter.h"
+
+#include <vtkMath.h>
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+
+/** Detects the crosswire in one image of the stack */
+class CrosswireTask : public QRunnable
+{
+public:
+
+	CrosswireTask(CrosswireDetector *detector, vtkImageData *image, CrosswireDetector::Crosswire *crosswire)
+		: detector(detector), image(image), crosswire(crosswire)
+	{
+	}
+
+	void run()
+	{
+		*crosswire = detector->detectImage(image);
+	}
+
+private:
+
+	CrosswireDetector *detector;
+	vtkImageData *image;
+	CrosswireDetector::Crosswire *crosswire;
+};
+
+/** A pixel on a ridge */
+struct RidgePixel
+{
+	double x;
+	double y;
+	double weight;
+	double theta; ///<Angle of the ridge normal in [0, pi)
+};
+
+/** A line x*cos(theta) + y*sin(theta) = rho fitted to the ridge pixels */
+struct RidgeLine
+{
+	double normal[2];
+	double rho;
+	double support;
+};
+
+/** Fit a line to the ridge pixels near a Hough line with a similar orientation */
+static bool fitRidgeLine(const std::vector<RidgePixel> &pixels, double theta, double rho,
+						 double distance, RidgeLine &line)
+{
+	double c = cos(theta);
+	double s = sin(theta);
+
+	double sw = 0, sx = 0, sy = 0;
+	std::vector<int> selected;
+
+	for(unsigned int p=0; p<pixels.size(); p++){
+
+		double angle = fabs(pixels[p].theta - theta);
+		angle = std::min(angle, vtkMath::DoublePi() - angle);
+
+		if(angle > 15*vtkMath::DoublePi()/180 || fabs(pixels[p].x*c + pixels[p].y*s - rho) > distance)
+			continue;
+
+		selected.push_back(p);
+		sw += pixels[p].weight;
+		sx += pixels[p].weight*pixels[p].x;
+		sy += pixels[p].weight*pixels[p].y;
+	}
+
+	if(selected.size() < 5)
+		return false;
+
+	double cx = sx/sw;
+	double cy = sy/sw;
+	double cxx = 0, cyy = 0, cxy = 0;
+
+	for(unsigned int k=0; k<selected.size(); k++){
+		const RidgePixel &pixel = pixels[selected[k]];
+		cxx += pixel.weight*(pixel.x - cx)*(pixel.x - cx);
+		cyy += pixel.weight*(pixel.y - cy)*(pixel.y - cy);
+		cxy += pixel.weight*(pixel.x - cx)*(pixel.y - cy);
+	}
+
+	// the line direction is the principal axis of the pixels
+	double direction = 0.5*atan2(2*cxy, cxx - cyy);
+
+	line.normal[0] = -sin(direction);
+	line.normal[1] = cos(direction);
+	line.rho = line.normal[0]*cx + line.normal[1]*cy;
+	line.support = sw;
+
+	return true;
+}
+
+CrosswireDetector::CrosswireDetector()
+{
+	sigma = 2.0;
+	minimumAngle = 15.0;
+	numberOfThreads = QThread::idealThreadCount();
+}
+
+void CrosswireDetector::detect()
+{
+	std::cout<<"Detecting crosswires in "<<imageStack.size()<<" images"<<std::endl;
+
+	crosswires.assign(imageStack.size(), Crosswire());
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(numberOfThreads);
+
+	for(unsigned int i=0; i<imageStack.size(); i++)
+		pool.start(new CrosswireTask(this, imageStack.at(i), &crosswires.at(i)));
+
+	pool.waitForDone();
+}
+
+CrosswireDetector::Crosswire CrosswireDetector::detectImage(vtkImageData *image)
+{
+	Crosswire crosswire;
+	crosswire.found = false;
+	crosswire.x = 0;
+	crosswire.y = 0;
+	crosswire.confidence = 0;
+
+	int *extent = image->GetExtent();
+	int width = extent[1] - extent[0] + 1;
+	int height = extent[3] - extent[2] + 1;
+
+	if(width < 8 || height < 8)
+		return crosswire;
+
+	std::vector<float> buffer(width*height);
+	for(int j=0; j<height; j++)
+		for(int i=0; i<width; i++)
+			buffer[j*width + i] = image->GetScalarComponentAsDouble(extent[0] + i, extent[2] + j, extent[4], 0);
+
+	GaussianFilter::smooth(buffer, width, height, sigma);
+
+	// bright ridges have a large negative eigenvalue of the hessian across the wire
+	std::vector<RidgePixel> pixels;
+	std::vector<float> ridge(width*height, 0);
+	double mean = 0, meanSquares = 0;
+
+	for(int j=1; j<height - 1; j++){
+		for(int i=1; i<width - 1; i++){
+
+			int idx = j*width + i;
+			double ixx = buffer[idx + 1] - 2*buffer[idx] + buffer[idx - 1];
+			double iyy = buffer[idx + width] - 2*buffer[idx] + buffer[idx - width];
+			double ixy = (buffer[idx + width + 1] - buffer[idx + width - 1]
+						  - buffer[idx - width + 1] + buffer[idx - width - 1])/4;
+
+			double lambda = (ixx + iyy)/2 - sqrt((ixx - iyy)*(ixx - iyy)/4 + ixy*ixy);
+
+			ridge[idx] = lambda < 0 ? -lambda : 0;
+			mean += ridge[idx];
+			meanSquares += ridge[idx]*ridge[idx];
+		}
+	}
+
+	mean /= width*height;
+	double threshold = mean + 2*sqrt(std::max(0.0, meanSquares/(width*height) - mean*mean));
+	double totalWeight = 0;
+
+	for(int j=1; j<height - 1; j++){
+		for(int i=1; i<width - 1; i++){
+
+			int idx = j*width + i;
+			if(ridge[idx] <= threshold)
+				continue;
+
+			double ixx = buffer[idx + 1] - 2*buffer[idx] + buffer[idx - 1];
+			double iyy = buffer[idx + width] - 2*buffer[idx] + buffer[idx - width];
+			double ixy = (buffer[idx + width + 1] - buffer[idx + width - 1]
+						  - buffer[idx - width + 1] + buffer[idx - width - 1])/4;
+
+			// the ridge normal is the eigenvector of the smallest eigenvalue
+			double theta = 0.5*atan2(2*ixy, ixx - iyy) + vtkMath::DoublePi()/2;
+			if(theta >= vtkMath::DoublePi())
+				theta -= vtkMath::DoublePi();
+			if(theta < 0)
+				theta += vtkMath::DoublePi();
+
+			RidgePixel pixel;
+			pixel.x = i;
+			pixel.y = j;
+			pixel.weight = ridge[idx] - threshold;
+			pixel.theta = theta;
+			pixels.push_back(pixel);
+
+			totalWeight += pixel.weight;
+		}
+	}
+
+	if(pixels.size() < 10)
+		return crosswire;
+
+	// each pixel votes only near its own orientation
+	int thetaBins = 180;
+	int diagonal = (int)ceil(sqrt((double)width*width + height*height));
+	int rhoBins = 2*diagonal + 1;
+	std::vector<float> hough(thetaBins*rhoBins, 0);
+
+	for(unsigned int p=0; p<pixels.size(); p++){
+
+		int thetaBin = (int)(pixels[p].theta*180/vtkMath::DoublePi() + 0.5);
+
+		for(int t=thetaBin - 3; t<=thetaBin + 3; t++){
+
+			int bin = (t + thetaBins)%thetaBins;
+			double theta = bin*vtkMath::DoublePi()/thetaBins;
+			int rho = (int)floor(pixels[p].x*cos(theta) + pixels[p].y*sin(theta) + 0.5) + diagonal;
+
+			hough[bin*rhoBins + rho] += pixels[p].weight;
+		}
+	}
+
+	int first = std::max_element(hough.begin(), hough.end()) - hough.begin();
+	int firstTheta = first/rhoBins;
+
+	int second = -1;
+	int minimumBins = (int)(minimumAngle*thetaBins/180);
+
+	for(int bin=0; bin<thetaBins; bin++){
+
+		int angle = abs(bin - firstTheta);
+		if(std::min(angle, thetaBins - angle) < minimumBins)
+			continue;
+
+		for(int rho=0; rho<rhoBins; rho++)
+			if(second < 0 || hough[bin*rhoBins + rho] > hough[second])
+				second = bin*rhoBins + rho;
+	}
+
+	if(second < 0 || hough[second] <= 0)
+		return crosswire;
+
+	RidgeLine lines[2];
+	int peaks[2] = {first, second};
+
+	for(int l=0; l<2; l++){
+		double theta = (peaks[l]/rhoBins)*vtkMath::DoublePi()/thetaBins;
+		double rho = peaks[l]%rhoBins - diagonal;
+		if(!fitRidgeLine(pixels, theta, rho, 2*sigma + 1, lines[l]))
+			return crosswire;
+	}
+
+	double det = lines[0].normal[0]*lines[1].normal[1] - lines[0].normal[1]*lines[1].normal[0];
+	if(fabs(det) < sin(minimumAngle*vtkMath::DoublePi()/180)/2)
+		return crosswire;
+
+	double x = (lines[0].rho*lines[1].normal[1] - lines[1].rho*lines[0].normal[1])/det;
+	double y = (lines[0].normal[0]*lines[1].rho - lines[1].normal[0]*lines[0].rho)/det;
+
+	if(x < 0 || x > width - 1 || y < 0 || y > height - 1)
+		return crosswire;
+
+	crosswire.found = true;
+	crosswire.x = x;
+	crosswire.y = (height - 1) - y;
+
+	// wide angle, balanced lines and little ridge energy out of the two lines
+	double balance = std::min(lines[0].support, lines[1].support)/std::max(lines[0].support, lines[1].support);
+	double explained = std::min(1.0, (lines[0].support + lines[1].support)/totalWeight);
+	crosswire.confidence = fabs(det)*balance*explained;
+
+	return crosswire;
+}
+
+std::vector<CrosswireDetector::Crosswire> CrosswireDetector::getCrosswires()
+{
+	return crosswires;
+}
+
+void CrosswireDetector::setImageStack(std::vector< vtkSmartPointer<vtkImageData> > imageStack)
+{
+	this->imageStack = imageStack;
+}
+
+void CrosswireDetector::setSigma(double sigma)
+{
+	this->sigma = sigma > 0.5 ? sigma : 0.5;
+}
+
+void CrosswireDetector::setMinimumAngle(double minimumAngle)
+{
+	this->minimumAngle = minimumAngle;
+}
+
+void CrosswireDetector::setNumberOfThreads(int numberOfThreads)
+{
+	this->numberOfThreads = std::max(1, numberOfThreads);
+}
@@ -0,0 +1,88 @@
+#ifndef CROSSWIREDETECTOR_H
+#define CROSSWIREDETECTOR_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vector>
+
+//!Finds the crosswire point in the calibration images
+/*!
+  This class finds the intersection of the two wires of the calibration phantom in each
+  image of a stack. The wires are found as bright ridges with the Hessian of the smoothed image,
+  each ridge pixel votes in a Hough transform only near its own orientation, the two strongest
+  lines with different orientations are refined with a weighted least squares fit and the crosswire
+  point is their intersection, with sub-pixel accuracy. The images are processed in parallel.
+  The coordinates are in the same convention as the picked pixels of QVTKImageWidget.h
+  (y grows down from the top of the image).
+*/
+class CrosswireDetector
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static CrosswireDetector *New()
+	{
+			return new CrosswireDetector;
+	}
+
+    /** The crosswire point of one image */
+	struct Crosswire
+	{
+		bool found; ///<Two lines were found and intersect inside the image
+		double x; ///<Column of the crosswire point
+		double y; ///<Row of the crosswire point
+		double confidence; ///<From 0 to 1, low values should be reviewed
+	};
+
+    /**
+     * \brief Set the images to search
+     */
+	void setImageStack(std::vector< vtkSmartPointer<vtkImageData> >);
+
+    /**
+     * \brief Set the standard deviation in pixels of the smoothing, about half the wire width
+     */
+	void setSigma(double);
+
+    /**
+     * \brief Set the minimum angle in degrees between the two wires
+     */
+	void setMinimumAngle(double);
+
+    /**
+     * \brief Set the number of threads, each one processes whole images
+     */
+	void setNumberOfThreads(int);
+
+    /**
+     * \brief Find the crosswire point in all the images
+     */
+	void detect();
+
+    /**
+     * \brief Returns the crosswire point of each image found by detect()
+     */
+	std::vector<Crosswire> getCrosswires();
+
+    /**
+     * \brief Find the crosswire point in one image
+     */
+	Crosswire detectImage(vtkImageData *);
+
+private:
+
+	CrosswireDetector();
+
+	std::vector< vtkSmartPointer<vtkImageData> > imageStack; ///<Images to search
+	std::vector<Crosswire> crosswires; ///<Crosswire point of each image
+	double sigma; ///<Smoothing in pixels
+	double minimumAngle; ///<Minimum angle between the wires in degrees
+	int numberOfThreads; ///<Number of threads
+
+};
+
+#endif // CROSSWIREDETECTOR_H
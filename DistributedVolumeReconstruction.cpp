@@ -0,0 +1,329 @@
+#include "DistributedVolumeReconstruction.h"
+#include "VolumeReconstructionJob.h"
+
+#include <QCoreApplication>
+#include <QProcess>
+#include <QThread>
+#include <QDir>
+#include <QFile>
+
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <time.h>
+
+DistributedVolumeReconstruction::DistributedVolumeReconstruction()
+{
+	resolution = 1;
+	numberOfWorkers = QThread::idealThreadCount();
+	numberOfSlabs = numberOfWorkers;
+	imageMargin = -1;
+	jobDirectory = QDir::tempPath() + "/VolumeReconstructionJob" +
+		QString::number(QCoreApplication::applicationPid());
+	workerCommand = "\"" + QCoreApplication::applicationDirPath() + "/VolumeReconstructionWorker\"";
+}
+
+vtkSmartPointer<vtkImageData> DistributedVolumeReconstruction::generateVolume()
+{
+	std::cout<<"Generating Volume Data with "<<numberOfSlabs<<" slabs and "
+		<<numberOfWorkers<<" workers"<<std::endl;
+	std::cout<<"Job directory: "<<jobDirectory.toAscii().data()<<std::endl;
+
+	clock_t begin = clock();
+	time_t startTime = time(NULL);
+
+	vtkSmartPointer<vtkImageData> volumeData = vtkSmartPointer<vtkImageData>::New();
+	volumeData->SetNumberOfScalarComponents(1);
+	volumeData->SetScalarType(VTK_UNSIGNED_CHAR);
+	volumeData->SetOrigin(0,0,0);
+	volumeData->SetDimensions(volumeSize[0],volumeSize[1],volumeSize[2]);
+	volumeData->SetSpacing(scale[0]*resolution,scale[0]*resolution,scale[0]*resolution);
+	volumeData->AllocateScalars();
+
+	weightData = vtkSmartPointer<vtkImageData>::New();
+	weightData->SetNumberOfScalarComponents(1);
+	weightData->SetScalarType(VTK_FLOAT);
+	weightData->SetOrigin(0,0,0);
+	weightData->SetDimensions(volumeSize[0],volumeSize[1],volumeSize[2]);
+	weightData->SetSpacing(scale[0]*resolution,scale[0]*resolution,scale[0]*resolution);
+	weightData->AllocateScalars();
+
+	std::vector<QString> jobs = writeJobs();
+
+	if(!runWorkers(jobs))
+		std::cout<<"Some slabs could not be reconstructed and are left empty"<<std::endl;
+
+	stitchSlabs(jobs, volumeData, weightData);
+
+	if(!outputFilename.isEmpty()){
+		std::cout<<"Saving Volume in file: "<<outputFilename.toAscii().data()<<std::endl;
+		VolumeReconstructionJob::writeImage(volumeData, std::string(outputFilename.toAscii().data()));
+	}
+
+	// remove the images, jobs and slabs
+	QDir dir(jobDirectory);
+	QStringList files = dir.entryList(QDir::Files);
+	for(int i=0; i<files.size(); i++)
+		dir.remove(files.at(i));
+	QDir().rmdir(jobDirectory);
+
+	clock_t end = clock();
+	std::cout<<std::endl<<"Coordinator CPU time: "<<double(end - begin)*1000/CLOCKS_PER_SEC<<" ms"<<std::endl;
+	std::cout<<"Time elapsed: "<<difftime(time(NULL), startTime)<<" s"<<std::endl;
+
+	return volumeData;
+}
+
+std::vector<QString> DistributedVolumeReconstruction::writeJobs()
+{
+	QDir().mkpath(jobDirectory);
+
+	std::vector<QString> jobs;
+	std::vector<bool> imageWritten(volumeImageStack.size(), false);
+	int emptySlabs = 0;
+
+	double step = scale[1]*resolution;
+
+	for(int s=0; s<numberOfSlabs; s++){
+
+		int first = slabBegin(s);
+		int last = slabBegin(s+1) - 1;
+
+		if(last < first){
+			jobs.push_back(QString());
+			continue;
+		}
+
+		double zLow = volumeOrigin[2] + first*step - imageMargin;
+		double zHigh = volumeOrigin[2] + last*step + imageMargin;
+
+		VolumeReconstructionJob * job = VolumeReconstructionJob::New();
+		job->volumeOrigin = volumeOrigin;
+		job->volumeSize = volumeSize;
+		job->scale = scale;
+		job->resolution = resolution;
+		job->firstSlice = first;
+		job->lastSlice = last;
+		job->outputFilename = std::string(QString(jobDirectory + "/slab%1.mhd").arg(s).toAscii().data());
+
+		for(unsigned int i=0; i<volumeImageStack.size(); i++){
+
+			if(imageMargin >= 0 &&
+			   (imageBoundsZStack.at(i).max_value() < zLow || imageBoundsZStack.at(i).min_value() > zHigh))
+				continue;
+
+			std::string imageFilename = std::string(QString(jobDirectory + "/image%1.mhd").arg(i).toAscii().data());
+
+			if(!imageWritten.at(i)){
+				VolumeReconstructionJob::writeImage(volumeImageStack.at(i), imageFilename);
+				imageWritten.at(i) = true;
+			}
+
+			job->imageFilenames.push_back(imageFilename);
+			job->transformStack.push_back(transformStack.at(i));
+			job->imageBoundsXStack.push_back(imageBoundsXStack.at(i));
+			job->imageBoundsYStack.push_back(imageBoundsYStack.at(i));
+			job->imageBoundsZStack.push_back(imageBoundsZStack.at(i));
+		}
+
+		std::cout<<"Slab "<<s<<": slices "<<first<<" to "<<last<<", "
+			<<job->imageFilenames.size()<<" images"<<std::endl;
+
+		// the voxel based method needs two planes for each voxel
+		QString jobFilename = QString(jobDirectory + "/job%1.txt").arg(s);
+		if(job->imageFilenames.size() < 2){
+			std::cout<<"Slab "<<s<<" has less than two images and is left empty"<<std::endl;
+			jobFilename = QString();
+			emptySlabs++;
+		}else if(!job->write(std::string(jobFilename.toAscii().data()))){
+			std::cout<<"Could not write the job of slab "<<s<<std::endl;
+			jobFilename = QString();
+			emptySlabs++;
+		}
+
+		jobs.push_back(jobFilename);
+		delete job;
+	}
+
+	if(emptySlabs > 0)
+		std::cout<<emptySlabs<<" of "<<numberOfSlabs<<" slabs are left empty"<<std::endl;
+
+	return jobs;
+}
+
+bool DistributedVolumeReconstruction::runWorkers(std::vector<QString> jobs)
+{
+	bool ok = true;
+	unsigned int next = 0;
+	std::vector<QProcess *> running;
+
+	while(next < jobs.size() || !running.empty()){
+
+		while((int)running.size() < numberOfWorkers && next < jobs.size()){
+
+			if(jobs.at(next).isEmpty()){
+				next++;
+				continue;
+			}
+
+			QProcess * worker = new QProcess();
+			worker->setProcessChannelMode(QProcess::ForwardedChannels);
+			worker->start(workerCommand + " \"" + jobs.at(next) + "\"");
+
+			if(!worker->waitForStarted()){
+				std::cout<<"Could not start worker for "<<jobs.at(next).toAscii().data()<<std::endl;
+				jobs.at(next) = QString();
+				ok = false;
+				delete worker;
+			}else{
+				running.push_back(worker);
+			}
+
+			next++;
+		}
+
+		for(unsigned int i=0; i<running.size(); i++){
+
+			QProcess * worker = running.at(i);
+
+			if(worker->state() == QProcess::NotRunning || worker->waitForFinished(50)){
+
+				if(worker->exitStatus() != QProcess::NormalExit || worker->exitCode() != 0){
+					std::cout<<"Worker failed with exit code "<<worker->exitCode()<<std::endl;
+					ok = false;
+				}
+
+				delete worker;
+				running.erase(running.begin() + i);
+				break;
+			}
+		}
+	}
+
+	return ok;
+}
+
+void DistributedVolumeReconstruction::stitchSlabs(std::vector<QString> jobs,
+												  vtkSmartPointer<vtkImageData> volumeData,
+												  vtkSmartPointer<vtkImageData> weightData)
+{
+	std::cout<<"Stitching slabs"<<std::endl;
+
+	int sliceSize = volumeSize[0]*volumeSize[1];
+
+	unsigned char * volumePointer = static_cast<unsigned char *>(volumeData->GetScalarPointer());
+	float * weightPointer = static_cast<float *>(weightData->GetScalarPointer());
+
+	memset(volumePointer, 0, sliceSize*(int)volumeSize[2]*sizeof(unsigned char));
+	memset(weightPointer, 0, sliceSize*(int)volumeSize[2]*sizeof(float));
+
+	for(unsigned int s=0; s<jobs.size(); s++){
+
+		QString slabFilename = QString(jobDirectory + "/slab%1.mhd").arg(s);
+		QString slabWeightsFilename = QString(jobDirectory + "/slab%1_weights.mhd").arg(s);
+
+		if(jobs.at(s).isEmpty() || !QFile::exists(slabFilename) || !QFile::exists(slabWeightsFilename))
+			continue;
+
+		vtkSmartPointer<vtkImageData> slab =
+			VolumeReconstructionJob::readImage(std::string(slabFilename.toAscii().data()));
+		vtkSmartPointer<vtkImageData> slabWeights =
+			VolumeReconstructionJob::readImage(std::string(slabWeightsFilename.toAscii().data()));
+
+		int * dims = slab->GetDimensions();
+		int first = slabBegin(s);
+		int slices = std::min(dims[2], (int)volumeSize[2] - first);
+
+		if(dims[0]*dims[1] != sliceSize || slab->GetScalarType() != VTK_UNSIGNED_CHAR
+			|| slabWeights->GetScalarType() != VTK_FLOAT){
+			std::cout<<"Slab "<<s<<" does not match the volume"<<std::endl;
+			continue;
+		}
+
+		memcpy(volumePointer + first*sliceSize, slab->GetScalarPointer(),
+			   slices*sliceSize*sizeof(unsigned char));
+		memcpy(weightPointer + first*sliceSize, slabWeights->GetScalarPointer(),
+			   slices*sliceSize*sizeof(float));
+	}
+}
+
+int DistributedVolumeReconstruction::slabBegin(int slab)
+{
+	int slices = volumeSize[2];
+	return (int)((double)slab*slices/numberOfSlabs);
+}
+
+vtkSmartPointer<vtkImageData> DistributedVolumeReconstruction::getWeightVolume()
+{
+	return this->weightData;
+}
+
+void DistributedVolumeReconstruction::setImageBoundsStack(std::vector< vnl_vector<double> > imageBoundsXStack
+                                               , std::vector< vnl_vector<double> > imageBoundsYStack
+                                               , std::vector< vnl_vector<double> > imageBoundsZStack)
+{
+    this->imageBoundsXStack = imageBoundsXStack;
+    this->imageBoundsYStack = imageBoundsYStack;
+    this->imageBoundsZStack = imageBoundsZStack;
+}
+
+void DistributedVolumeReconstruction::setScale(vnl_vector<double> scale)
+{
+    this->scale = scale;
+}
+
+void DistributedVolumeReconstruction::setTransformStack(std::vector< vnl_matrix<double> > transformStack)
+{
+    this->transformStack = transformStack;
+}
+
+void DistributedVolumeReconstruction::setVolumeImageStack(
+        std::vector< vtkSmartPointer<vtkImageData> > volumeImageStack)
+{
+    this->volumeImageStack = volumeImageStack;
+}
+
+void DistributedVolumeReconstruction::setVolumeSize(vnl_vector<double> volumeSize)
+{
+    this->volumeSize = volumeSize;
+}
+
+void DistributedVolumeReconstruction::setVolumeOrigin(vnl_vector<double> volumeOrigin)
+{
+    this->volumeOrigin = volumeOrigin;
+}
+
+void DistributedVolumeReconstruction::setResolution(int resolution)
+{
+    this->resolution = resolution;
+}
+
+void DistributedVolumeReconstruction::setNumberOfSlabs(int numberOfSlabs)
+{
+    this->numberOfSlabs = std::max(1, numberOfSlabs);
+}
+
+void DistributedVolumeReconstruction::setNumberOfWorkers(int numberOfWorkers)
+{
+    this->numberOfWorkers = std::max(1, numberOfWorkers);
+}
+
+void DistributedVolumeReconstruction::setImageMargin(double imageMargin)
+{
+    this->imageMargin = imageMargin;
+}
+
+void DistributedVolumeReconstruction::setJobDirectory(QString jobDirectory)
+{
+    this->jobDirectory = jobDirectory;
+}
+
+void DistributedVolumeReconstruction::setWorkerCommand(QString workerCommand)
+{
+    this->workerCommand = workerCommand;
+}
+
+void DistributedVolumeReconstruction::setOutputFilename(QString outputFilename)
+{
+    this->outputFilename = outputFilename;
+}
@@ -0,0 +1,165 @@
+#ifndef DISTRIBUTEDVOLUMERECONSTRUCTION_H
+#define DISTRIBUTEDVOLUMERECONSTRUCTION_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <QString>
+
+#include <vector>
+
+//!Generate a volume with several worker processes
+/*!
+  This class is the coordinator of a distributed voxel based reconstruction. It splits the
+  volume in slabs along z and writes one VolumeReconstructionJob.h per slab in a job directory.
+  The voxel based method takes the two nearest image planes of each voxel among all the images,
+  so by default every slab gets all the images and the stitched volume is the volume of
+  VolumeReconstruction.h. With an image margin each slab only gets the images near it, which is
+  faster but a voxel can then take other planes. Each job is given to a worker process
+  (VolumeReconstructionWorker) that runs VolumeReconstruction.h on its slab and writes the
+  result as a .mhd file. When all workers finish the slabs are stitched in one volume.
+  The job directory can be on a shared file system and the worker command can be a remote
+  shell, so the workers can run in several machines.
+*/
+class DistributedVolumeReconstruction
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static DistributedVolumeReconstruction *New()
+	{
+			return new DistributedVolumeReconstruction;
+	}
+
+    /**
+     * \brief Set the size of the volume data
+     */
+	void setVolumeSize(vnl_vector<double>);
+
+    /**
+     * \brief Set the volume data orgin in the 3D scene
+     */
+	void setVolumeOrigin(vnl_vector<double>);
+
+    /**
+     * \brief Set the image bounds
+     */
+    void setImageBoundsStack(std::vector< vnl_vector<double> >, std::vector< vnl_vector<double> >,
+                              std::vector< vnl_vector<double> >);
+
+    /**
+     * \brief Set image data stack to generate the volume
+     */
+    void setVolumeImageStack(std::vector< vtkSmartPointer< vtkImageData> >);
+
+    /**
+     * \brief Set the transformation for each image used in the reconstruction
+     */
+    void setTransformStack(std::vector< vnl_matrix<double> >);
+
+    /**
+     * \brief Set the scale of the images
+     */
+    void setScale(vnl_vector<double>);
+
+    /**
+     * \brief Set the resolution of the volume
+     */
+    void setResolution(int);
+
+    /**
+     * \brief Set the number of slabs, each one is reconstructed by one worker
+     */
+    void setNumberOfSlabs(int);
+
+    /**
+     * \brief Set the maximum number of workers running at the same time
+     */
+    void setNumberOfWorkers(int);
+
+    /**
+     * \brief Set the distance in mm from the slab for an image to be sent to its worker,
+     * negative to send all the images (default). With a margin the volume is an approximation.
+     */
+    void setImageMargin(double);
+
+    /**
+     * \brief Set the directory where the jobs and slabs are written
+     */
+    void setJobDirectory(QString);
+
+    /**
+     * \brief Set the command that starts a worker, the job file is appended as argument
+     */
+    void setWorkerCommand(QString);
+
+    /**
+     * \brief Set a .mhd file to save the stitched volume
+     */
+    void setOutputFilename(QString);
+
+    /**
+     * \brief Returns the new volume data stitched from the slabs of all workers
+     */
+	vtkSmartPointer<vtkImageData> generateVolume();
+
+    /**
+     * \brief Returns the weight of each voxel of the last generated volume
+     */
+	vtkSmartPointer<vtkImageData> getWeightVolume();
+
+private:
+
+	DistributedVolumeReconstruction();
+
+	vnl_vector<double> volumeSize; ///<Size of the volume
+	vnl_vector<double> volumeOrigin; ///<Where the volume data begins in the 3D scene
+	vnl_vector<double> scale; ///<Scale of the images
+	int resolution; ///<Resolution of the volume
+
+    std::vector< vnl_vector<double> > imageBoundsXStack; ///<Bounds in x of each image
+    std::vector< vnl_vector<double> > imageBoundsYStack; ///<Bounds in y of each image
+    std::vector< vnl_vector<double> > imageBoundsZStack; ///<Bounds in z of each image
+    std::vector< vtkSmartPointer< vtkImageData> > volumeImageStack; ///<The stack of images data
+    std::vector< vnl_matrix<double> > transformStack; ///<Transformation of each image
+
+	int numberOfSlabs; ///<Number of slabs
+	int numberOfWorkers; ///<Number of concurrent workers
+	double imageMargin; ///<Distance from the slab to include an image, negative for all the images
+	QString jobDirectory; ///<Directory for the job files
+	QString workerCommand; ///<Command to start a worker
+	QString outputFilename; ///<File to save the stitched volume
+
+	vtkSmartPointer<vtkImageData> weightData; ///<Weights of the stitched volume
+
+    /**
+     * \brief Write the images and the job of each slab
+     * \param[out] the job file of each slab, empty if the slab has less than two images
+     */
+	std::vector<QString> writeJobs();
+
+    /**
+     * \brief Run the workers for all the jobs
+     * \param[out] false if a worker failed
+     */
+	bool runWorkers(std::vector<QString>);
+
+    /**
+     * \brief Copy the slabs written by the workers in the volume and weight data
+     */
+	void stitchSlabs(std::vector<QString>, vtkSmartPointer<vtkImageData>, vtkSmartPointer<vtkImageData>);
+
+    /**
+     * \brief Returns the first slice of a slab
+     */
+	int slabBegin(int);
+
+};
+
+#endif // DISTRIBUTEDVOLUMERECONSTRUCTION_H
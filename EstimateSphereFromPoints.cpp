@@ -2,9 +2,122 @@
 #include "SphereFunction.h"
 
 #include <vnl/algo/vnl_levenberg_marquardt.h>
+#include <vnl/algo/vnl_svd.h>
 #include <iostream>
+#include <algorithm>
 #include <math.h>
 #include <QErrorMessage>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QTime>
+
+/** Tests RANSAC spheres through random sets of 4 points */
+class SphereHypothesisTask : public QRunnable
+{
+public:
+
+	SphereHypothesisTask(const std::vector<double> *x, const std::vector<double> *y, const std::vector<double> *z,
+						 double threshold, int iterations, unsigned int seed)
+		: x(x), y(y), z(z), threshold(threshold), iterations(iterations), seed(seed), bestCount(0)
+	{
+		setAutoDelete(false);
+	}
+
+	void run()
+	{
+		int n = x->size();
+		double requiredIterations = iterations;
+
+		vnl_matrix<double> sample(4,3);
+		vnl_vector<double> hypothesis(4);
+
+		// squared distances are scored in blocks so the inner loop has no branches
+		const int blockSize = 256;
+		double distances[blockSize];
+
+		for(int it=0; it<iterations && it<requiredIterations; it++){
+
+			for(int i=0; i<4; i++){
+				int idx = nextRandom()%n;
+				sample(i,0) = (*x)[idx];
+				sample(i,1) = (*y)[idx];
+				sample(i,2) = (*z)[idx];
+			}
+
+			if(!EstimateSphereFromPoints::algebraicSphere(sample, hypothesis))
+				continue;
+
+			const double cx = hypothesis[0];
+			const double cy = hypothesis[1];
+			const double cz = hypothesis[2];
+
+			// |d - r| < t is the same as (r - t)^2 < d^2 < (r + t)^2
+			const double inner = std::max(0.0, hypothesis[3] - threshold);
+			const double minimum = inner*inner;
+			const double maximum = (hypothesis[3] + threshold)*(hypothesis[3] + threshold);
+
+			int count = 0;
+			for(int start=0; start<n; start+=blockSize){
+
+				int size = std::min(blockSize, n - start);
+				const double *px = &(*x)[start];
+				const double *py = &(*y)[start];
+				const double *pz = &(*z)[start];
+
+				for(int i=0; i<size; i++){
+					double dx = px[i] - cx;
+					double dy = py[i] - cy;
+					double dz = pz[i] - cz;
+					distances[i] = dx*dx + dy*dy + dz*dz;
+				}
+
+				for(int i=0; i<size; i++)
+					count += (distances[i] > minimum) & (distances[i] < maximum);
+			}
+
+			if(count > bestCount){
+				bestCount = count;
+				bestSphere = hypothesis;
+
+				// hypotheses needed to draw an outlier free set with probability 0.99
+				double w = pow((double)count/n, 4);
+				if(w >= 1)
+					requiredIterations = 0;
+				else if(w > 0)
+					requiredIterations = log(0.01)/log(1 - w);
+			}
+		}
+	}
+
+	int bestCount;
+	vnl_vector<double> bestSphere;
+
+private:
+
+	/** linear congruential generator, each task has its own sequence, two draws give 30 bits */
+	unsigned int nextRandom()
+	{
+		seed = seed*1103515245 + 12345;
+		unsigned int high = (seed >> 16) & 0x7fff;
+		seed = seed*1103515245 + 12345;
+		return (high << 15) | ((seed >> 16) & 0x7fff);
+	}
+
+	const std::vector<double> *x;
+	const std::vector<double> *y;
+	const std::vector<double> *z;
+	double threshold;
+	int iterations;
+	unsigned int seed;
+};
+
+EstimateSphereFromPoints::EstimateSphereFromPoints()
+{
+	inlierThreshold = 1.0;
+	maximumIterations = 1000;
+	numberOfThreads = QThread::idealThreadCount();
+}
 
 
 void EstimateSphereFromPoints::setPoints(vnl_matrix<double> points)
@@ -17,41 +130,84 @@ vnl_vector<double> EstimateSphereFromPoints::getSphere()
     return sphere;
 }
 
+bool EstimateSphereFromPoints::algebraicSphere(vnl_matrix<double> const &points, vnl_vector<double> &sphere)
+{
+	// normal equations of [2x 2y 2z 1] * [a b c d]' = x^2+y^2+z^2, accumulated in one pass
+	vnl_matrix<double> AtA(4,4,0);
+	vnl_vector<double> Atb(4,0);
+
+	for(unsigned int i=0; i<points.rows(); i++)
+	{
+		double row[4] = {2*points(i,0), 2*points(i,1), 2*points(i,2), 1};
+		double b = points(i,0)*points(i,0) + points(i,1)*points(i,1) + points(i,2)*points(i,2);
+
+		for(int j=0; j<4; j++)
+		{
+			for(int k=j; k<4; k++)
+				AtA(j,k) += row[j]*row[k];
+			Atb[j] += row[j]*b;
+		}
+	}
+
+	for(int j=0; j<4; j++)
+		for(int k=0; k<j; k++)
+			AtA(j,k) = AtA(k,j);
+
+	vnl_svd<double> svd(AtA);
+	if(points.rows() < 4 || svd.rank() < 4)
+		return false;
+
+	vnl_vector<double> solution = svd.solve(Atb);
+	double r2 = solution[3] + solution[0]*solution[0] + solution[1]*solution[1] + solution[2]*solution[2];
+	if(r2 <= 0)
+		return false;
+
+	sphere.set_size(4);
+	sphere[0] = solution[0];
+	sphere[1] = solution[1];
+	sphere[2] = solution[2];
+	sphere[3] = sqrt(r2);
+
+	return true;
+}
+
 void EstimateSphereFromPoints::estimateSphere()
 {
 
 	double nPoints = points.rows();
 
 	std::cout<<std::endl;
-	std::cout<<"Number of surface points "<<nPoints<<std::endl;		
+	std::cout<<"Number of surface points "<<nPoints<<std::endl;
 
-	double pCenterX = points.get_column(0).mean();
-	double pCenterY = points.get_column(1).mean();
-	double pCenterZ = points.get_column(2).mean();
+	vnl_vector<double> x(4);
 
-	std::cout<<std::endl;
-	std::cout<<"Initial values for center "<<pCenterX<<", "<<pCenterY<<", "<<pCenterZ<<std::endl;
+	if(!algebraicSphere(points, x))
+	{
+		// degenerate points, start from the centroid and the mean distance
+		x[0] = points.get_column(0).mean();
+		x[1] = points.get_column(1).mean();
+		x[2] = points.get_column(2).mean();
 
-	vnl_vector<double> dist;
-	dist.set_size(points.rows());
+		double distances = 0;
+		for(int i=0; i<points.rows(); i++)
+			distances += sqrt(pow(points(i,0) - x[0],2) + pow(points(i,1) - x[1],2) + pow(points(i,2) - x[2],2));
 
-	for(int i=0; i<points.rows(); i++)
-	{
-		vnl_vector<double> sPoint = points.get_row(i);
-		dist[i] = sqrt(pow((pCenterX - sPoint[0]),2) + pow((pCenterY - sPoint[1]),2) + pow((pCenterZ - sPoint[2]),2));
+		x[3] = nPoints > 0 ? distances/nPoints : 0;
 	}
 
-	double pRadius = dist.mean();
-
 	std::cout<<std::endl;
-	std::cout<<"Initial values for radius "<<pRadius<<std::endl<<std::endl;
+	std::cout<<"Initial values for center "<<x[0]<<", "<<x[1]<<", "<<x[2]<<std::endl;
+	std::cout<<std::endl;
+	std::cout<<"Initial values for radius "<<x[3]<<std::endl<<std::endl;
 
-	vnl_vector<double> x(4);
-	x.put(0,pCenterX);
-	x.put(1,pCenterY);
-	x.put(2,pCenterZ);
-	x.put(3,pRadius);
+	refineSphere(points, x);
+
+	sphere.set_size(4);
+	sphere = x;
+}
 
+void EstimateSphereFromPoints::refineSphere(vnl_matrix<double> &points, vnl_vector<double> &x)
+{
 	SphereFunction sphereFunc(&points);
 
 	vnl_levenberg_marquardt LM(sphereFunc);
@@ -60,7 +216,8 @@ void EstimateSphereFromPoints::estimateSphere()
     LM.set_f_tolerance(1e-6);
     LM.set_x_tolerance(1e-6);
 
-    LM.set_max_function_evals(100*nPoints);
+    // the analytic jacobian and the algebraic initial values converge in a few iterations
+    LM.set_max_function_evals(50);
     
     bool okOptimization = false;
     
@@ -75,8 +232,109 @@ void EstimateSphereFromPoints::estimateSphere()
 
 	LM.diagnose_outcome(std::cout);
 	std::cout<<std::endl<<"Sphere = " << x << std::endl;
+}
+
+bool EstimateSphereFromPoints::estimateSphereRANSAC()
+{
+	int nPoints = points.rows();
+
+	std::cout<<std::endl;
+	std::cout<<"Estimating sphere with RANSAC from "<<nPoints<<" surface points"<<std::endl;
+
+	inliers.assign(nPoints, false);
+
+	if(nPoints < 4){
+		std::cout<<"Not enough surface points"<<std::endl;
+		return false;
+	}
+
+	std::vector<double> x(nPoints), y(nPoints), z(nPoints);
+	for(int i=0; i<nPoints; i++){
+		x[i] = points(i,0);
+		y[i] = points(i,1);
+		z[i] = points(i,2);
+	}
+
+	QTime timer;
+	timer.start();
+
+	int threads = std::max(1, numberOfThreads);
+	QThreadPool pool;
+	pool.setMaxThreadCount(threads);
+
+	std::vector<SphereHypothesisTask *> tasks;
+	for(int t=0; t<threads; t++){
+		int iterations = (maximumIterations + threads - 1)/threads;
+		tasks.push_back(new SphereHypothesisTask(&x, &y, &z, inlierThreshold, iterations, 12345 + 7919*t));
+		pool.start(tasks.back());
+	}
+	pool.waitForDone();
+
+	SphereHypothesisTask *best = tasks.front();
+	for(int t=1; t<threads; t++)
+		if(tasks.at(t)->bestCount > best->bestCount)
+			best = tasks.at(t);
+
+	vnl_vector<double> hypothesis = best->bestSphere;
+	int count = best->bestCount;
+
+	for(int t=0; t<threads; t++)
+		delete tasks.at(t);
+
+	if(count < 4){
+		std::cout<<"No sphere found"<<std::endl;
+		return false;
+	}
+
+	vnl_matrix<double> inlierPoints(nPoints, 3);
+	int idx = 0;
+	for(int i=0; i<nPoints; i++){
+		double distance = sqrt(pow(x[i] - hypothesis[0],2) + pow(y[i] - hypothesis[1],2) + pow(z[i] - hypothesis[2],2));
+		if(fabs(distance - hypothesis[3]) < inlierThreshold){
+			inliers[i] = true;
+			inlierPoints.set_row(idx++, points.get_row(i));
+		}
+	}
+	if(idx < 4){
+		std::cout<<"No sphere found"<<std::endl;
+		return false;
+	}
+
+	inlierPoints = inlierPoints.extract(idx, 3);
+
+	std::cout<<"Inliers: "<<idx<<" of "<<nPoints<<" points, RANSAC time: "<<timer.elapsed()<<" ms with "
+		<<threads<<" threads"<<std::endl;
+
+	// the algebraic sphere of all the inliers is a better start than the 4 point sphere
+	vnl_vector<double> initial(4);
+	if(algebraicSphere(inlierPoints, initial))
+		hypothesis = initial;
+
+	refineSphere(inlierPoints, hypothesis);
 
 	sphere.set_size(4);
-	sphere = x;
+	sphere = hypothesis;
+
+	return true;
+}
+
+void EstimateSphereFromPoints::setInlierThreshold(double threshold)
+{
+	inlierThreshold = threshold;
+}
+
+void EstimateSphereFromPoints::setMaximumIterations(int iterations)
+{
+	maximumIterations = std::max(1, iterations);
+}
+
+void EstimateSphereFromPoints::setNumberOfThreads(int threads)
+{
+	numberOfThreads = std::max(1, threads);
+}
+
+std::vector<bool> EstimateSphereFromPoints::getInliers()
+{
+	return inliers;
 }
 
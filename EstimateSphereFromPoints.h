@@ -6,11 +6,16 @@
 #include <vnl/vnl_matrix.h>
 #include <vnl/vnl_vector.h>
 
+#include <vector>
+
 //!ObtEstimate a sphere center and radius
 /*!
   This class estimate a sphere using the general ecuation of the sphere (SphereFunction.h)
   I creates a non linear equation system using several points on the surface of the sphere
-  and solve it using vnl_levenberg_marquardt.h.
+  and solve it using vnl_levenberg_marquardt.h. The initial values are the closed form
+  solution of the linear (algebraic) sphere fit, so only a few iterations are needed.
+  estimateSphereRANSAC() rejects stray traced points, the minimal 4 point spheres are tested
+  in parallel and the sphere is refined with the points closer than the inlier threshold.
 */
 class EstimateSphereFromPoints
 {
@@ -33,12 +38,49 @@ public:
 	/** \brief Estimate Sphere using levenberg-mardquart */
     void estimateSphere();
 
+	/** \brief Estimate Sphere with RANSAC and refine it with levenberg-mardquart on the inliers,
+	 * returns false if no sphere was found */
+    bool estimateSphereRANSAC();
+
+	/** \brief Set the maximum distance in mm from an inlier point to the sphere surface */
+    void setInlierThreshold(double);
+
+	/** \brief Set the maximum number of 4 point spheres tested by RANSAC */
+    void setMaximumIterations(int);
+
+	/** \brief Set the number of threads testing spheres */
+    void setNumberOfThreads(int);
+
+	/** \brief Return which points agree with the sphere estimated by RANSAC */
+    std::vector<bool> getInliers();
+
+	/** \brief Closed form sphere of the linear system x^2+y^2+z^2 = 2ax + 2by + 2cz + d,
+	 * returns false if the points are degenerate */
+    static bool algebraicSphere(vnl_matrix<double> const &, vnl_vector<double> &);
+
 private:
 
+	EstimateSphereFromPoints();
+
+	/** \brief Minimize the sphere equation with levenberg-mardquart from the initial sphere */
+    void refineSphere(vnl_matrix<double> &, vnl_vector<double> &);
+
 	/** \brief The manualy selected surface Points */
     vnl_matrix<double> points;
 
 	/** \brief The estimated sphere */
     vnl_vector<double> sphere;
 
+	/** \brief Points that agree with the RANSAC sphere */
+    std::vector<bool> inliers;
+
+	/** \brief RANSAC inlier distance in mm */
+    double inlierThreshold;
+
+	/** \brief Maximum number of RANSAC hypotheses */
+    int maximumIterations;
+
+	/** \brief Number of threads testing hypotheses */
+    int numberOfThreads;
+
 };
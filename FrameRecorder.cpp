@@ -0,0 +1,294 @@
+#include "FrameRecorder.h"
+#include "FrameSource.h"
+#include "PoseRing.h"
+
+#include <string.h>
+#include <iostream>
+
+const char FrameRecorder::fileMagic[8] = {'U','S','F','R','A','M','E','1'};
+
+/** Frames of each chunk of the index, 10 minutes at 30 Hz */
+static const unsigned int indexChunkEntries = 18000;
+
+/** Free entries left in the index when the writer allocates the next chunk, 10 s at 30 Hz */
+static const unsigned int indexChunkMargin = 300;
+
+/** Maximum time in ms the writer waits for the tracker sample after a frame */
+static const int maximumPoseWait = 100;
+
+FrameRecorder::FrameRecorder(QString filename, FrameSource * source, PoseRing * ring, int buffers)
+	: filename(filename), fileOffset(0), source(source), ring(ring), captureThread(this),
+	numberOfBuffers(buffers < 2 ? 2 : buffers), frameSize(0), captureBuffer(0), writeBuffer(0),
+	poseCursor(0), hasLastPose(false), hasNextPose(false), indexEntries(0), captureStopRequested(false),
+	stopRequested(false), recording(false)
+{
+	recordedFrames = 0;
+	droppedFrames = 0;
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	close();
+}
+
+bool FrameRecorder::open()
+{
+	if(recording)
+		return true;
+
+	if(!source->open())
+	{
+		std::cout<<"Could not open the frame source"<<std::endl;
+		return false;
+	}
+
+	file.open(filename.toAscii().data(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout<<"Could not create the recording "<<filename.toAscii().data()<<std::endl;
+		source->close();
+		return false;
+	}
+
+	FileHeader header;
+	memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.width = source->getWidth();
+	header.height = source->getHeight();
+	header.frameRate = source->getFrameRate();
+	file.write((const char *)&header, sizeof(header));
+	fileOffset = sizeof(header);
+
+	// all the memory of the recording is allocated here, the threads only copy into it
+	frameSize = header.width*header.height;
+	buffers.assign(numberOfBuffers*frameSize, 0);
+	dropBuffer.assign(frameSize, 0);
+	frameSlots.resize(numberOfBuffers);
+	index.clear();
+	indexEntries = 0;
+	reserveIndex();
+
+	freeBuffers.acquire(freeBuffers.available());
+	usedBuffers.acquire(usedBuffers.available());
+	freeBuffers.release(numberOfBuffers);
+	captureBuffer = 0;
+	writeBuffer = 0;
+
+	hasLastPose = false;
+	hasNextPose = false;
+	if(ring)
+		poseCursor = ring->cursor();
+
+	recordedFrames = 0;
+	droppedFrames = 0;
+	captureStopRequested = false;
+	stopRequested = false;
+	recording = true;
+
+	start(QThread::NormalPriority);
+	captureThread.start(QThread::HighPriority);
+
+	std::cout<<"Recording "<<header.width<<"x"<<header.height<<" frames at "<<header.frameRate<<" Hz in "
+		<<filename.toAscii().data()<<std::endl;
+
+	return true;
+}
+
+void FrameRecorder::close()
+{
+	if(!recording)
+		return;
+
+	captureStopRequested = true;
+	captureThread.wait();
+
+	// the writer empties the buffers before it finishes
+	stopRequested = true;
+	wait();
+
+	FileFooter footer;
+	footer.indexOffset = fileOffset;
+	footer.numberOfFrames = indexEntries;
+	footer.droppedFrames = getDroppedFrames();
+	memcpy(footer.magic, fileMagic, sizeof(fileMagic));
+
+	for(unsigned int c = 0; c < index.size(); c++)
+		if(!index[c].empty())
+			file.write((const char *)&index[c][0], index[c].size()*sizeof(IndexEntry));
+	file.write((const char *)&footer, sizeof(footer));
+	file.close();
+
+	source->close();
+	recording = false;
+
+	std::cout<<"Recorded "<<footer.numberOfFrames<<" frames, "<<footer.droppedFrames<<" dropped"<<std::endl;
+}
+
+bool FrameRecorder::isRecording()
+{
+	return recording;
+}
+
+unsigned int FrameRecorder::getRecordedFrames()
+{
+	return (unsigned int)recordedFrames.fetchAndAddAcquire(0);
+}
+
+unsigned int FrameRecorder::getDroppedFrames()
+{
+	return (unsigned int)droppedFrames.fetchAndAddAcquire(0);
+}
+
+void FrameRecorder::capture()
+{
+	unsigned int frame = 0;
+
+	while(!captureStopRequested)
+	{
+		// a full ring drops the frame, the grabber can not wait for the disk
+		if(!freeBuffers.tryAcquire())
+		{
+			double time;
+			if(!source->grab(&dropBuffer[0], time))
+				break;
+
+			droppedFrames.fetchAndAddOrdered(1);
+			frame++;
+			continue;
+		}
+
+		Slot & slot = frameSlots[captureBuffer];
+		if(!source->grab(&buffers[captureBuffer*frameSize], slot.time))
+		{
+			freeBuffers.release();
+			break;
+		}
+
+		slot.index = frame++;
+		slot.droppedFrames = getDroppedFrames();
+
+		captureBuffer = (captureBuffer + 1)%numberOfBuffers;
+		usedBuffers.release();
+	}
+}
+
+void FrameRecorder::run()
+{
+	while(true)
+	{
+		if(!usedBuffers.tryAcquire(1, 10))
+		{
+			// the capture stopped before, every captured frame was released already
+			if(stopRequested && usedBuffers.available() == 0)
+				break;
+			continue;
+		}
+
+		write(frameSlots[writeBuffer], &buffers[writeBuffer*frameSize]);
+
+		writeBuffer = (writeBuffer + 1)%numberOfBuffers;
+		freeBuffers.release();
+
+		// the buffer is back to the capture before the index grows
+		reserveIndex();
+	}
+
+	file.flush();
+}
+
+void FrameRecorder::reserveIndex()
+{
+	if((indexEntries + indexChunkMargin)/indexChunkEntries < index.size())
+		return;
+
+	index.push_back(std::vector<IndexEntry>());
+	index.back().reserve(indexChunkEntries);
+}
+
+void FrameRecorder::readPoses(double time)
+{
+	// the samples up to the frame time, and the first one after it if it arrived
+	while(true)
+	{
+		if(!hasNextPose)
+			hasNextPose = ring->next(poseCursor, nextPose);
+		if(!hasNextPose || nextPose.time > time)
+			break;
+
+		lastPose = nextPose;
+		hasLastPose = true;
+		hasNextPose = false;
+	}
+}
+
+void FrameRecorder::findPose(double time, TrackingSample & pose)
+{
+	pose.time = -1;
+	pose.readTime = -1;
+	pose.numberOfTools = 0;
+
+	if(!ring)
+		return;
+
+	// the writer is usually less than a tracker period behind the capture, the sample after the
+	// frame may not have arrived yet, it is waited for while the tracker is updating
+	for(int wait = 0; wait < maximumPoseWait; wait++)
+	{
+		readPoses(time);
+		if(hasNextPose || !hasLastPose || time - lastPose.time > maximumPoseWait || stopRequested)
+			break;
+		msleep(1);
+	}
+
+	if(hasLastPose && (!hasNextPose || time - lastPose.time <= nextPose.time - time))
+		pose = lastPose;
+	else if(hasNextPose)
+		pose = nextPose;
+}
+
+void FrameRecorder::write(const Slot & slot, const unsigned char * pixels)
+{
+	FrameHeader header;
+	header.index = slot.index;
+	header.droppedFrames = slot.droppedFrames;
+	header.time = slot.time;
+	findPose(slot.time, header.pose);
+
+	IndexEntry entry;
+	entry.index = slot.index;
+	entry.reserved = 0;
+	entry.time = slot.time;
+	entry.offset = fileOffset;
+
+	// the writer loop allocates the chunks ahead, a full index is only grown here as a fallback
+	if(indexEntries/indexChunkEntries >= index.size())
+		reserveIndex();
+	index[indexEntries/indexChunkEntries].push_back(entry);
+	indexEntries++;
+
+	file.write((const char *)&header, sizeof(header));
+	file.write((const char *)pixels, frameSize);
+	fileOffset += sizeof(header) + frameSize;
+
+	recordedFrames.fetchAndAddOrdered(1);
+}
+
+bool FrameRecorder::readIndex(std::ifstream & file, FileHeader & header, std::vector<IndexEntry> & index)
+{
+	file.seekg(0, std::ios::beg);
+	file.read((char *)&header, sizeof(header));
+	if(!file || memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0)
+		return false;
+
+	FileFooter footer;
+	file.seekg(-(std::streamoff)sizeof(footer), std::ios::end);
+	file.read((char *)&footer, sizeof(footer));
+	if(!file || memcmp(footer.magic, fileMagic, sizeof(fileMagic)) != 0)
+		return false;
+
+	index.resize(footer.numberOfFrames);
+	file.seekg(footer.indexOffset, std::ios::beg);
+	if(footer.numberOfFrames > 0)
+		file.read((char *)&index[0], footer.numberOfFrames*sizeof(IndexEntry));
+
+	return !file.fail();
+}
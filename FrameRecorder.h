@@ -0,0 +1,189 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QString>
+
+#include "TrackingSample.h"
+
+#include <vector>
+#include <deque>
+#include <fstream>
+
+class FrameSource;
+class PoseRing;
+
+//!Records the ultrasound frames with the tracker poses in one file
+/*!
+  A capture thread grabs the frames of a FrameSource into a ring of buffers allocated when the
+  recording starts, and this thread writes them to the file one after another, so the capture
+  never waits for the disk and no memory is allocated per frame. When the writer falls behind and
+  all the buffers are full the frame is dropped and counted. Each frame is written with the
+  tracking sample of the PoseRing closest in time to the frame.
+
+  File format, native byte order: a FileHeader, the frames, each one a FrameHeader followed by
+  width*height pixels, then the index, an IndexEntry per frame, and a FileFooter at the end of
+  the file. The index is written when the recording is closed. FrameRecordingConverter.cpp
+  exports a recording as the images and the pose files of the offline tools.
+*/
+class FrameRecorder : public QThread
+{
+
+public:
+
+	/** Beginning of the file */
+	struct FileHeader
+	{
+		char magic[8]; ///<fileMagic
+		int width; ///<Width of the frames
+		int height; ///<Height of the frames
+		double frameRate; ///<Frames per second of the source
+	};
+
+	/** Header of each frame */
+	struct FrameHeader
+	{
+		unsigned int index; ///<Number of the frame grabbed, the dropped frames are not written
+		unsigned int droppedFrames; ///<Frames dropped before this frame since the start
+		double time; ///<Time in milliseconds of igstk::RealTimeClock of the frame
+		TrackingSample pose; ///<Closest sample in time, without tools if the tracker had no sample
+	};
+
+	/** Position of a frame in the file */
+	struct IndexEntry
+	{
+		unsigned int index; ///<Number of the frame
+		unsigned int reserved; ///<Unused
+		double time; ///<Time of the frame
+		qint64 offset; ///<Position of the FrameHeader in the file
+	};
+
+	/** End of the file */
+	struct FileFooter
+	{
+		qint64 indexOffset; ///<Position of the first IndexEntry in the file
+		unsigned int numberOfFrames; ///<Frames written
+		unsigned int droppedFrames; ///<Frames dropped
+		char magic[8]; ///<fileMagic
+	};
+
+	static const char fileMagic[8]; ///<First and last bytes of the file
+
+    /**
+     * \brief Constructor
+     * \param[in] file to write, frame source and samples of the tracker, NULL to record without poses
+     * \param[in] number of frame buffers
+     */
+	FrameRecorder(QString, FrameSource *, PoseRing *, int buffers = 64);
+
+	~FrameRecorder();
+
+    /**
+     * \brief Open the source and the file, allocate the buffers and start the capture and the writer
+     * \return false if the source or the file could not be opened
+     */
+	bool open();
+
+    /**
+     * \brief Stop the capture, write the buffered frames and the index and close the file
+     */
+	void close();
+
+    /**
+     * \brief Returns true while recording
+     */
+	bool isRecording();
+
+    /**
+     * \brief Returns the number of frames written
+     */
+	unsigned int getRecordedFrames();
+
+    /**
+     * \brief Returns the number of frames dropped because the buffers were full
+     */
+	unsigned int getDroppedFrames();
+
+    /**
+     * \brief Read the header and the index of a recording
+     * \return false if the file is not a complete recording
+     */
+	static bool readIndex(std::ifstream &, FileHeader &, std::vector<IndexEntry> &);
+
+protected:
+
+	/** \brief Write the captured frames until the recording is closed */
+	void run();
+
+private:
+
+	/** Thread that grabs the frames */
+	class CaptureThread : public QThread
+	{
+	public:
+		CaptureThread(FrameRecorder * recorder) : recorder(recorder) {}
+	protected:
+		void run() { recorder->capture(); }
+	private:
+		FrameRecorder * recorder;
+	};
+	friend class CaptureThread;
+
+	/** A captured frame waiting to be written */
+	struct Slot
+	{
+		unsigned int index; ///<Number of the frame
+		unsigned int droppedFrames; ///<Frames dropped before it
+		double time; ///<Time of the frame
+	};
+
+	/** \brief Grab the frames into the free buffers until the capture is stopped */
+	void capture();
+
+	/** \brief Read the tracker samples up to a frame time and the first sample after it */
+	void readPoses(double);
+
+	/** \brief Find the tracker sample closest in time to a frame */
+	void findPose(double, TrackingSample &);
+
+	/** \brief Write a captured frame */
+	void write(const Slot &, const unsigned char *);
+
+	/** \brief Allocate the next chunk of the index before the last one is full */
+	void reserveIndex();
+
+	QString filename; ///<Recording file
+	std::ofstream file; ///<Recording file stream
+	qint64 fileOffset; ///<Bytes written
+	FrameSource * source; ///<The frames
+	PoseRing * ring; ///<The tracker samples, NULL to record without poses
+	CaptureThread captureThread; ///<Grabs the frames
+
+	int numberOfBuffers; ///<Frame buffers
+	int frameSize; ///<Bytes of a frame
+	std::vector<unsigned char> buffers; ///<Pixels of the buffers, allocated by open()
+	std::vector<unsigned char> dropBuffer; ///<Pixels of the dropped frames
+	std::vector<Slot> frameSlots; ///<Frame of each buffer
+	QSemaphore freeBuffers; ///<Buffers the capture can fill
+	QSemaphore usedBuffers; ///<Buffers the writer must write
+	unsigned int captureBuffer; ///<Next buffer of the capture
+	unsigned int writeBuffer; ///<Next buffer of the writer
+
+	unsigned int poseCursor; ///<Cursor of the writer in the ring
+	TrackingSample lastPose; ///<Newest sample up to the time of the last frame
+	TrackingSample nextPose; ///<Sample after lastPose, read ahead
+	bool hasLastPose; ///<lastPose has a sample
+	bool hasNextPose; ///<nextPose has a sample
+
+	std::deque< std::vector<IndexEntry> > index; ///<Position of each frame written, in chunks that are never copied
+	unsigned int indexEntries; ///<Frames in the index
+	QAtomicInt recordedFrames; ///<Frames written
+	QAtomicInt droppedFrames; ///<Frames dropped
+	volatile bool captureStopRequested; ///<The capture must stop
+	volatile bool stopRequested; ///<The writer must stop after the buffered frames
+	bool recording; ///<The recording is open
+};
+
+#endif // FRAMERECORDER_H
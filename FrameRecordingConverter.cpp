@@ -0,0 +1,129 @@
+#include "FrameRecorder.h"
+
+#include "itkVersor.h"
+
+#include "vtkSmartPointer.h"
+#include "vtkImageData.h"
+#include "vtkBMPWriter.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Exports a frame recording written by FrameRecorder.h as the files the offline tools load.
+
+  Usage: FrameRecordingConverter recordingFile outputDirectory [tool]
+
+  The frames are written as outputDirectory/IMG0000.bmp, IMG0001.bmp, ... and the pose of the
+  tool, 1 (the ultrasound probe) by default, as one line per image in Rotations.txt, the
+  quaternion w x y z, and Translations.txt, x y z. FrameTimes.txt has the frame number, the
+  frame time and the tracker time of the pose of each image. The frames without a valid pose of
+  the tool are not exported.
+*/
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr<<"Usage: "<<argv[0]<<" recordingFile outputDirectory [tool]"<<std::endl;
+		return 1;
+	}
+
+	int tool = argc > 3 ? atoi(argv[3]) : 1;
+	std::string directory = argv[2];
+
+	std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+	if (!input.is_open())
+	{
+		std::cerr<<"Could not open "<<argv[1]<<std::endl;
+		return 1;
+	}
+
+	FrameRecorder::FileHeader header;
+	std::vector<FrameRecorder::IndexEntry> index;
+	if (!FrameRecorder::readIndex(input, header, index))
+	{
+		std::cerr<<argv[1]<<" is not a complete frame recording"<<std::endl;
+		return 1;
+	}
+
+	std::ofstream rotations((directory + "/Rotations.txt").c_str());
+	std::ofstream translations((directory + "/Translations.txt").c_str());
+	std::ofstream times((directory + "/FrameTimes.txt").c_str());
+	if (!rotations.is_open() || !translations.is_open() || !times.is_open())
+	{
+		std::cerr<<"Could not create the pose files in "<<directory<<std::endl;
+		return 1;
+	}
+	rotations.precision(10);
+	translations.precision(10);
+	times.precision(10);
+
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->SetDimensions(header.width, header.height, 1);
+	image->SetScalarTypeToUnsignedChar();
+	image->SetNumberOfScalarComponents(1);
+	image->AllocateScalars();
+
+	vtkSmartPointer<vtkBMPWriter> writer = vtkSmartPointer<vtkBMPWriter>::New();
+	writer->SetInput(image);
+
+	const int frameSize = header.width*header.height;
+	unsigned int exported = 0;
+	unsigned int withoutPose = 0;
+	unsigned int missing = 0;
+
+	for (unsigned int f = 0; f < index.size(); f++)
+	{
+		FrameRecorder::FrameHeader frame;
+		input.seekg(index[f].offset, std::ios::beg);
+		input.read(reinterpret_cast<char *>(&frame), sizeof(frame));
+		input.read(static_cast<char *>(image->GetScalarPointer()), frameSize);
+		if (!input)
+		{
+			std::cerr<<"The frame "<<index[f].index<<" is truncated"<<std::endl;
+			break;
+		}
+
+		if (f > 0 && index[f].index != index[f - 1].index + 1)
+			missing += index[f].index - index[f - 1].index - 1;
+
+		const TrackingSample &pose = frame.pose;
+		if (tool >= pose.numberOfTools || !pose.valid[tool])
+		{
+			withoutPose++;
+			continue;
+		}
+
+		itk::Versor<double>::MatrixType matrix;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				matrix(i,j) = pose.rotation[tool][3*i + j];
+
+		itk::Versor<double> versor;
+		versor.Set(matrix);
+
+		rotations<<versor.GetW()<<" "<<versor.GetX()<<" "<<versor.GetY()<<" "<<versor.GetZ()<<"\n";
+		translations<<pose.translation[tool][0]<<" "<<pose.translation[tool][1]<<" "
+			<<pose.translation[tool][2]<<"\n";
+		times<<frame.index<<" "<<frame.time<<" "<<pose.toolTime[tool]<<"\n";
+
+		std::ostringstream filename;
+		filename<<directory<<"/IMG"<<std::setw(4)<<std::setfill('0')<<exported<<".bmp";
+		image->Modified();
+		writer->SetFileName(filename.str().c_str());
+		writer->Write();
+
+		exported++;
+	}
+
+	std::cout<<exported<<" frames exported, "<<withoutPose<<" without a pose of tool "<<tool<<", "
+		<<missing<<" dropped while recording"<<std::endl;
+
+	return 0;
+}
@@ -0,0 +1,193 @@
+#include "FrameSource.h"
+
+#include <QMutexLocker>
+
+#include "igstkRealTimeClock.h"
+
+#include "vtkSmartPointer.h"
+#include "vtkImageReader2.h"
+#include "vtkImageReader2Factory.h"
+#include "vtkImageData.h"
+
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+
+double FrameSource::waitForNextFrame()
+{
+	double now = igstk::RealTimeClock::GetTimeStamp();
+
+	// a source that fell behind does not try to catch up with a burst of frames
+	if(nextFrameTime < now - 1000/getFrameRate())
+		nextFrameTime = now;
+
+	if(nextFrameTime > now)
+	{
+		QMutexLocker locker(&sleepMutex);
+		sleepCondition.wait(&sleepMutex, (unsigned long)(nextFrameTime - now));
+	}
+
+	double time = std::max(nextFrameTime, igstk::RealTimeClock::GetTimeStamp());
+	nextFrameTime += 1000/getFrameRate();
+
+	return time;
+}
+
+void FrameSource::resetFrameClock()
+{
+	nextFrameTime = igstk::RealTimeClock::GetTimeStamp();
+}
+
+FileFrameSource::FileFrameSource(QStringList filenames, double frameRate)
+	: filenames(filenames), frameRate(std::max(1.0, frameRate)), width(0), height(0), numberOfFrames(0), frame(0)
+{
+}
+
+bool FileFrameSource::open()
+{
+	frames.clear();
+	numberOfFrames = 0;
+	frame = 0;
+
+	for(int i = 0; i < filenames.size(); i++)
+	{
+		vtkSmartPointer<vtkImageReader2Factory> readerFactory =
+			vtkSmartPointer<vtkImageReader2Factory>::New();
+
+		vtkSmartPointer<vtkImageReader2> reader =
+			readerFactory->CreateImageReader2(filenames.at(i).toAscii().data());
+		if(!reader)
+		{
+			std::cout<<"	Could not read the frame "<<filenames.at(i).toAscii().data()<<std::endl;
+			continue;
+		}
+
+		reader->SetFileName(filenames.at(i).toAscii().data());
+		reader->Update();
+
+		vtkImageData * image = reader->GetOutput();
+		int * dimensions = image->GetDimensions();
+
+		if(numberOfFrames == 0)
+		{
+			width = dimensions[0];
+			height = dimensions[1];
+			frames.reserve(filenames.size()*width*height);
+		}
+		else if(dimensions[0] != width || dimensions[1] != height)
+		{
+			std::cout<<"	Skipping the frame "<<filenames.at(i).toAscii().data()<<", its size is not "
+				<<width<<"x"<<height<<std::endl;
+			continue;
+		}
+
+		// the first component is the gray level of the color frames
+		for(int y = 0; y < height; y++)
+			for(int x = 0; x < width; x++)
+				frames.push_back((unsigned char)image->GetScalarComponentAsDouble(x, y, 0, 0));
+
+		numberOfFrames++;
+	}
+
+	if(numberOfFrames == 0)
+		return false;
+
+	std::cout<<"	"<<numberOfFrames<<" frames of "<<width<<"x"<<height<<" at "<<frameRate<<" Hz"<<std::endl;
+
+	resetFrameClock();
+
+	return true;
+}
+
+void FileFrameSource::close()
+{
+	frames.clear();
+	numberOfFrames = 0;
+}
+
+int FileFrameSource::getWidth()
+{
+	return width;
+}
+
+int FileFrameSource::getHeight()
+{
+	return height;
+}
+
+double FileFrameSource::getFrameRate()
+{
+	return frameRate;
+}
+
+bool FileFrameSource::grab(unsigned char * pixels, double & time)
+{
+	if(numberOfFrames == 0)
+		return false;
+
+	time = waitForNextFrame();
+
+	int frameSize = width*height;
+	memcpy(pixels, &frames[frame*frameSize], frameSize);
+	frame = (frame + 1)%numberOfFrames;
+
+	return true;
+}
+
+SyntheticFrameSource::SyntheticFrameSource(int width, int height, double frameRate)
+	: width(width), height(height), frameRate(std::max(1.0, frameRate)), frame(0)
+{
+}
+
+bool SyntheticFrameSource::open()
+{
+	frame = 0;
+	resetFrameClock();
+
+	return width > 0 && height > 0;
+}
+
+void SyntheticFrameSource::close()
+{
+}
+
+int SyntheticFrameSource::getWidth()
+{
+	return width;
+}
+
+int SyntheticFrameSource::getHeight()
+{
+	return height;
+}
+
+double SyntheticFrameSource::getFrameRate()
+{
+	return frameRate;
+}
+
+bool SyntheticFrameSource::grab(unsigned char * pixels, double & time)
+{
+	time = waitForNextFrame();
+
+	// the line sweeps the image once per second
+	int line = (int)(frame*height/frameRate)%height;
+
+	for(int y = 0; y < height; y++)
+	{
+		unsigned char * row = pixels + y*width;
+
+		if(y == line)
+		{
+			memset(row, 255, width);
+			continue;
+		}
+
+		unsigned char level = (unsigned char)(y*128/height);
+		memset(row, level, width);
+	}
+
+	frame++;
+
+	return true;
+}
@@ -0,0 +1,145 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+
+#include <vector>
+
+//!Source of ultrasound frames
+/*!
+  The frame grabber of the ultrasound machine is hidden behind this interface, so the recorder
+  does not depend on the grabber. The frames are 8 bit grayscale, row by row, and they are
+  copied into a buffer of the caller, a source does not allocate memory per frame.
+  FileFrameSource and SyntheticFrameSource stand in for the grabber.
+*/
+class FrameSource
+{
+
+public:
+
+	FrameSource() : nextFrameTime(0) {}
+
+	virtual ~FrameSource() {}
+
+    /**
+     * \brief Prepare the source, the size of the frames is known after it
+     * \return false if the source can not give frames
+     */
+	virtual bool open() = 0;
+
+    /**
+     * \brief Release the source
+     */
+	virtual void close() = 0;
+
+    /**
+     * \brief Returns the width of the frames in pixels
+     */
+	virtual int getWidth() = 0;
+
+    /**
+     * \brief Returns the height of the frames in pixels
+     */
+	virtual int getHeight() = 0;
+
+    /**
+     * \brief Returns the frames per second
+     */
+	virtual double getFrameRate() = 0;
+
+    /**
+     * \brief Wait for the next frame and copy it
+     * \param[out] width*height pixels and time in ms of igstk::RealTimeClock of the frame
+     * \return false if the source has no more frames
+     */
+	virtual bool grab(unsigned char *, double &) = 0;
+
+protected:
+
+    /**
+     * \brief Sleep until the next frame at the frame rate of the source
+     * \return time of the frame in ms of igstk::RealTimeClock
+     */
+	double waitForNextFrame();
+
+    /**
+     * \brief Start the frame clock from now
+     */
+	void resetFrameClock();
+
+private:
+
+	QMutex sleepMutex; ///<Mutex of the sleep condition
+	QWaitCondition sleepCondition; ///<Never signaled, waited with a timeout to sleep
+	double nextFrameTime; ///<Time of the next frame
+};
+
+//!Frames read from image files
+/*!
+  The images are read and converted to 8 bit grayscale when the source is opened, e.g. the BMP
+  frames exported from the ultrasound machine, and they are given at the frame rate, in a loop.
+  Images with a different size than the first one are skipped.
+*/
+class FileFrameSource : public FrameSource
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     * \param[in] image files and frames per second
+     */
+	FileFrameSource(QStringList, double frameRate = 30);
+
+	bool open();
+	void close();
+	int getWidth();
+	int getHeight();
+	double getFrameRate();
+	bool grab(unsigned char *, double &);
+
+private:
+
+	QStringList filenames; ///<Image files
+	double frameRate; ///<Frames per second
+	int width; ///<Width of the frames
+	int height; ///<Height of the frames
+	std::vector<unsigned char> frames; ///<Pixels of all the frames
+	int numberOfFrames; ///<Frames read
+	int frame; ///<Next frame
+};
+
+//!Synthetic frames
+/*!
+  A moving bright line and a gradient, generated at the frame rate without reading the disk, to
+  measure the throughput of the recording.
+*/
+class SyntheticFrameSource : public FrameSource
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     * \param[in] width, height and frames per second
+     */
+	SyntheticFrameSource(int width = 640, int height = 480, double frameRate = 30);
+
+	bool open();
+	void close();
+	int getWidth();
+	int getHeight();
+	double getFrameRate();
+	bool grab(unsigned char *, double &);
+
+private:
+
+	int width; ///<Width of the frames
+	int height; ///<Height of the frames
+	double frameRate; ///<Frames per second
+	unsigned int frame; ///<Frames generated
+};
+
+#endif // FRAMESOURCE_H
@@ -0,0 +1,35 @@
+#include "GaussianFilter.h"
+
+#include <math.h>
+#include <algorithm>
+
+void GaussianFilter::smooth(std::vector<float> &buffer, int width, int height, double sigma)
+{
+	int radius = (int)ceil(3*sigma);
+	std::vector<float> kernel(2*radius + 1);
+	float sum = 0;
+	for(int k=-radius; k<=radius; k++){
+		kernel[k + radius] = exp(-k*k/(2*sigma*sigma));
+		sum += kernel[k + radius];
+	}
+	for(int k=0; k<2*radius + 1; k++)
+		kernel[k] /= sum;
+
+	std::vector<float> temp(buffer.size());
+
+	for(int j=0; j<height; j++)
+		for(int i=0; i<width; i++){
+			float value = 0;
+			for(int k=-radius; k<=radius; k++)
+				value += kernel[k + radius]*buffer[j*width + std::min(width - 1, std::max(0, i + k))];
+			temp[j*width + i] = value;
+		}
+
+	for(int j=0; j<height; j++)
+		for(int i=0; i<width; i++){
+			float value = 0;
+			for(int k=-radius; k<=radius; k++)
+				value += kernel[k + radius]*temp[std::min(height - 1, std::max(0, j + k))*width + i];
+			buffer[j*width + i] = value;
+		}
+}
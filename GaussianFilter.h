@@ -0,0 +1,25 @@
+#ifndef GAUSSIANFILTER_H
+#define GAUSSIANFILTER_H
+
+#include <vector>
+
+//!Gaussian smoothing of the image buffers of the detectors
+/*!
+  The crosswire detector and the sphere segmentation smooth their float copy of each image
+  before taking derivatives. The gaussian is separable, the rows are filtered and then the
+  columns, with a kernel of radius 3 sigma normalized to 1 and the borders clamped.
+*/
+class GaussianFilter
+{
+
+public:
+
+    /**
+     * \brief Smooth an image buffer in place
+     * \param[in] buffer of width*height pixels row by row, width, height and sigma in pixels
+     */
+	static void smooth(std::vector<float> &, int, int, double);
+
+};
+
+#endif // GAUSSIANFILTER_H
@@ -0,0 +1,175 @@
+#include "LatencyMonitor.h"
+
+#include <QMutexLocker>
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+/** Number of 1 ms bins of the histograms */
+static const int numberOfBins = 250;
+
+/** Maximum number of displayed frames kept for the CSV file, about 45 minutes at 60 Hz */
+static const unsigned int maximumFrames = 160000;
+
+static const char * histogramNames[] = {"tracker_period", "frame_period", "motion_to_photon",
+	"acquisition", "scene_update", "render_wait", "render"};
+
+LatencyMonitor::Histogram::Histogram()
+	: bins(numberOfBins, 0), count(0), sum(0), maximum(0)
+{
+}
+
+void LatencyMonitor::Histogram::add(double time)
+{
+	int bin = std::min(numberOfBins - 1, std::max(0, (int)time));
+	bins[bin]++;
+	count++;
+	sum += time;
+	maximum = std::max(maximum, time);
+}
+
+double LatencyMonitor::Histogram::mean()
+{
+	return count > 0 ? sum/count : 0;
+}
+
+double LatencyMonitor::Histogram::percentile(double fraction)
+{
+	if(count == 0)
+		return 0;
+
+	// upper edge of the bin of the percentile
+	int target = (int)(fraction*count);
+	int accumulated = 0;
+	for(int bin=0; bin<numberOfBins - 1; bin++){
+		accumulated += bins[bin];
+		if(accumulated > target)
+			return bin + 1;
+	}
+
+	return maximum;
+}
+
+LatencyMonitor::LatencyMonitor()
+{
+	reset();
+}
+
+void LatencyMonitor::reset()
+{
+	QMutexLocker locker(&mutex);
+
+	for(int h=0; h<NumberOfHistograms; h++)
+		histograms[h] = Histogram();
+
+	frames.clear();
+	updated = false;
+	lastTrackerTime = -1;
+	lastRenderEnd = -1;
+}
+
+void LatencyMonitor::addTrackerFrame(const TrackingSample &sample)
+{
+	QMutexLocker locker(&mutex);
+
+	if(lastTrackerTime >= 0 && sample.time > lastTrackerTime)
+		histograms[TrackerPeriod].add(sample.time - lastTrackerTime);
+	lastTrackerTime = sample.time;
+
+	histograms[Acquisition].add(sample.readTime - sample.time);
+}
+
+void LatencyMonitor::sceneUpdated(const TrackingSample &sample, double time)
+{
+	QMutexLocker locker(&mutex);
+
+	current.trackerTime = sample.time;
+	current.readTime = sample.readTime;
+	current.updateTime = time;
+	updated = true;
+}
+
+void LatencyMonitor::renderStarted(double time)
+{
+	QMutexLocker locker(&mutex);
+
+	current.renderStart = time;
+}
+
+void LatencyMonitor::renderFinished(double time)
+{
+	QMutexLocker locker(&mutex);
+
+	if(lastRenderEnd >= 0)
+		histograms[FramePeriod].add(time - lastRenderEnd);
+	lastRenderEnd = time;
+
+	// the frames rendered without a new pose do not change the latency of the scene
+	if(!updated)
+		return;
+	updated = false;
+
+	current.renderEnd = time;
+
+	histograms[MotionToPhoton].add(current.renderEnd - current.trackerTime);
+	histograms[SceneUpdate].add(current.updateTime - current.readTime);
+	histograms[RenderWait].add(current.renderStart - current.updateTime);
+	histograms[Render].add(current.renderEnd - current.renderStart);
+
+	if(frames.size() < maximumFrames)
+		frames.push_back(current);
+}
+
+QString LatencyMonitor::getSummary()
+{
+	QMutexLocker locker(&mutex);
+
+	Histogram &tracker = histograms[TrackerPeriod];
+	Histogram &frame = histograms[FramePeriod];
+	Histogram &latency = histograms[MotionToPhoton];
+
+	QString summary;
+	summary += "Tracker: " + QString::number(tracker.mean() > 0 ? 1000/tracker.mean() : 0, 'f', 1) + " Hz";
+	summary += "   Render: " + QString::number(frame.mean() > 0 ? 1000/frame.mean() : 0, 'f', 1) + " FPS\n";
+	summary += "Motion to photon: " + QString::number(latency.percentile(0.5), 'f', 0) + " ms median, " +
+		QString::number(latency.percentile(0.95), 'f', 0) + " ms p95, " +
+		QString::number(latency.maximum, 'f', 0) + " ms max\n";
+	summary += "Acquisition " + QString::number(histograms[Acquisition].mean(), 'f', 1) +
+		"  Scene " + QString::number(histograms[SceneUpdate].mean(), 'f', 1) +
+		"  Wait " + QString::number(histograms[RenderWait].mean(), 'f', 1) +
+		"  Render " + QString::number(histograms[Render].mean(), 'f', 1) + " ms";
+
+	return summary;
+}
+
+bool LatencyMonitor::exportCSV(QString filename)
+{
+	QFile file(filename);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+
+	QMutexLocker locker(&mutex);
+
+	QTextStream out(&file);
+	out.setRealNumberNotation(QTextStream::FixedNotation);
+	out.setRealNumberPrecision(3);
+
+	out<<"frame,tracker_time,read_time,update_time,render_start,render_end,motion_to_photon\n";
+	for(unsigned int f=0; f<frames.size(); f++){
+		const Frame &frame = frames[f];
+		out<<f<<","<<frame.trackerTime<<","<<frame.readTime<<","<<frame.updateTime<<","
+			<<frame.renderStart<<","<<frame.renderEnd<<","<<frame.renderEnd - frame.trackerTime<<"\n";
+	}
+
+	// the histograms have all the frames, also the ones after maximumFrames
+	out<<"\nhistogram,bin_ms,count\n";
+	for(int h=0; h<NumberOfHistograms; h++)
+		for(int bin=0; bin<numberOfBins; bin++)
+			if(histograms[h].bins[bin] > 0)
+				out<<histogramNames[h]<<","<<bin<<","<<histograms[h].bins[bin]<<"\n";
+
+	file.close();
+
+	return true;
+}
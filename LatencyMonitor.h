@@ -0,0 +1,112 @@
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include <QMutex>
+#include <QString>
+
+#include "TrackingSample.h"
+
+#include <vector>
+
+//!Latency and rate of the navigation loop
+/*!
+  This class collects the time of each stage a tool pose goes through until it is on the screen:
+  the tracker frame (the serial reply parsed by IGSTK), the read of the tool observers by the
+  acquisition thread, the time the scene objects were given the poses of the newest sample, and the start and the end
+  of the render of the frame that shows it. Each displayed frame is split in the delay of each
+  stage and the motion-to-photon latency from the tracker frame to the end of the render, and the
+  delays, the tracker period and the frame period are kept in histograms of 1 ms bins.
+  The scene is rendered in the user interface thread, by the tracking loop and the camera interaction.
+*/
+class LatencyMonitor
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static LatencyMonitor *New()
+	{
+			return new LatencyMonitor;
+	}
+
+    /**
+     * \brief Add a tracker frame, every frame of the tracker should be added once
+     */
+	void addTrackerFrame(const TrackingSample &);
+
+    /**
+     * \brief The transforms of the scene objects were set from a sample, before the render that shows them
+     * \param[in] sample and time in ms of igstk::RealTimeClock after the transforms were set
+     */
+	void sceneUpdated(const TrackingSample &, double);
+
+    /**
+     * \brief A render of the scene started
+     */
+	void renderStarted(double);
+
+    /**
+     * \brief A render of the scene finished, the frame is presented
+     */
+	void renderFinished(double);
+
+    /**
+     * \brief Forget the frames
+     */
+	void reset();
+
+    /**
+     * \brief Returns the tracker rate, render rate, latency percentiles and stage delays as text
+     */
+	QString getSummary();
+
+    /**
+     * \brief Save one line per displayed frame with the time of each stage and a line per histogram bin
+     * \return false if the file could not be created
+     */
+	bool exportCSV(QString);
+
+private:
+
+	LatencyMonitor();
+
+	/** Times in ms in bins of 1 ms, the last bin has the longer times */
+	struct Histogram
+	{
+		std::vector<int> bins; ///<Counts
+		int count; ///<Times added
+		double sum; ///<Sum of the times
+		double maximum; ///<Longest time
+
+		Histogram();
+		void add(double);
+		double mean();
+		double percentile(double);
+	};
+
+	/** Time of each stage of a displayed frame */
+	struct Frame
+	{
+		double trackerTime; ///<Tracker frame of the newest pose on the screen
+		double readTime; ///<Read by the acquisition thread
+		double updateTime; ///<Scene updated
+		double renderStart; ///<Render started
+		double renderEnd; ///<Render finished
+	};
+
+	enum HistogramIndex { TrackerPeriod, FramePeriod, MotionToPhoton, Acquisition, SceneUpdate,
+		RenderWait, Render, NumberOfHistograms };
+
+	QMutex mutex; ///<The render events can come from another thread
+	Histogram histograms[NumberOfHistograms]; ///<Periods and delays
+	std::vector<Frame> frames; ///<Displayed frames, up to maximumFrames
+	Frame current; ///<Frame being updated and rendered
+	bool updated; ///<The scene was updated since the last render
+	double lastTrackerTime; ///<Time of the last tracker frame
+	double lastRenderEnd; ///<Time of the last presented frame
+
+};
+
+#endif // LATENCYMONITOR_H
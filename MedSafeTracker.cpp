@@ -1,5 +1,11 @@
 #include "MedSafeTracker.h"
 
+#include <sstream>
+#include <algorithm>
+
+/** Sensor updates per second */
+static const double frequency = 60;
+
 void MedSafeTracker::InitializeTracker()
 {
     my_command = MedSafeTrackerCommand::New();
@@ -10,14 +16,14 @@ void MedSafeTracker::InitializeTracker()
 	std::cout<<"	Setting Logger"<<std::endl;
 	tracker->SetLogger(logger);
 	std::cout<<"	Setting Frequency"<<std::endl;
-    tracker->RequestSetFrequency(60);
+    tracker->RequestSetFrequency(frequency);
 	std::cout<<"	Opening"<<std::endl;
     tracker->RequestOpen();
 
 
 }
 
-void MedSafeTracker::InitializeTrackerTool(int port)
+void MedSafeTracker::InitializeTrackerTool(int port, std::string name)
 {
 
     trackerTool = AscensionTracker3DGToolType::New();
@@ -31,6 +37,15 @@ void MedSafeTracker::InitializeTrackerTool(int port)
     coordSystemAObserver = ObserverType::New();
     coordSystemAObserver->ObserveTransformEventsFrom( trackerTool );
 
+	trackerTools.push_back(trackerTool);
+	coordSystemAObservers.push_back(coordSystemAObserver);
+
+	if(name.empty()){
+		std::ostringstream portName;
+		portName<<"sensor "<<port;
+		name = portName.str();
+	}
+	toolNames.push_back(name);
 
 }
 
@@ -52,25 +67,57 @@ void MedSafeTracker::InitializeLogger()
 
 }
 
-void MedSafeTracker::StartTracking()
+bool MedSafeTracker::StartTracking(double timeout)
 {
+    trackerEvents = TrackerEventObserver::New();
+
+    unsigned long trackerTag = tracker->AddObserver(itk::AnyEvent(), trackerEvents);
+
     tracker->RequestStartTracking();
-    DelayNSec(2);
+    bool ok = trackerEvents->WaitForStartTracking(timeout);
+
+    tracker->RemoveObserver(trackerTag);
+
+    if (!ok)
+    {
+        std::cout<<"	Could not start tracking: "<<trackerEvents->GetErrorMessage()<<std::endl;
+
+        // the start request may have reached the tracker, it must stop before the next start
+        tracker->RequestStopTracking();
+    }
+
+    return ok;
 }
 
-void MedSafeTracker::StopTracking()
+bool MedSafeTracker::StopTracking(double timeout)
 {
+    trackerEvents = TrackerEventObserver::New();
+    unsigned long trackerTag = tracker->AddObserver(itk::AnyEvent(), trackerEvents);
 
      tracker->RequestStopTracking();
-     trackerTool->RequestDetachFromTracker( );
+    bool ok = trackerEvents->WaitForStopTracking(timeout);
+
+    tracker->RemoveObserver(trackerTag);
+
+    if (!ok)
+        std::cout<<"	Could not stop tracking: "<<trackerEvents->GetErrorMessage()<<std::endl;
+
+    for(unsigned int i = 0; i < trackerTools.size(); i++)
+        trackerTools[i]->RequestDetachFromTracker( );
+
+    return ok;
 }
 
 void MedSafeTracker::ObserveTransformations()
 {
 
-    coordSystemAObserver = ObserverType::New();
 	std::cout<<"	Observing Transformation Events"<<std::endl;
-    coordSystemAObserver->ObserveTransformEventsFrom(trackerTool);
+	for(unsigned int i = 0; i < trackerTools.size(); i++){
+		coordSystemAObservers[i] = ObserverType::New();
+		coordSystemAObservers[i]->ObserveTransformEventsFrom(trackerTools[i]);
+	}
+	if(!coordSystemAObservers.empty())
+		coordSystemAObserver = coordSystemAObservers.back();
 
 }
 
@@ -102,13 +149,45 @@ void MedSafeTracker::Track()
     }
 }
 
-void MedSafeTracker::DelayNSec(int seconds)
+std::string MedSafeTracker::getDeviceName()
+{
+	return "Ascension 3DG";
+}
+
+bool MedSafeTracker::startTracking(double timeout)
+{
+	return StartTracking(timeout);
+}
+
+bool MedSafeTracker::stopTracking(double timeout)
+{
+	return StopTracking(timeout);
+}
+
+bool MedSafeTracker::getSnapshot(TrackingSample & sample)
+{
+	sample.numberOfTools = std::min((int)trackerTools.size(), TRACKING_SAMPLE_MAX_TOOLS);
+	sample.readTime = igstk::RealTimeClock::GetTimeStamp();
+
+	for(int t = 0; t < sample.numberOfTools; t++)
+		readTool(trackerTools[t], coordSystemAObservers[t], sample, t);
+
+	setSnapshotTime(sample, frequency);
+
+	return sample.time >= 0;
+}
+
+int MedSafeTracker::getNumberofTools()
+{
+	return trackerTools.size();
+}
+
+igstk::TrackerTool * MedSafeTracker::getTrackerTool(int tool)
+{
+	return this->trackerTools.at(tool);
+}
+
+igstk::Tracker * MedSafeTracker::getIGSTKTracker()
 {
-  time_t start_time, cur_time;
-  time(&start_time);
-  do
-  {
-    time(&cur_time);
-  }
-  while((cur_time - start_time) < seconds);
+	return this->tracker;
 }
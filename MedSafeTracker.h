@@ -7,6 +7,7 @@
 #include <fstream>
 #include <set>
 #include <ctime>
+#include <vector>
 
 #include "itkCommand.h"
 #include "igstkLogger.h"
@@ -21,6 +22,10 @@
 
 #include "igstkTransformObserver.h"
 
+#include "TrackerEventObserver.h"
+#include "TrackingDevice.h"
+#include "TrackingSample.h"
+
 class MedSafeTrackerCommand : public itk::Command
 {
 public:
@@ -49,7 +54,12 @@ public:
   }
 };
 
-class MedSafeTracker
+/*!
+  This class configures an Ascension 3D Guidance (medSAFE) electromagnetic tracker with a sensor
+  on each port that is used
+*/
+
+class MedSafeTracker : public TrackingDevice
 {
 public:
 
@@ -66,10 +76,13 @@ public:
     igstk::Ascension3DGTracker::Pointer		  tracker;
     AscensionTracker3DGToolType::Pointer	  trackerTool;
     ObserverType::Pointer					  coordSystemAObserver;
+	std::vector<AscensionTracker3DGToolType::Pointer> trackerTools;
+	std::vector<ObserverType::Pointer>		  coordSystemAObservers;
 	LoggerType::Pointer						  logger;
 	LogOutputType::Pointer					  logOutput;
 	LogOutputType::Pointer					  fileOutput;
 	std::ofstream							  loggerFile;
+	TrackerEventObserver::Pointer			  trackerEvents;
 
 
     static MedSafeTracker *New()
@@ -78,15 +91,19 @@ public:
     }
 
     void InitializeTracker();
-    void InitializeTrackerTool(int port);
+    void InitializeTrackerTool(int port, std::string name = "");
     void InitializeLogger();
-    void StartTracking();
-    void StopTracking();
+    bool StartTracking(double timeout = 5000);
+    bool StopTracking(double timeout = 5000);
     void ObserveTransformations();
     void Track();
 
-private:
-
-    void DelayNSec(int seconds);
+	std::string getDeviceName();
+	bool startTracking(double timeout = 5000);
+	bool stopTracking(double timeout = 5000);
+	bool getSnapshot(TrackingSample &);
+	int getNumberofTools();
+	igstk::TrackerTool * getTrackerTool(int);
+	igstk::Tracker * getIGSTKTracker();
 
 };
@@ -14,7 +14,8 @@ int main(int argc, char *  argv[])
 	std::cout<<"Initializing Tracker Tool"<<std::endl;
     tracker->InitializeTrackerTool(3);
 	std::cout<<"Start Tracking"<<std::endl;
-    tracker->StartTracking();
+    if(!tracker->StartTracking())
+        return 1;
 	std::cout<<"Transformation observer"<<std::endl;
     tracker->ObserveTransformations();
 
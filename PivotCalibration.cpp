@@ -0,0 +1,159 @@
+#include "PivotCalibration.h"
+
+#include <vnl/algo/vnl_svd.h>
+
+#include <math.h>
+#include <algorithm>
+
+PivotCalibration::PivotCalibration()
+{
+	outlierThreshold = 1.0;
+	clear();
+}
+
+void PivotCalibration::clear()
+{
+	rotations.clear();
+	translations.clear();
+	inliers.clear();
+
+	AtA.set_size(6,6);
+	AtA.fill(0);
+	Atb.set_size(6);
+	Atb.fill(0);
+	btb = 0;
+
+	tip.set_size(3);
+	tip.fill(0);
+	pivot.set_size(3);
+	pivot.fill(0);
+
+	rms = 0;
+	conditioning = 0;
+	numberOfInliers = 0;
+	posesSinceRejection = 0;
+}
+
+bool PivotCalibration::addPose(vnl_matrix<double> rotation, vnl_vector<double> translation)
+{
+	rotations.push_back(rotation);
+	translations.push_back(translation);
+	inliers.push_back(true);
+
+	accumulate(rotations.size() - 1, 1);
+	numberOfInliers++;
+	posesSinceRejection++;
+
+	if(!solve())
+		return false;
+
+	// the outliers are removed less often as the poses grow
+	if(isWellConditioned() && posesSinceRejection >= std::max(10, (int)rotations.size()/10))
+		rejectOutliers();
+
+	return true;
+}
+
+void PivotCalibration::accumulate(int pose, double sign)
+{
+	// the equations of a pose are [R -I] [tip; pivot] = -t
+	const vnl_matrix<double> &R = rotations[pose];
+	const vnl_vector<double> &t = translations[pose];
+
+	for(int k=0; k<3; k++){
+
+		double row[6] = {R(k,0), R(k,1), R(k,2), 0, 0, 0};
+		row[3 + k] = -1;
+
+		for(int i=0; i<6; i++){
+			for(int j=0; j<6; j++)
+				AtA(i,j) += sign*row[i]*row[j];
+			Atb[i] -= sign*row[i]*t[k];
+		}
+
+		btb += sign*t[k]*t[k];
+	}
+}
+
+bool PivotCalibration::solve()
+{
+	if(numberOfInliers < 4)
+		return false;
+
+	vnl_svd<double> svd(AtA);
+	conditioning = svd.W(0) > 0 ? svd.W(5)/svd.W(0) : 0;
+
+	if(svd.rank() < 6)
+		return false;
+
+	vnl_vector<double> x = svd.solve(Atb);
+	tip = x.extract(3, 0);
+	pivot = x.extract(3, 3);
+
+	// sum of squared residuals from the normal equations, without going through the poses
+	double residual = dot_product(x, AtA*x) - 2*dot_product(x, Atb) + btb;
+	rms = sqrt(std::max(0.0, residual)/numberOfInliers);
+
+	return true;
+}
+
+void PivotCalibration::rejectOutliers()
+{
+	posesSinceRejection = 0;
+
+	double threshold = std::max(outlierThreshold, 3*rms);
+
+	// poses are taken back when the estimate moves close to them
+	bool changed = false;
+
+	for(unsigned int p=0; p<rotations.size(); p++){
+
+		double distance = (rotations[p]*tip + translations[p] - pivot).magnitude();
+		bool inlier = distance < threshold;
+
+		if(inlier != inliers[p]){
+			accumulate(p, inlier ? 1 : -1);
+			numberOfInliers += inlier ? 1 : -1;
+			inliers[p] = inlier;
+			changed = true;
+		}
+	}
+
+	if(changed)
+		solve();
+}
+
+void PivotCalibration::setOutlierThreshold(double threshold)
+{
+	outlierThreshold = threshold;
+}
+
+vnl_vector<double> PivotCalibration::getTip()
+{
+	return tip;
+}
+
+vnl_vector<double> PivotCalibration::getPivot()
+{
+	return pivot;
+}
+
+double PivotCalibration::getRMS()
+{
+	return rms;
+}
+
+int PivotCalibration::getNumberOfPoses()
+{
+	return rotations.size();
+}
+
+int PivotCalibration::getNumberOfInliers()
+{
+	return numberOfInliers;
+}
+
+bool PivotCalibration::isWellConditioned()
+{
+	return conditioning > 1e-3;
+}
@@ -0,0 +1,114 @@
+#ifndef PIVOTCALIBRATION_H
+#define PIVOTCALIBRATION_H
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <vector>
+
+//!Pivot calibration of a tracked needle
+/*!
+  This class estimates the position of the needle tip in the tool coordinates while the needle
+  is pivoted about its tip. Each pose gives three equations R*tip + t = pivot, the normal equations
+  of the 6 unknowns are accumulated as the poses arrive so the estimate is updated at the tracker
+  rate. Every few poses the poses farther from the pivot point than three times the RMS, and at
+  least the outlier threshold, are removed from the normal equations.
+*/
+class PivotCalibration
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static PivotCalibration *New()
+	{
+			return new PivotCalibration;
+	}
+
+    /**
+     * \brief Add a needle tool pose and update the estimate
+     * \param[in] rotation matrix and translation of the tool in the tracker coordinates
+     * \return true if there is an estimate
+     */
+	bool addPose(vnl_matrix<double>, vnl_vector<double>);
+
+    /**
+     * \brief Remove all the poses
+     */
+	void clear();
+
+    /**
+     * \brief Set the minimum distance in mm from a pose to the pivot point to reject it, the default is 1 mm
+     */
+	void setOutlierThreshold(double);
+
+    /**
+     * \brief Returns the needle tip in the tool coordinates
+     */
+	vnl_vector<double> getTip();
+
+    /**
+     * \brief Returns the pivot point in the tracker coordinates
+     */
+	vnl_vector<double> getPivot();
+
+    /**
+     * \brief Returns the root mean square distance in mm from the inlier poses to the pivot point
+     */
+	double getRMS();
+
+    /**
+     * \brief Returns the number of poses added
+     */
+	int getNumberOfPoses();
+
+    /**
+     * \brief Returns the number of poses used in the estimate
+     */
+	int getNumberOfInliers();
+
+    /**
+     * \brief Returns true if the needle was pivoted enough to estimate the tip
+     */
+	bool isWellConditioned();
+
+private:
+
+	PivotCalibration();
+
+    /**
+     * \brief Add or remove the equations of a pose from the normal equations
+     */
+	void accumulate(int, double);
+
+    /**
+     * \brief Solve the normal equations
+     */
+	bool solve();
+
+    /**
+     * \brief Remove the outlier poses and compute the RMS
+     */
+	void rejectOutliers();
+
+	std::vector< vnl_matrix<double> > rotations; ///<Tool rotations
+	std::vector< vnl_vector<double> > translations; ///<Tool translations
+	std::vector<bool> inliers; ///<Poses used in the normal equations
+
+	vnl_matrix<double> AtA; ///<Normal matrix of the 6 unknowns
+	vnl_vector<double> Atb; ///<Right side of the normal equations
+	double btb; ///<Sum of the squared translations, for the residual
+
+	vnl_vector<double> tip; ///<Tip in the tool coordinates
+	vnl_vector<double> pivot; ///<Pivot in the tracker coordinates
+	double rms; ///<RMS distance to the pivot
+	double outlierThreshold; ///<Outlier distance in mm
+	double conditioning; ///<Smallest over largest singular value of the normal matrix
+	int numberOfInliers; ///<Poses in the normal equations
+	int posesSinceRejection; ///<Poses added since the last outlier rejection
+
+};
+
+#endif // PIVOTCALIBRATION_H
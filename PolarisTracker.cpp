@@ -1,5 +1,7 @@
 #include "PolarisTracker.h"
 
+#include <algorithm>
+
 void PolarisTracker::attachTool(int tool)
 {
 	std::cout<<"	Attaching tool "<<tool<<std::endl;
@@ -50,13 +52,34 @@ void PolarisTracker::initializeTracker()
 
     std::cout<<"	Setting SerialCommunication"<<std::endl;
     tracker->SetCommunication( serialComm );
-	tracker->RequestSetFrequency(60);
+
+	// a rejected frequency is only reported by an error event, the tracker keeps its default
+	std::cout<<"	Setting Frequency"<<std::endl;
+	trackerEvents = TrackerEventObserver::New();
+	unsigned long trackerTag = tracker->AddObserver(igstk::IGSTKErrorEvent(), trackerEvents);
+	tracker->RequestSetFrequency(frequency);
+	tracker->RemoveObserver(trackerTag);
+	if(!trackerEvents->GetErrorMessage().empty())
+		std::cout<<"	Could not set the frequency to "<<frequency<<" Hz: "<<trackerEvents->GetErrorMessage()<<std::endl;
     std::cout<<"	Opening"<<std::endl;
     tracker->RequestOpen();
 
 }
 
-void PolarisTracker::initializeTrackerTool(std::string romFile)
+void PolarisTracker::closeTracker()
+{
+	if(tracker){
+		std::cout<<"	Closing"<<std::endl;
+		tracker->RequestClose();
+	}
+
+	if(serialComm){
+		std::cout<<"	Closing SerialCommunication"<<std::endl;
+		serialComm->CloseCommunication();
+	}
+}
+
+void PolarisTracker::initializeTrackerTool(std::string romFile, std::string name)
 {
 
 	trackerTool = PolarisToolType::New();	
@@ -76,12 +99,22 @@ void PolarisTracker::initializeTrackerTool(std::string romFile)
     trackerTool->RequestConfigure();
 
 	trackerTools.push_back(trackerTool);
+	toolNames.push_back(name.empty() ? romFile : name);
 
 }
 
 void PolarisTracker::initializeLogger()
 {
     logger = LoggerType::New();
+
+	if(trackingLog){
+		std::cout<<"	Logger output queued in the tracking log"<<std::endl;
+		TrackingLogOutput::Pointer trackingLogOutput = TrackingLogOutput::New();
+		trackingLogOutput->SetTrackingLog(trackingLog);
+		logger->AddLogOutput( trackingLogOutput );
+		return;
+	}
+
     logOutput = LogOutputType::New();
 
     std::ofstream filename("Logger.txt");
@@ -119,24 +152,85 @@ void PolarisTracker::initializeSerialCommunication(int portNumber)
     serialComm->SetStopBits( igstk::SerialCommunication::StopBits1 );
 	std::cout<<"	Setting HandShake"<<std::endl;
     serialComm->SetHardwareHandshake( igstk::SerialCommunication::HandshakeOff );
-	std::cout<<"	Setting RecordedStreamFile"<<std::endl;
-    serialComm->SetCaptureFileName( "RecordedStreamByPolarisTrackerTest.txt" );
-    serialComm->SetCapture( true );
+	if(!captureFilename.empty()){
+		std::cout<<"	Setting RecordedStreamFile"<<std::endl;
+		serialComm->SetCaptureFileName( captureFilename.c_str() );
+		serialComm->SetCapture( true );
+	}
 
 	serialComm->OpenCommunication();
 
 }
 
-void PolarisTracker::startTracking()
+void PolarisTracker::initializeReplayCommunication(std::string streamFilename, double speed)
 {
+    my_command = PolarisTrackerCommand::New();
+
+	igstk::SerialCommunicationSimulator::Pointer simulator = igstk::SerialCommunicationSimulator::New();
+
+	if(loggerOn){
+		std::cout<<"	Setting Logger"<<std::endl;
+		simulator->SetLogger( logger );
+	}
+
+	std::cout<<"	Replaying recorded stream: "<<streamFilename<<" at "<<speed<<"x"<<std::endl;
+	simulator->SetFileName( streamFilename.c_str() );
+	serialComm = simulator;
+
+	// the recorded replies are read as fast as the tracker asks for them,
+	// the Polaris accepts at most 60 Hz so the replay can not be faster than real time
+	if(speed > 1)
+		std::cout<<"	The replay is limited to real time, the tracker frequency can not be above 60 Hz"<<std::endl;
+	frequency = 60*std::min(1.0, std::max(0.01, speed));
+
+	serialComm->OpenCommunication();
+}
+
+bool PolarisTracker::startTracking(double timeout)
+{
+	trackerEvents = TrackerEventObserver::New();
+
+	// the observer is added before the request, the start event is sent inside it
+	unsigned long trackerTag = tracker->AddObserver(itk::AnyEvent(), trackerEvents);
+
     tracker->RequestStartTracking();
-    delayNSec(2);
+	bool ok = trackerEvents->WaitForStartTracking(timeout);
+
+	tracker->RemoveObserver(trackerTag);
+
+	if(!ok)
+	{
+		std::cout<<"	Could not start tracking: "<<trackerEvents->GetErrorMessage()<<std::endl;
+
+		// the start request may have reached the tracker, it must stop before the next start
+		tracker->RequestStopTracking();
+	}
+
+	if(trackingLog)
+		trackingLog->logEvent(igstk::RealTimeClock::GetTimeStamp(), 0,
+			ok ? "Tracking started" : ("Could not start tracking: " + trackerEvents->GetErrorMessage()).c_str());
+
+	return ok;
 }
 
-void PolarisTracker::stopTracking()
+bool PolarisTracker::stopTracking(double timeout)
 {
-	 delayNSec(2);
+	trackerEvents = TrackerEventObserver::New();
+	unsigned long trackerTag = tracker->AddObserver(itk::AnyEvent(), trackerEvents);
+
      tracker->RequestStopTracking();
+	bool ok = trackerEvents->WaitForStopTracking(timeout);
+
+	tracker->RemoveObserver(trackerTag);
+
+	if(!ok)
+		std::cout<<"	Could not stop tracking: "<<trackerEvents->GetErrorMessage()<<std::endl;
+
+	if(trackingLog)
+		trackingLog->logEvent(igstk::RealTimeClock::GetTimeStamp(), 0,
+			ok ? "Tracking stopped" : ("Could not stop tracking: " + trackerEvents->GetErrorMessage()).c_str());
+
+	return ok;
 }
 
 
@@ -165,7 +259,31 @@ void PolarisTracker::track(int tool)
     if (coordSystemAObservers.at(tool)->GotTransform())
     {
       transform = coordSystemAObservers.at(tool)->GetTransform();
-      if ( transform.IsValidNow() )
+      if ( transform.IsValidNow() && trackingLog )
+      {
+        // the pose goes to the binary log, printing every position slows down the tracking
+        TrackingSample sample;
+        sample.numberOfTools = std::min((int)trackerTools.size(), TRACKING_SAMPLE_MAX_TOOLS);
+        for(int t = 0; t < sample.numberOfTools; t++)
+          sample.valid[t] = false;
+
+        if(tool < sample.numberOfTools)
+        {
+          position = transform.GetTranslation();
+          VersorType::MatrixType matrix = transform.GetRotation().GetMatrix();
+          for(int i = 0; i < 3; i++)
+          {
+            sample.translation[tool][i] = position[i];
+            for(int j = 0; j < 3; j++)
+              sample.rotation[tool][3*i + j] = matrix(i,j);
+          }
+          sample.valid[tool] = true;
+          sample.time = sample.toolTime[tool] = transform.GetStartTime();
+          sample.readTime = igstk::RealTimeClock::GetTimeStamp();
+          trackingLog->logSample(sample);
+        }
+      }
+      else if ( transform.IsValidNow() )
       {
         position = transform.GetTranslation();
         std::cout << "Trackertool :"
@@ -181,15 +299,17 @@ void PolarisTracker::track(int tool)
     }
 }
 
-void PolarisTracker::delayNSec(int n)
+bool PolarisTracker::getSnapshot(TrackingSample & sample)
 {
-  time_t start_time, cur_time;
-  time(&start_time);
-  do
-  {
-    time(&cur_time);
-  }
-  while((cur_time - start_time) < n);
+	sample.numberOfTools = std::min((int)trackerTools.size(), TRACKING_SAMPLE_MAX_TOOLS);
+	sample.readTime = igstk::RealTimeClock::GetTimeStamp();
+
+	for(int t = 0; t < sample.numberOfTools; t++)
+		readTool(trackerTools[t], coordSystemAObservers[t], sample, t);
+
+	setSnapshotTime(sample, frequency);
+
+	return sample.time >= 0;
 }
 
 int PolarisTracker::getNumberofTools()
@@ -202,6 +322,21 @@ igstk::PolarisTracker::Pointer PolarisTracker::getTracker()
 	return this->tracker;
 }
 
+std::string PolarisTracker::getDeviceName()
+{
+	return "Polaris";
+}
+
+igstk::TrackerTool * PolarisTracker::getTrackerTool(int tool)
+{
+	return this->trackerTools.at(tool);
+}
+
+igstk::Tracker * PolarisTracker::getIGSTKTracker()
+{
+	return this->tracker;
+}
+
 typedef igstk::PolarisTrackerTool                   PolarisToolType;
 vector<PolarisToolType::Pointer> PolarisTracker::getTools()
 {
@@ -213,6 +348,21 @@ vector<igstk::TransformObserver::Pointer> PolarisTracker::getObservers()
 	return this->coordSystemAObservers;
 }
 
+void PolarisTracker::setTrackingLog(TrackingLog * trackingLog)
+{
+	this->trackingLog = trackingLog;
+}
+
+TrackingLog * PolarisTracker::getTrackingLog()
+{
+	return this->trackingLog;
+}
+
+void PolarisTracker::setCaptureFilename(std::string captureFilename)
+{
+	this->captureFilename = captureFilename;
+}
+
 void PolarisTracker::setLoggerOn(bool loggerOn)
 {
 	this->loggerOn = loggerOn;
@@ -17,11 +17,18 @@
 
 #include "igstkSystemInformation.h"
 #include "igstkSerialCommunication.h"
+#include "igstkSerialCommunicationSimulator.h"
 #include "igstkPolarisTracker.h"
 #include "igstkPolarisTrackerTool.h"
 #include "igstkTransform.h"
 #include "igstkTransformObserver.h"
 
+#include "TrackerEventObserver.h"
+#include "TrackingDevice.h"
+#include "TrackingSample.h"
+#include "TrackingLog.h"
+#include "TrackingLogOutput.h"
+
 using namespace std;
 
 class PolarisTrackerCommand : public itk::Command
@@ -55,7 +62,7 @@ public:
   This class contains the basic steps to configure and initialize a Polaris Optic Tracker
 */
 
-class PolarisTracker
+class PolarisTracker : public TrackingDevice
 {
 public:
 
@@ -75,6 +82,9 @@ public:
 		return new PolarisTracker;
     }
 
+	PolarisTracker() : loggerOn(false), frequency(60),
+		captureFilename("RecordedStreamByPolarisTrackerTest.txt"), trackingLog(NULL) {}
+
 	
 	 /** 
 	 * \brief Attach one tool to the tracker
@@ -97,17 +107,41 @@ public:
 	/** \brief Initialize tracker*/
     void initializeTracker();
 
+	/** \brief Close the tracker and the serial communication, the port can be opened again*/
+	void closeTracker();
+
 	/** \brief Initilize one tracker tool
-	* \param[in] Rom file*/
-	void initializeTrackerTool(std::string);
+	* \param[in] Rom file
+	* \param[in] name of the tool, the rom file if empty*/
+	void initializeTrackerTool(std::string, std::string name = "");
 
-	/** \brief Initilize Logger for the tracke*/
+	/** \brief Initilize Logger for the tracke, in the tracking log if there is one*/
     void initializeLogger();
 
+	/** \brief Set the binary log of the session, the logger and track() write to it instead of text
+	* \param[in] open log, NULL to log as text*/
+	void setTrackingLog(TrackingLog *);
+
+	/** \brief Returns the binary log of the session, NULL if there is none*/
+	TrackingLog * getTrackingLog();
+
+	/** \brief Set the file of the serial capture used by the replay, call before initializeSerialCommunication
+	* \param[in] capture file, empty to not capture*/
+	void setCaptureFilename(std::string);
+
 	/** \brief Initilize serial communication
 	* \param[in] number of port*/
     void initializeSerialCommunication(int);
 
+	/** \brief Initilize a replay of a recorded serial stream instead of the serial port
+	* \param[in] stream file recorded by initializeSerialCommunication
+	* \param[in] replay speed, 1 is real time
+	*
+	* The tracker and the tools must be initialized in the same order as in the recorded session,
+	* the recorded replies are sent back in order. The speed multiplies the tracker frequency, the Polaris
+	* accepts at most 60 Hz so speeds above 1 replay in real time.*/
+    void initializeReplayCommunication(std::string, double);
+
 	/** \brief Return number of tools attached to tracker
 	* \param[out] number of tools*/
     int	 getNumberofTools();
@@ -115,16 +149,36 @@ public:
 	/** \brief Start observers*/
 	void observeAllToolsTransformations();
 	
-	/** \brief Start Tracking*/
-	void startTracking();
+	/** \brief Start Tracking, waits until the tracker reports that tracking started
+	* \param[in] timeout in milliseconds
+	* \param[out] false if the tracker reported an error or the timeout expired*/
+	bool startTracking(double timeout = 5000);
 
-	/** \brief Stop Tracking*/
-    void stopTracking(); 
+	/** \brief Stop Tracking, waits until the tracker stopped
+	* \param[in] timeout in milliseconds
+	* \param[out] false if the tracker reported an error or the timeout expired*/
+    bool stopTracking(double timeout = 5000);
 
 	/** \brief Track one tool
 	* \param[in] number of tool*/
     void track(int);
 
+	/** \brief Read all the tools in one call, without dispatching pulses in between
+	* \param[out] the poses of the tools, the time of the newest tracker frame and which tools
+	* were seen in it. Tools with an older transform are not valid.
+	* \return false if no tool has a valid transform*/
+	bool getSnapshot(TrackingSample &);
+
+	/** \brief Returns "Polaris"*/
+	std::string getDeviceName();
+
+	/** \brief Returns a tool
+	* \param[in] number of tool*/
+	igstk::TrackerTool * getTrackerTool(int);
+
+	/** \brief Returns the IGSTK tracker*/
+	igstk::Tracker * getIGSTKTracker();
+
 	/** \brief Set logger*/
 	void setLoggerOn(bool);	
 	
@@ -150,14 +204,14 @@ private:
     std::ofstream							  loggerFile; ///<File to save logger
     igstk::SerialCommunication::Pointer       serialComm; ///<Serial communuication with tracker
     PortNumberType                            polarisPortNumber; ///<Port number for the tracker
+	double									  frequency; ///<Tracker updates per second
+	std::string								  captureFilename; ///<Serial capture file, empty to not capture
+	TrackingLog *							  trackingLog; ///<Binary log of the session, NULL to log as text
 	vector<PolarisToolType::Pointer>		  trackerTools; ///<Vector with all tools
 	vector<ObserverType::Pointer>			  coordSystemAObservers; ///<Vector with all observers
 	PolarisToolType::Pointer 				  trackerTool; ///<One Tool
 	ObserverType::Pointer					  coordSystemAObserver; ///<One observer
-	
-	/** \brief Delay n seconds
-	* \param[in] number of seconds*/
-    void delayNSec(int n);
+	TrackerEventObserver::Pointer			  trackerEvents; ///<Start and stop tracking events
 
 };
 
@@ -1,5 +1,7 @@
 #include "PolarisTracker.h"
 
+#include <stdlib.h>
+
 int main(int argc, char *  argv[])
 {
 
@@ -9,8 +11,14 @@ int main(int argc, char *  argv[])
 
     std::cout<<"-Initializing Logger"<<std::endl;
     tracker->initializeLogger();
-    std::cout<<"-Initializing SerialCommunication"<<std::endl;
-    tracker->initializeSerialCommunication(3);
+    // PolarisTrackerTest [recordedStream [speed]] replays a recorded session
+    if(argc > 1){
+        std::cout<<"-Initializing Replay Communication"<<std::endl;
+        tracker->initializeReplayCommunication(argv[1], argc > 2 ? atof(argv[2]) : 1.0);
+    }else{
+        std::cout<<"-Initializing SerialCommunication"<<std::endl;
+        tracker->initializeSerialCommunication(3);
+    }
     std::cout<<"-Initializing Tracker"<<std::endl;
     tracker->initializeTracker();
     std::cout<<"-Initializing Tracker Tool 8700340"<<std::endl;
@@ -22,7 +30,8 @@ int main(int argc, char *  argv[])
 	std::cout<<"-Create all tools observers"<<std::endl;
 	tracker->createToolsObervers();
     std::cout<<"-Start Tracking"<<std::endl;
-    tracker->startTracking();
+    if(!tracker->startTracking())
+        return 1;
     std::cout<<"-Transformation observer"<<std::endl;
 	tracker->observeAllToolsTransformations();
 	std::cout<<"-Number of tools attached to tracker "<<tracker->getNumberofTools()<<std::endl;
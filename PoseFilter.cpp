@@ -0,0 +1,330 @@
+#include "PoseFilter.h"
+
+#include <math.h>
+#include <algorithm>
+
+/** Maximum number of predictions waiting for a newer pose */
+static const unsigned int maximumPredictions = 1000;
+
+/** Maximum time in ms between two poses to filter them together and to extrapolate a pose */
+static const double maximumGap = 100;
+
+/** Quaternion w x y z of a rotation matrix row major */
+static void matrixToQuaternion(const double R[9], double q[4])
+{
+	double trace = R[0] + R[4] + R[8];
+
+	if(trace > 0){
+		double s = 2*sqrt(trace + 1);
+		q[0] = s/4;
+		q[1] = (R[7] - R[5])/s;
+		q[2] = (R[2] - R[6])/s;
+		q[3] = (R[3] - R[1])/s;
+	}
+	else if(R[0] > R[4] && R[0] > R[8]){
+		double s = 2*sqrt(1 + R[0] - R[4] - R[8]);
+		q[0] = (R[7] - R[5])/s;
+		q[1] = s/4;
+		q[2] = (R[1] + R[3])/s;
+		q[3] = (R[2] + R[6])/s;
+	}
+	else if(R[4] > R[8]){
+		double s = 2*sqrt(1 + R[4] - R[0] - R[8]);
+		q[0] = (R[2] - R[6])/s;
+		q[1] = (R[1] + R[3])/s;
+		q[2] = s/4;
+		q[3] = (R[5] + R[7])/s;
+	}
+	else{
+		double s = 2*sqrt(1 + R[8] - R[0] - R[4]);
+		q[0] = (R[3] - R[1])/s;
+		q[1] = (R[2] + R[6])/s;
+		q[2] = (R[5] + R[7])/s;
+		q[3] = s/4;
+	}
+}
+
+/** Rotation matrix row major of a unit quaternion w x y z */
+static void quaternionToMatrix(const double q[4], double R[9])
+{
+	double w = q[0], x = q[1], y = q[2], z = q[3];
+
+	R[0] = 1 - 2*(y*y + z*z);  R[1] = 2*(x*y - w*z);      R[2] = 2*(x*z + w*y);
+	R[3] = 2*(x*y + w*z);      R[4] = 1 - 2*(x*x + z*z);  R[5] = 2*(y*z - w*x);
+	R[6] = 2*(x*z - w*y);      R[7] = 2*(y*z + w*x);      R[8] = 1 - 2*(x*x + y*y);
+}
+
+/** Product a*b of two quaternions, r can not be a or b */
+static void multiply(const double a[4], const double b[4], double r[4])
+{
+	r[0] = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+	r[1] = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+	r[2] = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+	r[3] = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+}
+
+/** Quaternion of a rotation vector */
+static void exponential(const double v[3], double q[4])
+{
+	double angle = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+
+	// sin(angle/2)/angle is 1/2 for small angles
+	double s = angle > 1e-9 ? sin(angle/2)/angle : 0.5;
+
+	q[0] = cos(angle/2);
+	q[1] = s*v[0];
+	q[2] = s*v[1];
+	q[3] = s*v[2];
+}
+
+/** Rotation vector of a unit quaternion, the shortest rotation */
+static void logarithm(const double q[4], double v[3])
+{
+	double sign = q[0] < 0 ? -1 : 1;
+	double norm = sqrt(q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+	double angle = 2*atan2(norm, sign*q[0]);
+
+	double s = norm > 1e-9 ? sign*angle/norm : 2*sign;
+
+	v[0] = s*q[1];
+	v[1] = s*q[2];
+	v[2] = s*q[3];
+}
+
+/** Rotate q by the rotation vector v in the tracker coordinates, exp(v)*q */
+static void rotate(const double v[3], const double q[4], double r[4])
+{
+	double e[4];
+	exponential(v, e);
+	multiply(e, q, r);
+
+	double norm = sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2] + r[3]*r[3]);
+	for(int k=0; k<4; k++)
+		r[k] /= norm;
+}
+
+/** Point of the tool in the tracker coordinates */
+static void transformPoint(const double R[9], const double t[3], const double p[3], double r[3])
+{
+	for(int i=0; i<3; i++)
+		r[i] = R[3*i]*p[0] + R[3*i + 1]*p[1] + R[3*i + 2]*p[2] + t[i];
+}
+
+PoseFilter::PoseFilter()
+{
+	setProcessNoise(2000);
+	measurementNoise = 0.25;
+	rotationGain = 0.5;
+	horizon = 30;
+
+	referencePoint[0] = 0;
+	referencePoint[1] = 0;
+	referencePoint[2] = 0;
+
+	reset();
+}
+
+void PoseFilter::setProcessNoise(double processNoise)
+{
+	// mm/s^2 to mm/ms^2
+	this->processNoise = std::max(0.0, processNoise)*1e-6;
+}
+
+void PoseFilter::setMeasurementNoise(double measurementNoise)
+{
+	this->measurementNoise = std::max(1e-3, measurementNoise);
+}
+
+void PoseFilter::setRotationGain(double rotationGain)
+{
+	this->rotationGain = std::min(1.0, std::max(0.01, rotationGain));
+}
+
+void PoseFilter::setHorizon(double horizon)
+{
+	this->horizon = horizon;
+}
+
+double PoseFilter::getHorizon()
+{
+	return this->horizon;
+}
+
+void PoseFilter::setReferencePoint(const double referencePoint[3])
+{
+	for(int i=0; i<3; i++)
+		this->referencePoint[i] = referencePoint[i];
+}
+
+void PoseFilter::reset()
+{
+	initialized = false;
+	predictions.clear();
+	predictionSquares = 0;
+	holdSquares = 0;
+	numberOfPredictions = 0;
+}
+
+void PoseFilter::update(double poseTime, const double translation[3], const double rotation[9])
+{
+	double point[3];
+	transformPoint(rotation, translation, referencePoint, point);
+
+	if(initialized && poseTime <= time)
+		return;
+
+	// the tool was lost, the velocities are not known any more
+	if(!initialized || poseTime - time > maximumGap){
+
+		for(int i=0; i<3; i++){
+			position[i] = translation[i];
+			velocity[i] = 0;
+			lastPoint[i] = point[i];
+			previousPoint[i] = point[i];
+			angularVelocity[i] = 0;
+		}
+
+		// the first velocity is unknown, up to about 1 m/s
+		covariance[0] = measurementNoise*measurementNoise;
+		covariance[1] = 0;
+		covariance[2] = 1;
+
+		matrixToQuaternion(rotation, orientation);
+
+		time = poseTime;
+		lastTime = poseTime;
+		previousTime = poseTime;
+		initialized = true;
+		return;
+	}
+
+	double dt = poseTime - time;
+
+	// constant velocity prediction of the position and its covariance
+	double q = processNoise*processNoise;
+	double p00 = covariance[0] + 2*dt*covariance[1] + dt*dt*covariance[2] + q*dt*dt*dt*dt/4;
+	double p01 = covariance[1] + dt*covariance[2] + q*dt*dt*dt/2;
+	double p11 = covariance[2] + q*dt*dt;
+
+	double gainPosition = p00/(p00 + measurementNoise*measurementNoise);
+	double gainVelocity = p01/(p00 + measurementNoise*measurementNoise);
+
+	for(int i=0; i<3; i++){
+		double predicted = position[i] + velocity[i]*dt;
+		double innovation = translation[i] - predicted;
+		position[i] = predicted + gainPosition*innovation;
+		velocity[i] += gainVelocity*innovation;
+	}
+
+	covariance[0] = (1 - gainPosition)*p00;
+	covariance[1] = (1 - gainPosition)*p01;
+	covariance[2] = p11 - gainVelocity*p01;
+
+	// alpha-beta filter of the orientation
+	double angle[3];
+	double predicted[4];
+	for(int i=0; i<3; i++)
+		angle[i] = angularVelocity[i]*dt;
+	rotate(angle, orientation, predicted);
+
+	double measured[4];
+	matrixToQuaternion(rotation, measured);
+
+	double conjugate[4] = {predicted[0], -predicted[1], -predicted[2], -predicted[3]};
+	double error[4];
+	multiply(measured, conjugate, error);
+
+	double innovation[3];
+	logarithm(error, innovation);
+
+	double beta = rotationGain*rotationGain/(2 - rotationGain);
+	for(int i=0; i<3; i++){
+		angle[i] = rotationGain*innovation[i];
+		angularVelocity[i] += beta*innovation[i]/dt;
+	}
+	rotate(angle, predicted, orientation);
+
+	time = poseTime;
+
+	previousTime = lastTime;
+	lastTime = poseTime;
+	for(int i=0; i<3; i++){
+		previousPoint[i] = lastPoint[i];
+		lastPoint[i] = point[i];
+	}
+
+	checkPredictions();
+}
+
+bool PoseFilter::predict(double predictionTime, double translation[3], double rotation[9])
+{
+	// a tool lost for a while is not extrapolated, its objects disappear as without prediction
+	if(!initialized || predictionTime - time > maximumGap)
+		return false;
+
+	double dt = predictionTime - time;
+
+	double angle[3];
+	for(int i=0; i<3; i++){
+		translation[i] = position[i] + velocity[i]*dt;
+		angle[i] = angularVelocity[i]*dt;
+	}
+
+	double predicted[4];
+	rotate(angle, orientation, predicted);
+	quaternionToMatrix(predicted, rotation);
+
+	Prediction prediction;
+	prediction.time = predictionTime;
+	transformPoint(rotation, translation, referencePoint, prediction.point);
+	for(int i=0; i<3; i++)
+		prediction.heldPoint[i] = lastPoint[i];
+
+	predictions.push_back(prediction);
+	if(predictions.size() > maximumPredictions)
+		predictions.pop_front();
+
+	return true;
+}
+
+void PoseFilter::checkPredictions()
+{
+	while(!predictions.empty() && predictions.front().time <= lastTime){
+
+		const Prediction &prediction = predictions.front();
+
+		// only the predictions between two consecutive poses, not across a loss of the tool
+		if(prediction.time >= previousTime && lastTime - previousTime < maximumGap){
+
+			double s = (prediction.time - previousTime)/(lastTime - previousTime);
+
+			double predictionSquare = 0, holdSquare = 0;
+			for(int i=0; i<3; i++){
+				double measured = previousPoint[i] + s*(lastPoint[i] - previousPoint[i]);
+				predictionSquare += (prediction.point[i] - measured)*(prediction.point[i] - measured);
+				holdSquare += (prediction.heldPoint[i] - measured)*(prediction.heldPoint[i] - measured);
+			}
+
+			predictionSquares += predictionSquare;
+			holdSquares += holdSquare;
+			numberOfPredictions++;
+		}
+
+		predictions.pop_front();
+	}
+}
+
+double PoseFilter::getPredictionError()
+{
+	return numberOfPredictions > 0 ? sqrt(predictionSquares/numberOfPredictions) : 0;
+}
+
+double PoseFilter::getHoldError()
+{
+	return numberOfPredictions > 0 ? sqrt(holdSquares/numberOfPredictions) : 0;
+}
+
+int PoseFilter::getNumberOfPredictions()
+{
+	return numberOfPredictions;
+}
@@ -0,0 +1,141 @@
+#ifndef POSEFILTER_H
+#define POSEFILTER_H
+
+#include <deque>
+
+//!Smooths the poses of a tracked tool and predicts them at the display time
+/*!
+  The position follows a constant velocity Kalman filter, the same filter for the three axes with
+  white acceleration noise. The orientation follows the equivalent alpha-beta filter on the
+  rotation: the innovation rotation vector corrects the orientation by the gain and the angular
+  velocity by gain^2/(2 - gain) per frame. The pose is predicted at any time by extrapolating the
+  filtered state with the estimated velocities, so the display can show the tool where it will be
+  when the frame is rendered instead of where it was when the tracker measured it.
+
+  Each prediction of a reference point of the tool, e.g. the needle tip, is kept until the tracker
+  measures a pose after the predicted time. Its error is the distance to the measured point at
+  that time, interpolated between the two closest poses, and it is compared to the error of
+  showing the last measured pose, which is what the display does without prediction.
+*/
+class PoseFilter
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static PoseFilter *New()
+	{
+			return new PoseFilter;
+	}
+
+    /**
+     * \brief Set the standard deviation of the acceleration in mm/s^2, the default is 2000
+     * Lower values smooth more and lag more on fast changes of velocity.
+     */
+	void setProcessNoise(double);
+
+    /**
+     * \brief Set the standard deviation of the measured position in mm, the default is 0.25
+     */
+	void setMeasurementNoise(double);
+
+    /**
+     * \brief Set the gain of the orientation filter from 0 to 1, 1 does not smooth, the default is 0.5
+     */
+	void setRotationGain(double);
+
+    /**
+     * \brief Set the time in ms from a prediction to the display of the frame, the default is 30
+     */
+	void setHorizon(double);
+
+    /**
+     * \brief Returns the time in ms from a prediction to the display of the frame
+     */
+	double getHorizon();
+
+    /**
+     * \brief Set the point of the tool whose prediction error is measured, in the tool coordinates
+     */
+	void setReferencePoint(const double[3]);
+
+    /**
+     * \brief Forget the poses and the prediction errors
+     */
+	void reset();
+
+    /**
+     * \brief Add a measured pose, poses not newer than the last one are ignored
+     * After a loss of the tool longer than 100 ms the filter starts again from the pose.
+     * \param[in] time in ms, translation and rotation matrix row major of the tool
+     */
+	void update(double, const double[3], const double[9]);
+
+    /**
+     * \brief Predict the pose at a time and keep the prediction to measure its error
+     * \param[in] time in ms
+     * \param[out] translation and rotation matrix row major of the tool
+     * \return false if there is no pose up to 100 ms before the time
+     */
+	bool predict(double, double[3], double[9]);
+
+    /**
+     * \brief Returns the RMS distance in mm from the predicted to the measured reference point
+     */
+	double getPredictionError();
+
+    /**
+     * \brief Returns the RMS distance in mm from the last measured to the measured reference point
+     * at the predicted times, the error without prediction
+     */
+	double getHoldError();
+
+    /**
+     * \brief Returns the number of predictions whose error was measured
+     */
+	int getNumberOfPredictions();
+
+private:
+
+	PoseFilter();
+
+	/** A prediction waiting for the measured pose */
+	struct Prediction
+	{
+		double time; ///<Predicted time
+		double point[3]; ///<Predicted reference point
+		double heldPoint[3]; ///<Last measured reference point when it was predicted
+	};
+
+	/** \brief Measure the error of the predictions up to the time of the last pose */
+	void checkPredictions();
+
+	double processNoise; ///<Acceleration standard deviation in mm/ms^2
+	double measurementNoise; ///<Position standard deviation in mm
+	double rotationGain; ///<Orientation gain
+	double horizon; ///<Display delay in ms
+	double referencePoint[3]; ///<Point of the tool for the prediction error
+
+	bool initialized; ///<There is a pose
+	double time; ///<Time of the filtered state
+	double position[3]; ///<Filtered position
+	double velocity[3]; ///<Velocity in mm/ms
+	double covariance[3]; ///<Position, cross and velocity covariance, the same for the three axes
+	double orientation[4]; ///<Filtered orientation quaternion w x y z
+	double angularVelocity[3]; ///<Angular velocity in rad/ms in the tracker coordinates
+
+	double lastTime; ///<Time of the last measured pose
+	double lastPoint[3]; ///<Reference point of the last measured pose
+	double previousTime; ///<Time of the pose before the last one
+	double previousPoint[3]; ///<Reference point of the pose before the last one
+
+	std::deque<Prediction> predictions; ///<Predictions waiting for a newer pose
+	double predictionSquares; ///<Sum of the squared prediction errors
+	double holdSquares; ///<Sum of the squared errors without prediction
+	int numberOfPredictions; ///<Predictions measured
+
+};
+
+#endif // POSEFILTER_H
@@ -0,0 +1,86 @@
+#include "PoseRing.h"
+
+PoseRing::PoseRing(int capacity)
+{
+	unsigned int size = 1;
+	while((int)size < capacity)
+		size <<= 1;
+
+	slots.resize(size);
+	mask = size - 1;
+
+	for(unsigned int i=0; i<size; i++)
+		slots[i].sequence = 0;
+	head = 0;
+}
+
+void PoseRing::push(const TrackingSample &sample)
+{
+	unsigned int n = head;
+	Slot &slot = slots[n & mask];
+
+	slot.sequence.fetchAndStoreOrdered(2*n + 1);
+	slot.sample = sample;
+	slot.sequence.fetchAndStoreOrdered(2*n + 2);
+
+	head.fetchAndStoreOrdered(n + 1);
+}
+
+unsigned int PoseRing::cursor()
+{
+	return (unsigned int)head.fetchAndAddAcquire(0);
+}
+
+unsigned int PoseRing::count()
+{
+	return (unsigned int)head.fetchAndAddAcquire(0);
+}
+
+bool PoseRing::read(unsigned int n, TrackingSample &sample)
+{
+	Slot &slot = slots[n & mask];
+
+	int before = slot.sequence.fetchAndAddAcquire(0);
+	if(before != (int)(2*n + 2))
+		return false;
+
+	sample = slot.sample;
+
+	// the writer did not start over the slot while it was copied
+	return slot.sequence.fetchAndAddOrdered(0) == before;
+}
+
+bool PoseRing::next(unsigned int &cursor, TrackingSample &sample)
+{
+	while(true){
+
+		unsigned int pushed = count();
+		if(cursor == pushed)
+			return false;
+
+		// the samples older than the ring size were overwritten
+		if(pushed - cursor > mask + 1)
+			cursor = pushed - (mask + 1);
+
+		if(read(cursor, sample)){
+			cursor++;
+			return true;
+		}
+
+		// overwritten while it was read, the reader is too slow
+		cursor++;
+	}
+}
+
+bool PoseRing::latest(TrackingSample &sample)
+{
+	while(true){
+
+		unsigned int pushed = count();
+		if(pushed == 0)
+			return false;
+
+		if(read(pushed - 1, sample))
+			return true;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef POSERING_H
+#define POSERING_H
+
+#include <QAtomicInt>
+
+#include "TrackingSample.h"
+
+#include <vector>
+
+//!Lock-free ring of tracking samples with one writer and many readers
+/*!
+  The acquisition thread pushes the samples without waiting for the readers, when the ring is
+  full the oldest samples are overwritten. Each slot has a sequence number that is odd while the
+  slot is written, a reader copies the sample and checks the sequence did not change, so the
+  readers never block the writer. Each reader keeps its own cursor and consumes the samples at
+  its own pace, a reader that falls behind more than the ring size skips the lost samples.
+*/
+class PoseRing
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     * \param[in] number of samples kept, rounded up to a power of two
+     */
+	PoseRing(int capacity = 1024);
+
+    /**
+     * \brief Add a sample, only one thread can push
+     */
+	void push(const TrackingSample &);
+
+    /**
+     * \brief Returns the cursor of a new reader, it reads the samples pushed from now on
+     */
+	unsigned int cursor();
+
+    /**
+     * \brief Copy the next sample of a reader and advance its cursor
+     * \return false if there is no new sample
+     */
+	bool next(unsigned int &, TrackingSample &);
+
+    /**
+     * \brief Copy the newest sample
+     * \return false if no sample was pushed
+     */
+	bool latest(TrackingSample &);
+
+    /**
+     * \brief Returns the number of samples pushed
+     */
+	unsigned int count();
+
+private:
+
+	/** \brief Copy a slot if it still has the sample with index n */
+	bool read(unsigned int, TrackingSample &);
+
+	struct Slot
+	{
+		QAtomicInt sequence; ///<2n+1 while the sample n is written, 2n+2 when it is ready
+		TrackingSample sample; ///<The sample
+	};
+
+	std::vector<Slot> slots; ///<The ring
+	unsigned int mask; ///<Capacity - 1
+	QAtomicInt head; ///<Number of samples pushed
+};
+
+#endif // POSERING_H
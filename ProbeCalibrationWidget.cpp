@@ -7,6 +7,7 @@
 
 #include "ProbeCalibrationWidget.h"
 #include "Calibration.h"
+#include "CrosswireDetector.h"
 
 #include <QErrorMessage>
 #include <QString>
@@ -19,15 +20,19 @@
 #include <vnl/vnl_vector_fixed.h>
 #include <vnl/algo/vnl_levenberg_marquardt.h>
 #include <vnl/vnl_double_2.h>
+#include <vnl/vnl_math.h>
+
+#include <algorithm>
 
 using namespace std;
 
 ProbeCalibrationWidget::ProbeCalibrationWidget(QWidget* parent) : QWidget(parent)
 {
     this->setupUi(this);
+    this->liveCalibrator = 0;
     
     QStringList header;
-    header << "Frame" << "X" << "Y";
+    header << "Frame" << "X" << "Y" << "Conf.";
     tableWidget->setHorizontalHeaderLabels(header);
 }
 
@@ -35,6 +40,7 @@ ProbeCalibrationWidget::ProbeCalibrationWidget(QWidget* parent) : QWidget(parent
 ProbeCalibrationWidget::~ProbeCalibrationWidget()
 {
     this->image = NULL;
+    delete liveCalibrator;
     delete this;
 }
 
@@ -230,11 +236,14 @@ void ProbeCalibrationWidget::getCoordinates()
         tableWidget->setItem(row, 0, new QTableWidgetItem(str.setNum(row)));
         tableWidget->setItem(row, 1, new QTableWidgetItem(str.setNum(x)));
         tableWidget->setItem(row, 2, new QTableWidgetItem(str.setNum(y)));
+        tableWidget->setItem(row, 3, new QTableWidgetItem("picked"));
        
 		std::cout<<"Picked Pixel for Image "<<row<< ": "<<x<<","<<y<<std::endl;
 
 		coords[row][0] = x;
         coords[row][1] = y;
+
+        updateLiveCalibration(row);
     }
     else
     {
@@ -349,23 +358,215 @@ void ProbeCalibrationWidget::calibrate()
     for (uint i = 0; i < imageStack.size(); i++) {            
         
 		std::cout<<"Image "<<i+1<<" data"<<std::endl;                   
-        vnl_quaternion<double> quaternion(rotations[i][1], rotations[i][2], 
-			rotations[i][3], rotations[i][0]);
-        vnl_matrix<double> transformation = quaternion.rotation_matrix_transpose();
-        transformation = transformation.transpose();
-		calibrator->InsertTransformations(transformation, translations.get_row(i));
+		calibrator->InsertTransformations(getRotationMatrix(i), translations.get_row(i));
 
 		calibrator->InsertImagePoints(coords[i]);
 
     }
     
-	calibrator->Calibrate();
+	if (ransacCheckBox->isChecked())
+	{
+		calibrator->SetInlierThreshold(inlierThreshold->value());
+		calibrator->CalibrateRANSAC();
+
+		// mark the rejected images in the table
+		std::vector<bool> inliers = calibrator->getInliers();
+		int inlierCount = 0;
+		for (uint i = 0; i < inliers.size(); i++)
+		{
+			if (inliers[i])
+				inlierCount++;
+
+			for (int j = 0; j < tableWidget->columnCount(); j++)
+				if (tableWidget->item(i, j))
+					tableWidget->item(i, j)->setBackground(inliers[i] ? Qt::white : Qt::red);
+		}
+
+		QString str;
+		mainWindow->addLogText("RANSAC inliers: <b>" + str.setNum(inlierCount) + "</b> of " +
+			QString::number(inliers.size()) + " images");
+	}
+	else
+	{
+		calibrator->Calibrate();
+	}
 
     calibrationParameters = calibrator->getEstimatedUSCalibrationParameters();
+
+	delete calibrator;
     
 }
 
 
+void ProbeCalibrationWidget::detectCrosswires()
+{
+    if (!workWithStack || imageStack.empty())
+    {
+        QErrorMessage errorMessage(this);
+        errorMessage.showMessage("<b>No image stack loaded</b> <br /> Load the calibration images first");
+        errorMessage.exec();
+        return;
+    }
+
+    CrosswireDetector * detector = CrosswireDetector::New();
+    detector->setImageStack(imageStack);
+    detector->detect();
+
+    std::vector<CrosswireDetector::Crosswire> crosswires = detector->getCrosswires();
+    delete detector;
+
+    this->coords.set_size(imageStack.size(), 2);
+    tableWidget->setRowCount(imageStack.size());
+
+    QString str;
+    int review = 0;
+
+    for (uint i = 0; i < crosswires.size(); i++)
+    {
+        coords[i][0] = crosswires[i].x;
+        coords[i][1] = crosswires[i].y;
+
+        tableWidget->setItem(i, 0, new QTableWidgetItem(str.setNum(i)));
+        tableWidget->setItem(i, 1, new QTableWidgetItem(str.setNum(crosswires[i].x, 'f', 1)));
+        tableWidget->setItem(i, 2, new QTableWidgetItem(str.setNum(crosswires[i].y, 'f', 1)));
+        tableWidget->setItem(i, 3, new QTableWidgetItem(str.setNum(crosswires[i].confidence, 'f', 2)));
+
+        // the user picks these points again with the image picker
+        if (!crosswires[i].found || crosswires[i].confidence < 0.3)
+        {
+            for (int j = 0; j < tableWidget->columnCount(); j++)
+                tableWidget->item(i, j)->setBackground(Qt::yellow);
+            review++;
+        }
+    }
+
+    mainWindow->addLogText("Crosswires detected, <b>" + str.setNum(review) + "</b> images to review");
+}
+
+
+vnl_matrix<double> ProbeCalibrationWidget::getRotationMatrix(int image)
+{
+    vnl_quaternion<double> quaternion(rotations[image][1], rotations[image][2], 
+        rotations[image][3], rotations[image][0]);
+    vnl_matrix<double> transformation = quaternion.rotation_matrix_transpose();
+    return transformation.transpose();
+}
+
+
+void ProbeCalibrationWidget::updateLiveCalibration(int image)
+{
+    // the poses are needed to calibrate
+    if (rotations.rows() != imageStack.size() || translations.rows() != imageStack.size())
+        return;
+
+    if (picked.size() != imageStack.size())
+        picked.assign(imageStack.size(), false);
+
+    bool repicked = picked[image];
+    picked[image] = true;
+
+    if (liveCalibrator == 0 || repicked)
+    {
+        // a point changed, the estimate starts again with all the picked points
+        delete liveCalibrator;
+        liveCalibrator = Calibration::New();
+        liveCalibrator->SetVerbose(false);
+
+        for (uint i = 0; i < picked.size(); i++)
+            if (picked[i])
+                liveCalibrator->AddImage(getRotationMatrix(i), translations.get_row(i), coords[i]);
+    }
+    else
+    {
+        liveCalibrator->AddImage(getRotationMatrix(image), translations.get_row(image), coords[image]);
+    }
+
+    int images = std::count(picked.begin(), picked.end(), true);
+    std::vector<double> parameters = liveCalibrator->getEstimatedUSCalibrationParameters();
+    std::vector<double> deviations = liveCalibrator->getParameterDeviations();
+
+    QString str;
+
+    if (parameters.size() < 11 || deviations.size() < 11)
+    {
+        liveLabel->setText("Live estimate: " + str.setNum(images) + " points, pick more points");
+        return;
+    }
+
+    double translationDeviation = std::max(deviations[3], std::max(deviations[4], deviations[5]));
+    double angleDeviation = std::max(deviations[6], std::max(deviations[7], deviations[8]))*180/vnl_math::pi;
+
+    QString text = "Live estimate: " + str.setNum(images) + " points<br />t3 = (" +
+        QString::number(parameters[3], 'f', 1) + ", " + QString::number(parameters[4], 'f', 1) + ", " +
+        QString::number(parameters[5], 'f', 1) + ") &plusmn; " + QString::number(translationDeviation, 'f', 2) +
+        " mm<br />omega &plusmn; " + QString::number(angleDeviation, 'f', 2) + " deg";
+
+    if (liveCalibrator->IsStable())
+    {
+        text += "<br /><b>Stable, no more points needed</b>";
+        mainWindow->addLogText("Calibration estimate stable after <b>" + str.setNum(images) + "</b> points");
+    }
+
+    liveLabel->setText(text);
+}
+
+
+void ProbeCalibrationWidget::analyzePrecision()
+{
+    if (rotations.rows() != imageStack.size() || translations.rows() != imageStack.size())
+    {
+        QErrorMessage errorMessage(this);
+        errorMessage.showMessage("<b>No poses loaded</b> <br /> Load the rotations and translations files first");
+        errorMessage.exec();
+        return;
+    }
+
+	Calibration * calibrator = Calibration::New();
+	calibrator->SetVerbose(false);
+
+    for (uint i = 0; i < imageStack.size(); i++)
+    {
+		calibrator->InsertTransformations(getRotationMatrix(i), translations.get_row(i));
+		calibrator->InsertImagePoints(coords[i]);
+    }
+
+	calibrator->SetVerbose(true);
+
+    if (!calibrator->AnalyzePrecision(200))
+    {
+        delete calibrator;
+        return;
+    }
+
+    std::vector<double> deviations = calibrator->getBootstrapDeviations();
+    std::vector<double> influences = calibrator->getImageInfluences();
+    delete calibrator;
+
+    if (deviations.size() == 11)
+    {
+        double translationDeviation = std::max(deviations[3], std::max(deviations[4], deviations[5]));
+        double angleDeviation = std::max(deviations[6], std::max(deviations[7], deviations[8]))*180/vnl_math::pi;
+
+        mainWindow->addLogText("Bootstrap precision: t3 &plusmn; <b>" + QString::number(translationDeviation, 'f', 2) +
+            "</b> mm, omega &plusmn; <b>" + QString::number(angleDeviation, 'f', 2) + "</b> deg");
+    }
+
+    // the three most influential images are highlighted
+    for (int k = 0; k < 3 && k < (int)influences.size(); k++)
+    {
+        int worst = std::max_element(influences.begin(), influences.end()) - influences.begin();
+
+        for (int j = 0; j < tableWidget->columnCount(); j++)
+            if (tableWidget->item(worst, j))
+                tableWidget->item(worst, j)->setBackground(QColor(255, 165, 0));
+
+        mainWindow->addLogText("Influential image: <b>" + QString::number(worst) + "</b> (" +
+            QString::number(influences[worst], 'f', 1) + ")");
+        influences[worst] = -1;
+    }
+}
+
+
 void ProbeCalibrationWidget::saveCalibration()
 {
 
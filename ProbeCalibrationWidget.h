@@ -11,6 +11,8 @@
 #include "ui_ProbeCalibrationWidget.h"
 #include "mainwindow.h"
 
+class Calibration;
+
 #include <QWidget>
 
 #include <vtkSmartPointer.h>
@@ -92,6 +94,20 @@ private:
     
     /** \brief the estimate calibration parameters by Calibration.h */
     std::vector<double> calibrationParameters;
+
+    /** \brief updated with each picked point */
+    Calibration * liveCalibrator;
+
+    /** \brief images with a picked point in the live estimate */
+    std::vector<bool> picked;
+
+    /** \brief rotation matrix of an image from the rotations file */
+    vnl_matrix<double> getRotationMatrix(int image);
+
+    /**
+     * \brief Add the picked point of an image to the live estimate and show its convergence
+     */
+    void updateLiveCalibration(int image);
     
     
 private slots:
@@ -124,6 +140,18 @@ private slots:
      * \brief Save the Estimated Parameters in a .txt file
      */
     void saveCalibration();
+
+    /**
+     * \brief Find the crosswire point in all the images and fill the coordinates table,
+     * the images with low confidence are highlighted to be reviewed
+     */
+    void detectCrosswires();
+
+    /**
+     * \brief Calls Calibrate.h to estimate the precision of the parameters with leave-one-out
+     * and bootstrap resamples, highlights the most influential images
+     */
+    void analyzePrecision();
     
 };
 
@@ -208,6 +208,50 @@ void QVTKImageWidget::setAndDisplayVolumeImages(QStringList imageFilenames, QStr
         reader = NULL;
 	}
 
+    if (!loadVolumePoses(imageFilenames.size(), rotationFilename, translationFilename, calibrationFilename))
+        return;
+
+    isVolumeImageStackLoaded = true;
+
+    displayVolumeImages(volumeImageStack, volumeDataRotations, volumeDataTranslations, volumeDataCalibration);
+
+}
+
+
+void QVTKImageWidget::setVolumePoses(QStringList imageFilenames, QString rotationFilename,
+									 QString translationFilename, QString calibrationFilename)
+{
+    this->volumeImageStack.clear();
+    this->transformStack.clear();
+    isVolumeImageStackLoaded = false;
+
+    if (!loadVolumePoses(imageFilenames.size(), rotationFilename, translationFilename, calibrationFilename))
+        return;
+
+    int numberOfImages = imageFilenames.size();
+    if (volumeDataRotations.rows() < numberOfImages || volumeDataTranslations.rows() < numberOfImages
+        || volumeDataCalibration.size() < 8)
+    {
+        std::cout<<"The rotation, translation and calibration data do not match the images"<<std::endl;
+        return;
+    }
+
+	std::cout<<std::endl;
+	std::cout<<"Calculating Transformation Matrix for images "<<std::endl;
+
+    this->transformStack.reserve(imageFilenames.size());
+    for(int i=0; i < imageFilenames.size(); i++)
+		transformStack.push_back(this->computeTransformation(volumeDataRotations.get_row(i),
+			volumeDataTranslations.get_row(i), volumeDataCalibration));
+
+	scale.set_size(2);
+	scale.put(0,volumeDataCalibration[6]);
+	scale.put(1,volumeDataCalibration[7]);
+}
+
+bool QVTKImageWidget::loadVolumePoses(int numberOfImages, QString rotationFilename,
+									  QString translationFilename, QString calibrationFilename)
+{
 	std::cout<<std::endl;
 	std::cout<<"Loading Rotation Data"<<std::endl;
     if (!rotationFilename.isEmpty())
@@ -215,13 +259,13 @@ void QVTKImageWidget::setAndDisplayVolumeImages(QStringList imageFilenames, QStr
 
         QFile file(rotationFilename);
         if (!file.open(QIODevice::ReadOnly))
-            return;
+            return false;
 
         QTextStream stream(&file);
         QString line;
 
         // declare a rotation matrix
-        this->volumeDataRotations.set_size(volumeImageStack.size(), 4);
+        this->volumeDataRotations.set_size(numberOfImages, 4);
         int idx = 0;
         while (!stream.atEnd())
         {
@@ -245,13 +289,13 @@ void QVTKImageWidget::setAndDisplayVolumeImages(QStringList imageFilenames, QStr
 
          QFile file(translationFilename);
          if (!file.open(QIODevice::ReadOnly))
-            return;
+            return false;
 
          QTextStream stream(&file);
          QString line;
 
          // declare a translation matrix
-         this->volumeDataTranslations.set_size(volumeImageStack.size(), 3);
+         this->volumeDataTranslations.set_size(numberOfImages, 3);
 
          int idx = 0;
          while (!stream.atEnd())
@@ -278,7 +322,7 @@ void QVTKImageWidget::setAndDisplayVolumeImages(QStringList imageFilenames, QStr
 
          QFile file(calibrationFilename);
          if (!file.open(QIODevice::ReadOnly))
-            return;
+            return false;
 
          QTextStream stream(&file);
          QString line;
@@ -294,12 +338,9 @@ void QVTKImageWidget::setAndDisplayVolumeImages(QStringList imageFilenames, QStr
           }
           
 		  file.close(); // when your done.
-        }      
-
-    isVolumeImageStackLoaded = true;
-
-    displayVolumeImages(volumeImageStack, volumeDataRotations, volumeDataTranslations, volumeDataCalibration);
+        }
 
+    return true;
 }
 
 
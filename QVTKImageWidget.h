@@ -99,6 +99,13 @@ public:
      *  a QStringList that contain the filename the translation data of each image.
      */
     void setAndDisplayVolumeImages(QStringList ImagesFilenames,QString rotationFilename, QString translatoinFilename, QString calibrationFilename);
+
+    /**
+     * \brief Set the transformation of each image of the volume data without reading the images,
+     * for a reconstruction that streams the images from disk.
+     * \param[in] the filename of each image and the rotation, translation and calibration data files.
+     */
+    void setVolumePoses(QStringList ImagesFilenames, QString rotationFilename, QString translationFilename, QString calibrationFilename);
     
     /**
      * \brief Set and display volume data.
@@ -378,6 +385,13 @@ private:
      */
     void displayVolume(vtkSmartPointer<vtkVolume> volume);
     
+    /**
+     * Read the rotation, translation and calibration data of the given number of volume images,
+     * returns false if a file can not be opened
+     */
+    bool loadVolumePoses(int numberOfImages, QString rotationFilename, QString translationFilename,
+                         QString calibrationFilename);
+
     /**
      * Compute the transformation matricez of each image
      */
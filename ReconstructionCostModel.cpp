@@ -0,0 +1,186 @@
+#include "ReconstructionCostModel.h"
+#include "VolumeReconstruction.h"
+
+#include <vtkMath.h>
+#include <itkTimeProbe.h>
+
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+ReconstructionCostModel::ReconstructionCostModel()
+{
+	imageCost = 0;
+	voxelCost = 0;
+	parallelEfficiency = 1;
+	calibrated = false;
+}
+
+void ReconstructionCostModel::calibrate(vnl_vector<double> volumeOrigin, vnl_vector<double> volumeFinal,
+										int numberOfThreads)
+{
+	int images = volumeImageStack.size();
+	if(images < 2)
+		return;
+
+	std::cout<<std::endl<<"Calibrating reconstruction cost model"<<std::endl;
+
+	// a block of voxels in the center of the volume, with enough columns for all threads
+	vnl_vector<double> probeSize(3);
+	probeSize[0] = std::max(16, 2*numberOfThreads);
+	probeSize[1] = 16;
+	probeSize[2] = 16;
+
+	vnl_vector<double> probeOrigin(3);
+	for(int d=0; d<3; d++)
+		probeOrigin[d] = (volumeOrigin[d] + volumeFinal[d])/2 - probeSize[d]*scale[0]/2;
+
+	double voxels = probeSize[0]*probeSize[1]*probeSize[2];
+
+	int step = 4;
+	int fewImages = (images + step - 1)/step;
+	if(fewImages < 2){
+		step = 1;
+		fewImages = images;
+	}
+
+	double allImagesTime = runProbe(probeOrigin, probeSize, 1, 1);
+	double fewImagesTime = runProbe(probeOrigin, probeSize, step, 1);
+	double threadsTime = runProbe(probeOrigin, probeSize, 1, numberOfThreads);
+
+	if(images > fewImages)
+		imageCost = std::max(0.0, (allImagesTime - fewImagesTime)/(voxels*(images - fewImages)));
+	else
+		imageCost = 0;
+
+	voxelCost = std::max(0.0, allImagesTime/voxels - imageCost*images);
+
+	if(imageCost == 0 && voxelCost == 0)
+		voxelCost = allImagesTime/voxels;
+
+	parallelEfficiency = 1;
+	if(numberOfThreads > 1 && threadsTime > 0)
+		parallelEfficiency = std::min(1.0, std::max(0.1, allImagesTime/(threadsTime*numberOfThreads)));
+
+	calibrated = true;
+
+	std::cout<<"Time per voxel and image: "<<imageCost*1e9<<" ns"<<std::endl;
+	std::cout<<"Time per voxel: "<<voxelCost*1e9<<" ns"<<std::endl;
+	std::cout<<"Parallel efficiency with "<<numberOfThreads<<" threads: "<<parallelEfficiency<<std::endl;
+}
+
+double ReconstructionCostModel::runProbe(vnl_vector<double> probeOrigin, vnl_vector<double> probeSize,
+										 int step, int numberOfThreads)
+{
+	std::vector< vnl_vector<double> > boundsX;
+	std::vector< vnl_vector<double> > boundsY;
+	std::vector< vnl_vector<double> > boundsZ;
+	std::vector< vtkSmartPointer<vtkImageData> > images;
+	std::vector< vnl_matrix<double> > transforms;
+
+	for(unsigned int i=0; i<volumeImageStack.size(); i+=step){
+		boundsX.push_back(imageBoundsXStack.at(i));
+		boundsY.push_back(imageBoundsYStack.at(i));
+		boundsZ.push_back(imageBoundsZStack.at(i));
+		images.push_back(volumeImageStack.at(i));
+		transforms.push_back(transformStack.at(i));
+	}
+
+	VolumeReconstruction * reconstructor = VolumeReconstruction::New();
+
+	reconstructor->setImageBoundsStack(boundsX, boundsY, boundsZ);
+	reconstructor->setScale(scale);
+	reconstructor->setTransformStack(transforms);
+	reconstructor->setVolumeImageStack(images);
+	reconstructor->setVolumeOrigin(probeOrigin);
+	reconstructor->setVolumeSize(probeSize);
+	reconstructor->setResolution(1);
+	reconstructor->setNumberOfThreads(numberOfThreads);
+
+	itk::TimeProbe clock;
+	clock.Start();
+	reconstructor->generateVolume();
+	clock.Stop();
+
+	delete reconstructor;
+
+	return clock.GetMean();
+}
+
+bool ReconstructionCostModel::isCalibrated()
+{
+	return calibrated;
+}
+
+double ReconstructionCostModel::predictTime(double voxels, int images, int numberOfThreads)
+{
+	double speedup = std::max(1.0, numberOfThreads*parallelEfficiency);
+	return voxels*(imageCost*images + voxelCost)/speedup;
+}
+
+double ReconstructionCostModel::predictTime(vnl_vector<double> volumeOrigin, vnl_vector<double> volumeFinal,
+											int resolution, double roiScale, int numberOfThreads)
+{
+	double voxels = 1;
+	for(int d=0; d<3; d++)
+		voxels *= std::max(1, vtkMath::Round(roiScale*(volumeFinal[d] - volumeOrigin[d])/(scale[0]*resolution)));
+
+	return predictTime(voxels, volumeImageStack.size(), numberOfThreads);
+}
+
+ReconstructionCostModel::Parameters ReconstructionCostModel::selectParameters(double timeBudget,
+		vnl_vector<double> volumeOrigin, vnl_vector<double> volumeFinal, int numberOfThreads)
+{
+	Parameters parameters;
+	parameters.roiScale = 1;
+
+	for(int resolution=1; resolution<=10; resolution++){
+
+		parameters.resolution = resolution;
+		parameters.predictedTime = predictTime(volumeOrigin, volumeFinal, resolution, 1, numberOfThreads);
+
+		if(parameters.predictedTime <= timeBudget)
+			return parameters;
+	}
+
+	// the time is proportional to the cube of the roi scale
+	parameters.roiScale = std::max(0.05, pow(timeBudget/parameters.predictedTime, 1.0/3.0));
+
+	while(parameters.roiScale > 0.05){
+		parameters.predictedTime = predictTime(volumeOrigin, volumeFinal, parameters.resolution,
+											   parameters.roiScale, numberOfThreads);
+		if(parameters.predictedTime <= timeBudget)
+			break;
+		parameters.roiScale *= 0.95;
+	}
+
+	parameters.predictedTime = predictTime(volumeOrigin, volumeFinal, parameters.resolution,
+										   parameters.roiScale, numberOfThreads);
+
+	return parameters;
+}
+
+void ReconstructionCostModel::setImageBoundsStack(std::vector< vnl_vector<double> > imageBoundsXStack
+                                               , std::vector< vnl_vector<double> > imageBoundsYStack
+                                               , std::vector< vnl_vector<double> > imageBoundsZStack)
+{
+    this->imageBoundsXStack = imageBoundsXStack;
+    this->imageBoundsYStack = imageBoundsYStack;
+    this->imageBoundsZStack = imageBoundsZStack;
+}
+
+void ReconstructionCostModel::setScale(vnl_vector<double> scale)
+{
+    this->scale = scale;
+}
+
+void ReconstructionCostModel::setTransformStack(std::vector< vnl_matrix<double> > transformStack)
+{
+    this->transformStack = transformStack;
+}
+
+void ReconstructionCostModel::setVolumeImageStack(
+        std::vector< vtkSmartPointer<vtkImageData> > volumeImageStack)
+{
+    this->volumeImageStack = volumeImageStack;
+}
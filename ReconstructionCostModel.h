@@ -0,0 +1,116 @@
+#ifndef RECONSTRUCTIONCOSTMODEL_H
+#define RECONSTRUCTIONCOSTMODEL_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <vector>
+
+//!Predicts the time of a volume reconstruction
+/*!
+  This class predicts the time of VolumeReconstruction::generateVolume() from the number of voxels,
+  the number of images and the number of threads. The voxel based method compares each voxel with
+  every image plane, so the time is modeled as voxels*(a*images + b)/speedup(threads).
+  The model is calibrated with a few reconstructions of a small block in the center of the volume.
+  Given a time budget it selects the finest resolution and the largest region of interest that fit.
+*/
+class ReconstructionCostModel
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static ReconstructionCostModel *New()
+	{
+			return new ReconstructionCostModel;
+	}
+
+    /** The selected reconstruction parameters */
+	struct Parameters
+	{
+		int resolution; ///<Selected resolution
+		double roiScale; ///<Fraction of the volume extent in each axis, centered
+		double predictedTime; ///<Predicted time in seconds
+	};
+
+    /**
+     * \brief Set the image bounds
+     */
+    void setImageBoundsStack(std::vector< vnl_vector<double> >, std::vector< vnl_vector<double> >,
+                              std::vector< vnl_vector<double> >);
+
+    /**
+     * \brief Set image data stack
+     */
+    void setVolumeImageStack(std::vector< vtkSmartPointer< vtkImageData> >);
+
+    /**
+     * \brief Set the transformation for each image
+     */
+    void setTransformStack(std::vector< vnl_matrix<double> >);
+
+    /**
+     * \brief Set the scale of the images
+     */
+    void setScale(vnl_vector<double>);
+
+    /**
+     * \brief Run the probe reconstructions in the center of the volume
+     * \param[in] volume origin, volume final and number of threads
+     */
+	void calibrate(vnl_vector<double>, vnl_vector<double>, int);
+
+    /**
+     * \brief Returns true if the model was calibrated
+     */
+	bool isCalibrated();
+
+    /**
+     * \brief Predicted time in seconds
+     * \param[in] number of voxels, number of images and number of threads
+     */
+	double predictTime(double, int, int);
+
+    /**
+     * \brief Predicted time in seconds to reconstruct the volume
+     * \param[in] volume origin, volume final, resolution, roi scale and number of threads
+     */
+	double predictTime(vnl_vector<double>, vnl_vector<double>, int, double, int);
+
+    /**
+     * \brief Select the finest resolution (1 to 10) that fits in the time budget. If the whole volume
+     * does not fit at the coarsest resolution the region of interest is reduced around the center
+     * \param[in] time budget in seconds, volume origin, volume final and number of threads
+     */
+	Parameters selectParameters(double, vnl_vector<double>, vnl_vector<double>, int);
+
+private:
+
+	ReconstructionCostModel();
+
+	double imageCost; ///<Seconds per voxel and image
+	double voxelCost; ///<Seconds per voxel
+	double parallelEfficiency; ///<Measured speedup divided by the number of threads
+	bool calibrated; ///<Flag to know if the probe was run
+
+    std::vector< vnl_vector<double> > imageBoundsXStack; ///<Bounds in x of each image
+    std::vector< vnl_vector<double> > imageBoundsYStack; ///<Bounds in y of each image
+    std::vector< vnl_vector<double> > imageBoundsZStack; ///<Bounds in z of each image
+    std::vector< vtkSmartPointer< vtkImageData> > volumeImageStack; ///<The stack of images data
+    std::vector< vnl_matrix<double> > transformStack; ///<Transformation of each image
+	vnl_vector<double> scale; ///<Scale of the images
+
+    /**
+     * \brief Reconstruct a block of voxels with every step-th image
+     * \param[out] time in seconds
+     */
+	double runProbe(vnl_vector<double>, vnl_vector<double>, int, int);
+
+};
+
+#endif // RECONSTRUCTIONCOSTMODEL_H
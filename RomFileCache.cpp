@@ -0,0 +1,123 @@
+#include "RomFileCache.h"
+
+#include <QMutexLocker>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+
+/** Largest SROM image the NDI trackers accept */
+static const int maximumRomSize = 1024;
+
+RomFileCache::RomFileCache()
+	: loader(this), hits(0), misses(0)
+{
+}
+
+RomFileCache * RomFileCache::instance()
+{
+	static RomFileCache cache;
+	return &cache;
+}
+
+void RomFileCache::LoaderThread::run()
+{
+	for(int i = 0; i < filenames.size(); i++)
+		cache->load(filenames.at(i));
+}
+
+void RomFileCache::preload(QStringList filenames)
+{
+	loader.wait();
+	loader.filenames = filenames;
+	loader.start(QThread::LowPriority);
+}
+
+RomFileCache::RomFile RomFileCache::get(QString filename)
+{
+	loader.wait();
+	return load(filename);
+}
+
+int RomFileCache::getHits()
+{
+	QMutexLocker locker(&mutex);
+	return hits;
+}
+
+int RomFileCache::getMisses()
+{
+	QMutexLocker locker(&mutex);
+	return misses;
+}
+
+RomFileCache::RomFile RomFileCache::load(QString filename)
+{
+	RomFile rom;
+	rom.filename = filename;
+	rom.valid = false;
+
+	QFileInfo info(filename);
+	if(filename.isEmpty() || !info.exists())
+	{
+		rom.error = "the tool file " + filename + " does not exist";
+		return rom;
+	}
+
+	{
+		QMutexLocker locker(&mutex);
+		QMap<QString, FileVersion>::const_iterator version = files.constFind(info.absoluteFilePath());
+		if(version != files.constEnd() && version->size == info.size() && version->modified == info.lastModified()
+			&& roms.contains(version->hash) && QFile::exists(roms.value(version->hash).cachedFilename))
+		{
+			hits++;
+			rom = roms.value(version->hash);
+			rom.filename = filename;
+			return rom;
+		}
+	}
+
+	QFile file(filename);
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		rom.error = "could not read the tool file " + filename;
+		return rom;
+	}
+	rom.data = file.readAll();
+	file.close();
+
+	rom.hash = QCryptographicHash::hash(rom.data, QCryptographicHash::Md5);
+
+	if(rom.data.isEmpty())
+		rom.error = "the tool file " + filename + " is empty";
+	else if(rom.data.size() > maximumRomSize)
+		rom.error = "the tool file " + filename + " has more than " + QString::number(maximumRomSize) + " bytes";
+	else
+		rom.valid = true;
+
+	if(rom.valid)
+	{
+		// an existing copy with the same size has the same content, its name is the hash
+		rom.cachedFilename = QDir::temp().filePath("srom_" + QString(rom.hash.toHex()) + ".rom");
+		QFile copy(rom.cachedFilename);
+		if(copy.size() != rom.data.size())
+		{
+			// without a copy the tracker reads the original file
+			if(!copy.open(QIODevice::WriteOnly) || copy.write(rom.data) != rom.data.size())
+				rom.cachedFilename = filename;
+			copy.close();
+		}
+	}
+
+	FileVersion version;
+	version.size = info.size();
+	version.modified = info.lastModified();
+	version.hash = rom.hash;
+
+	QMutexLocker locker(&mutex);
+	misses++;
+	files.insert(info.absoluteFilePath(), version);
+	roms.insert(rom.hash, rom);
+
+	return rom;
+}
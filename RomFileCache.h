@@ -0,0 +1,100 @@
+#ifndef ROMFILECACHE_H
+#define ROMFILECACHE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QMap>
+
+//!Cache of the tool definition (SROM) files
+/*!
+  The SROM files of the tools are read, hashed and validated by a background thread while the
+  serial port is opened and the tracker is reset, so a missing or invalid file is reported before
+  any tool is uploaded and the disk reads do not add to the serial initialization. The files are
+  kept by the hash of their content for the whole process: a file is read again only if its size
+  or modification time changed, and files with the same content share one entry. IGSTK uploads an
+  SROM from a file, so each checked content is also written once to a copy named by its hash in
+  the temporary directory: the tracker reads the local copy of the content that was checked, even
+  if the original file changes or is on a slow drive.
+*/
+class RomFileCache
+{
+
+public:
+
+	/** A tool definition file */
+	struct RomFile
+	{
+		QString filename; ///<File it was read from
+		QByteArray hash; ///<MD5 of the content
+		QByteArray data; ///<Content
+		QString cachedFilename; ///<Copy of the checked content, the file given to the tracker
+		bool valid; ///<The file can be uploaded to the tracker
+		QString error; ///<Why the file is not valid
+	};
+
+    /**
+     * \brief Returns the cache of the process
+     */
+	static RomFileCache * instance();
+
+    /**
+     * \brief Read the files in a background thread, get() waits for it
+     */
+	void preload(QStringList);
+
+    /**
+     * \brief Returns a file, read now if it is not in the cache or it changed
+     */
+	RomFile get(QString);
+
+    /**
+     * \brief Returns the number of files found in the cache
+     */
+	int getHits();
+
+    /**
+     * \brief Returns the number of files read from disk
+     */
+	int getMisses();
+
+private:
+
+	RomFileCache();
+
+	/** Thread that reads the files of preload() */
+	class LoaderThread : public QThread
+	{
+	public:
+		LoaderThread(RomFileCache * cache) : cache(cache) {}
+		QStringList filenames; ///<Files to read
+	protected:
+		void run();
+	private:
+		RomFileCache * cache;
+	};
+	friend class LoaderThread;
+
+	/** Version of a file that was read */
+	struct FileVersion
+	{
+		qint64 size; ///<Size of the file
+		QDateTime modified; ///<Modification time of the file
+		QByteArray hash; ///<Hash of its content
+	};
+
+	/** \brief Returns a file from the cache or from disk */
+	RomFile load(QString);
+
+	QMutex mutex; ///<Protects the maps and the counters
+	QMap<QString, FileVersion> files; ///<Last version read of each file
+	QMap<QByteArray, RomFile> roms; ///<Files by the hash of their content
+	LoaderThread loader; ///<Reads the files of preload()
+	int hits; ///<Files found in the cache
+	int misses; ///<Files read from disk
+};
+
+#endif // ROMFILECACHE_H
@@ -3,15 +3,33 @@
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include <QStringList>
+#include <QTime>
+#include <QRegExp>
+#include <QDateTime>
 
 #include "Scene3D.h"
 
 #include "PolarisTracker.h"
+#ifdef USE_ASCENSION_3DG
+#include "MedSafeTracker.h"
+#endif
+#include "TrackingSession.h"
+#include "TrackingDevice.h"
+#include "TrackingLog.h"
+#include "TrackingLogOutput.h"
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+#include "RomFileCache.h"
+
+#include <QMutexLocker>
 
 #include "igstkLogger.h"
 #include "itkStdStreamLogOutput.h"
 
 #include "vtkSmartPointer.h"
+#include "vtkCallbackCommand.h"
+#include "vtkRenderWindow.h"
 #include "vtkMetaImageReader.h"
 #include "vtkImageData.h"
 #include "vtkImageChangeInformation.h"
@@ -22,50 +40,166 @@
 #include "igstkPolarisPointerObjectRepresentation.h"
 #include "igstkImageSpatialObjectVolumeRepresentation.h"
 
+/** Names of the tools of the instruments in the tracking session */
+static const char * instrumentNames[] = {"reference", "probe", "needle", "pointer"};
+
+/** Print and log the time of a startup phase and start the next one */
+static void endStartupPhase(const char * phase, QTime & phaseTimer, int & total, TrackingLog * trackingLog)
+{
+	int elapsed = phaseTimer.restart();
+	total += elapsed;
+	std::cout<<"	"<<phase<<": "<<elapsed<<" ms"<<std::endl;
+	if(trackingLog)
+		trackingLog->logEvent(igstk::RealTimeClock::GetTimeStamp(), 0,
+			QString("Startup %1: %2 ms").arg(phase).arg(elapsed).toAscii().data());
+}
+
+/** Passes the start of each render of the scene to the latency monitor */
+static void renderStartCallback(vtkObject *, unsigned long, void * clientData, void *)
+{
+	static_cast<LatencyMonitor *>(clientData)->renderStarted(igstk::RealTimeClock::GetTimeStamp());
+}
+
+/** Passes the end of each render of the scene to the latency monitor */
+static void renderEndCallback(vtkObject *, unsigned long, void * clientData, void *)
+{
+	static_cast<LatencyMonitor *>(clientData)->renderFinished(igstk::RealTimeClock::GetTimeStamp());
+}
 
 void Scene3D::configTracker(std::string referenceToolFilename, std::string ultrasoundProbeFilename, 
 							std::string needleFilename, std::string pointerFilename, QString probeCalibrationFilename)
 {
-
-	PolarisTracker* polarisTracker = PolarisTracker::New();
+	// the tool files are read and checked while the serial port is opened and the tracker reset
+	QStringList romFilenames;
+	romFilenames<<referenceToolFilename.c_str()<<ultrasoundProbeFilename.c_str()
+		<<needleFilename.c_str()<<pointerFilename.c_str();
+	RomFileCache * romFileCache = RomFileCache::instance();
+	romFileCache->preload(romFilenames);
+
+	QTime phaseTimer;
+	phaseTimer.start();
+	int startupTime = 0;
+
+	polarisTracker = PolarisTracker::New();
 	polarisTracker->setLoggerOn(false);
-	std::cout<<"-Initializing SerialCommunication"<<std::endl;
-	polarisTracker->initializeSerialCommunication(3);
+
+	delete trackingSession;
+	trackingSession = TrackingSession::New();
+
+	// the samples and the tracker events of the session are written by the log thread
+	delete trackingLog;
+	trackingLog = new TrackingLog("TrackingLog.bin");
+	if(trackingLog->open())
+	{
+		polarisTracker->setTrackingLog(trackingLog);
+		trackingSession->setTrackingLog(trackingLog);
+	}
+	else
+	{
+		delete trackingLog;
+		trackingLog = 0;
+	}
+
+	if(replayFilename.isEmpty())
+	{
+		std::cout<<"-Initializing SerialCommunication"<<std::endl;
+		polarisTracker->setCaptureFilename(captureFilename.toAscii().data());
+		polarisTracker->initializeSerialCommunication(3);
+	}
+	else
+	{
+		std::cout<<"-Initializing Replay Communication"<<std::endl;
+		polarisTracker->initializeReplayCommunication(replayFilename.toAscii().data(), replaySpeed);
+		replayFilename.clear();
+	}
+	captureFilename.clear();
+	endStartupPhase("communication", phaseTimer, startupTime, trackingLog);
 	std::cout<<"-Initializing Tracker"<<std::endl;
 	polarisTracker->initializeTracker();
+	endStartupPhase("tracker open", phaseTimer, startupTime, trackingLog);
+
+	// a bad tool file is reported before any tool is uploaded to the tracker,
+	// the tracker uploads the checked copies of the files
+	int hits = romFileCache->getHits();
+	std::vector<std::string> romCopies;
+	for(int i=0; i<romFilenames.size(); i++)
+	{
+		RomFileCache::RomFile rom = romFileCache->get(romFilenames.at(i));
+		romCopies.push_back(rom.cachedFilename.toAscii().data());
+		if(!rom.valid)
+		{
+			std::cout<<"Could not configure the tools, "<<rom.error.toAscii().data()<<std::endl;
+
+			// the serial port stays open otherwise and the next configuration can not open it
+			polarisTracker->closeTracker();
+			delete polarisTracker;
+			polarisTracker = 0;
+
+			QErrorMessage errorMessage;
+			errorMessage.showMessage("Could not configure the tools, </ br> " + rom.error);
+			errorMessage.exec();
+			return;
+		}
+	}
+	endStartupPhase("tool files", phaseTimer, startupTime, trackingLog);
+	std::cout<<"	"<<romFileCache->getHits() - hits<<" of "<<romFilenames.size()
+		<<" tool files in the cache"<<std::endl;
+
 	std::cout<<"-Initializing Reference Tracker Tool"<<std::endl;
-	polarisTracker->initializeTrackerTool(referenceToolFilename);
+	polarisTracker->initializeTrackerTool(romCopies[Reference], instrumentNames[Reference]);
 	std::cout<<"-Initializing Ulatrasound Probe Tracker Tool"<<std::endl;
-	polarisTracker->initializeTrackerTool(ultrasoundProbeFilename);
+	polarisTracker->initializeTrackerTool(romCopies[Probe], instrumentNames[Probe]);
 	std::cout<<"-Initializing Needle Tracker Tool"<<std::endl;
-	polarisTracker->initializeTrackerTool(needleFilename);
+#ifdef USE_ASCENSION_3DG
+	// the needle is tracked by the electromagnetic sensor, the optical tool stays in the session
+	polarisTracker->initializeTrackerTool(romCopies[Needle], "optical needle");
+#else
+	polarisTracker->initializeTrackerTool(romCopies[Needle], instrumentNames[Needle]);
+#endif
 	std::cout<<"-Initializing Pointer Tracker Tool"<<std::endl;
-	polarisTracker->initializeTrackerTool(pointerFilename);
+	polarisTracker->initializeTrackerTool(romCopies[Pointer], instrumentNames[Pointer]);
+	endStartupPhase("tool configuration", phaseTimer, startupTime, trackingLog);
 	std::cout<<"-Attaching all tools"<<std::endl;
-	polarisTracker->attachAllTools();
+	for(int i=0; i<polarisTracker->getNumberofTools(); i++)
+	{
+		// each tool is a handle request, the SROM upload and the port initialization and enabling
+		polarisTracker->attachTool(i);
+		endStartupPhase(("attach " + polarisTracker->getToolName(i)).c_str(), phaseTimer, startupTime, trackingLog);
+	}
 	std::cout<<"-Creating observers for all tools"<<std::endl;
 	polarisTracker->createToolsObervers();
+	polarisTracker->observeAllToolsTransformations();
+	endStartupPhase("observers", phaseTimer, startupTime, trackingLog);
 
 	tracker = polarisTracker->getTracker();
-
-	referenceTool = polarisTracker->getTools().at(0);
-	ultrasoundProbeTool = polarisTracker->getTools().at(1);
-	needleTool = polarisTracker->getTools().at(2);
-	pointerTool = polarisTracker->getTools().at(3);
-
-	coordSystemAObserverReferenceTool = polarisTracker->getObservers().at(0);
-	coordSystemAObserverReferenceTool->ObserveTransformEventsFrom(referenceTool);
-	coordSystemAObserverUltrasoundProbe = polarisTracker->getObservers().at(1);
-	coordSystemAObserverUltrasoundProbe->ObserveTransformEventsFrom(ultrasoundProbeTool);
-	coordSystemAObserverNeedle = polarisTracker->getObservers().at(2);
-	coordSystemAObserverNeedle->ObserveTransformEventsFrom(needleTool);
-	coordSystemAObserverPointer = polarisTracker->getObservers().at(3);
-	coordSystemAObserverPointer->ObserveTransformEventsFrom(pointerTool);
-
-	std::cout<<std::endl<<"-Reference Tracker Tool ID: "<<referenceTool->GetTrackerToolIdentifier()<<std::endl;
-	std::cout<<"-Ultrasound Tracker Probe Tool ID: "<<ultrasoundProbeTool->GetTrackerToolIdentifier()<<std::endl;
-	std::cout<<"-Needle Tracker Tool ID: "<<needleTool->GetTrackerToolIdentifier()<<std::endl;
-	std::cout<<"-Pointer Tracker Tool ID: "<<pointerTool->GetTrackerToolIdentifier()<<std::endl;
+	trackingSession->addDevice(polarisTracker);
+
+#ifdef USE_ASCENSION_3DG
+	std::cout<<"-Initializing Ascension 3DG Tracker"<<std::endl;
+	MedSafeTracker * medSafeTracker = MedSafeTracker::New();
+	medSafeTracker->InitializeLogger();
+	medSafeTracker->InitializeTracker();
+	std::cout<<"-Initializing Needle Sensor"<<std::endl;
+	medSafeTracker->InitializeTrackerTool(0, instrumentNames[Needle]);
+	trackingSession->addDevice(medSafeTracker);
+	endStartupPhase("electromagnetic tracker", phaseTimer, startupTime, trackingLog);
+
+	if(!loadTrackerRegistration("TrackerRegistration.txt"))
+		std::cout<<"No Tracker Registration Loaded, the electromagnetic tracker is at the Polaris origin"<<std::endl;
+#endif
+
+	std::cout<<"-Tracker ready in "<<startupTime<<" ms"<<std::endl;
+
+	// an instrument without a tool in the session is never shown nor calibrated
+	for(int i=0; i<NumberOfInstruments; i++)
+	{
+		instrumentTools[i] = trackingSession->getToolIndex(instrumentNames[i]);
+		igstk::TrackerTool * tool = trackingSession->getTrackerTool(instrumentTools[i]);
+		if(tool)
+			std::cout<<"-"<<instrumentNames[i]<<": tool "<<instrumentTools[i]<<", ID "<<tool->GetTrackerToolIdentifier()<<std::endl;
+		else
+			std::cout<<"-"<<instrumentNames[i]<<": not tracked"<<std::endl;
+	}
 
 
 	std::cout<<std::endl;
@@ -101,7 +235,6 @@ void Scene3D::configTracker(std::string referenceToolFilename, std::string ultra
 	validityTimeInMilliseconds = igstk::TimeStamp::GetLongestPossibleTime();
 
 	igstk::Transform::VectorType probeTranslation;
-	igstk::Transform probeTransform;
 	igstk::Transform::VersorType probeRotation;
 
 	probeTranslation[0] = probeCalibrationData[0];
@@ -110,19 +243,8 @@ void Scene3D::configTracker(std::string referenceToolFilename, std::string ultra
     probeRotation.Set(probeCalibrationData[3], probeCalibrationData[4], probeCalibrationData[5], 0.0);
 	probeTransform.SetTranslationAndRotation(probeTranslation, probeRotation, errorValue, validityTimeInMilliseconds);
 
-	igstk::Transform::VectorType needleTranslation;
-	igstk::Transform::VersorType needleRotation;
-	igstk::Transform needleTransform;
-
-	needleTranslation[0] = -22.644;
-	needleTranslation[1] = -84.378;
-	needleTranslation[2] = -66.223;
-	needleRotation.Set(0.0, 0.0, 0.0, 1.0 );
-	needleTransform.SetTranslationAndRotation(needleTranslation, needleRotation, errorValue, validityTimeInMilliseconds );
-
 	igstk::Transform::VectorType pointerTranslation;
 	igstk::Transform::VersorType pointerRotation;
-	igstk::Transform pointerTransform;
 
 	pointerTranslation[0] = -20.049;
 	pointerTranslation[1] = 2.026;
@@ -130,13 +252,16 @@ void Scene3D::configTracker(std::string referenceToolFilename, std::string ultra
 	pointerRotation.Set(0.0, 0.0, 0.0, 1.0 );
 	pointerTransform.SetTranslationAndRotation(pointerTranslation, pointerRotation, errorValue, validityTimeInMilliseconds);
 
-	identityTransform.SetToIdentity(igstk::TimeStamp::GetLongestPossibleTime());
+	// the prediction error is measured at the image origin and at the tips
+	double probeOrigin[3] = {probeTranslation[0], probeTranslation[1], probeTranslation[2]};
+	double pointerTip[3] = {pointerTranslation[0], pointerTranslation[1], pointerTranslation[2]};
+	poseFilters[Probe]->setReferencePoint(probeOrigin);
+	poseFilters[Pointer]->setReferencePoint(pointerTip);
+	for(unsigned int t=0; t<poseFilters.size(); t++)
+		poseFilters[t]->reset();
 
-
-	referenceAxes->RequestSetTransformAndParent(identityTransform, referenceTool);
-	usProbe->RequestSetTransformAndParent(probeTransform, ultrasoundProbeTool);
-	needle->RequestSetTransformAndParent(needleTransform, needleTool);
-	pointer->RequestSetTransformAndParent(pointerTransform, pointerTool);
+	// the objects are placed from the tracking samples, the scene never reads the tracker tools
+	setNeedleTransform();
 
 	scene3DWidget->SetTracker(tracker);
 
@@ -147,7 +272,11 @@ void Scene3D::startTracking()
 {
 	if(configTrackerFlag)
 	{
-		scene3DWidget->View->RequestSetTransformAndParent(identityTransform, referenceTool);
+		std::cout<<"-Starting Tracking"<<std::endl;
+
+		// the scene is rendered by the tracking loop only, the View pulses would render in any thread
+		scene3DWidget->View->RequestStop();
+		scene3DWidget->View->RequestSetTransformAndParent(identityTransform, sceneOrigin);
 		scene3DWidget->View->RequestResetCamera();
 		scene3DWidget->View->SetCameraFocalPoint( 0.0, 290.0 ,150.0 );
 		scene3DWidget->View->SetCameraPosition( 700.0, -150.0 , 150.0 );
@@ -156,57 +285,110 @@ void Scene3D::startTracking()
 		scene3DWidget->View->SetCameraParallelProjection( false );
 		scene3DWidget->View->SetRendererBackgroundColor(185.0/255.0,215.0/255.0,249.0/255.0);
 
-		typedef ::itk::Vector<double, 3>    VectorType;
-		typedef ::itk::Versor<double>       VersorType;
+		// from here each tracker belongs to its acquisition thread, the scene only reads the ring
+		if(!trackingSession->startTracking())
+		{
+			QErrorMessage errorMessage;
+			errorMessage.showMessage("Could not start tracking, </ br> check the tracker connection and the tools");
+			errorMessage.exec();
+			return;
+		}
+
+		PoseRing * ring = trackingSession->getRing();
+		unsigned int pivotCursor = ring->cursor();
+		unsigned int filterCursor = ring->cursor();
+
+		latencyMonitor->reset();
+		double lastSceneTime = -1;
+		QTime summaryTimer;
+		summaryTimer.start();
 
 		std::vector<double> coords;
 		coords.reserve(6);
 
+		TrackingSample sample;
+
 		while( !scene3DWidget->HasQuitted() )
 		{
 			coords.clear();
-			QTest::qWait(0.001);
-			igstk::PulseGenerator::CheckTimeouts();
+			QTest::qWait(10);
 
-			TransformType             usTransform;
-			TransformType             needleTransform;
+			// the pivot calibration uses every needle pose, the display only the newest
+			if (pivotCalibration)
+			{
+				while (pivotCalibration && ring->next(pivotCursor, sample))
+					if (isTracked(sample, Needle))
+						addPivotPose(sample);
+			}
+			else
+			{
+				pivotCursor = ring->cursor();
+			}
+
+			// every pose goes through the motion filters, the display only needs the prediction
+			while (ring->next(filterCursor, sample))
+			{
+				latencyMonitor->addTrackerFrame(sample);
+				for (int i = Reference; i < NumberOfInstruments; i++)
+				{
+					int t = instrumentTools[i];
+					if (isTracked(sample, i))
+						poseFilters[i]->update(sample.toolTime[t], sample.translation[t], sample.rotation[t]);
+				}
+			}
 
-			VectorType                usPosition;
-			VectorType                needlePosition;
+			bool hasSample = ring->latest(sample);
+			bool newSample = hasSample && sample.time != lastSceneTime;
+			if (newSample)
+				lastSceneTime = sample.time;
 
-  
-			coordSystemAObserverReferenceTool->Clear();
-			referenceTool->RequestGetTransformToParent();
-			coordSystemAObserverUltrasoundProbe->Clear();
-			ultrasoundProbeTool->RequestGetTransformToParent();
-			coordSystemAObserverNeedle->Clear();
-			needleTool->RequestGetTransformToParent();
-			coordSystemAObserverPointer->Clear();
-			pointerTool->RequestGetTransformToParent();
+			// the measured poses change with each sample, the predicted poses with the time
+			if (newSample || (hasSample && posePrediction))
+			{
+				showPoses(sample, igstk::RealTimeClock::GetTimeStamp());
 
+				// the objects have their new transforms from here, the next render shows them
+				latencyMonitor->sceneUpdated(sample, igstk::RealTimeClock::GetTimeStamp());
+				scene3DWidget->render();
+			}
 
-			if (coordSystemAObserverReferenceTool->GotTransform())
+			if (summaryTimer.elapsed() > 500)
 			{
-				usTransform = coordSystemAObserverUltrasoundProbe->GetTransform();
-				usPosition = usTransform.GetTranslation();
-				
-				coords.push_back(usPosition[0]);
-				coords.push_back(usPosition[1]);
-				coords.push_back(usPosition[2]);
+				scene3DWidget->setLatencySummary(latencyMonitor->getSummary());
+				if (frameRecorder)
+					scene3DWidget->setRecordingStatus(QString::number(frameRecorder->getRecordedFrames()) +
+						" frames recorded, " + QString::number(frameRecorder->getDroppedFrames()) + " dropped");
+				summaryTimer.restart();
+			}
 
-				needleTransform = coordSystemAObserverNeedle->GetTransform();
-				needlePosition = needleTransform.GetTranslation();
+			if (newSample && isTracked(sample, Reference) && isTracked(sample, Probe) && isTracked(sample, Needle))
+			{
+				int probeIndex = instrumentTools[Probe];
+				coords.push_back(sample.translation[probeIndex][0]);
+				coords.push_back(sample.translation[probeIndex][1]);
+				coords.push_back(sample.translation[probeIndex][2]);
 
-				coords.push_back(needlePosition[0]);
-				coords.push_back(needlePosition[1]);
-				coords.push_back(needlePosition[2]);
+				int needleIndex = instrumentTools[Needle];
+				coords.push_back(sample.translation[needleIndex][0]);
+				coords.push_back(sample.translation[needleIndex][1]);
+				coords.push_back(sample.translation[needleIndex][2]);
 
 				scene3DWidget->setCoords(coords);
 			}
 		}
 
-		tracker->RequestClose();
+		stopRecording();
+		trackingSession->stopTracking();
+
+		if (posePrediction)
+			printPredictionReport();
+
+		for (int d = 0; d < trackingSession->getNumberOfDevices(); d++)
+			trackingSession->getDevice(d)->getIGSTKTracker()->RequestClose();
 		delete scene3DWidget;
+
+		if (trackingLog)
+			trackingLog->close();
 	}
 	else{
 		QErrorMessage errorMessage;
@@ -216,6 +398,17 @@ void Scene3D::startTracking()
 	}
 }
 
+void Scene3D::setCaptureFilename(QString filename)
+{
+	captureFilename = filename;
+}
+
+void Scene3D::setReplaySession(QString filename, double speed)
+{
+	replayFilename = filename;
+	replaySpeed = speed;
+}
+
 void Scene3D::initLogger()
 {
 	if(configTrackerFlag)
@@ -223,13 +416,25 @@ void Scene3D::initLogger()
 		typedef igstk::Object::LoggerType LoggerType;
 
 		LoggerType::Pointer logger = LoggerType::New();
-		itk::StdStreamLogOutput::Pointer fileOutput = itk::StdStreamLogOutput::New();
 
-		std::ofstream ofs( "log.txt" );
-		fileOutput->SetStream(ofs);
-		logger->AddLogOutput( fileOutput );
+		if(trackingLog)
+		{
+			TrackingLogOutput::Pointer trackingLogOutput = TrackingLogOutput::New();
+			trackingLogOutput->SetTrackingLog(trackingLog);
+			logger->AddLogOutput( trackingLogOutput );
+		}
+		else
+		{
+			itk::StdStreamLogOutput::Pointer fileOutput = itk::StdStreamLogOutput::New();
+
+			std::ofstream ofs( "log.txt" );
+			fileOutput->SetStream(ofs);
+			logger->AddLogOutput( fileOutput );
+		}
 
 		scene3DWidget->qtDisplay->SetLogger( logger );
+
+		QMutexLocker deviceLocker(trackingSession->getDevice(0)->getMutex());
 		tracker->SetLogger(logger);
 	}else{
 		QErrorMessage errorMessage;
@@ -247,6 +452,7 @@ void Scene3D::init3DScene()
 
 	scene3DWidget->setScene3D(this);
 
+	sceneOrigin = igstk::AxesObject::New();
     referenceAxes = igstk::AxesObject::New();
 	usProbe = igstk::USProbeObject::New();
     needle = igstk::NeedleObject::New();
@@ -272,16 +478,424 @@ void Scene3D::init3DScene()
 	pointerRepresentation->RequestSetPolarisPointerObject(pointer);
 
 
-	scene3DWidget->View->RequestAddObject(referenceAxesRepresentation);
-	scene3DWidget->View->RequestAddObject(usProbeRepresentation);
-	scene3DWidget->View->RequestAddObject(needleRepresentation);
-	scene3DWidget->View->RequestAddObject(pointerRepresentation);
+	scene3DWidget->addObject(referenceAxesRepresentation);
+	scene3DWidget->addObject(usProbeRepresentation);
+	scene3DWidget->addObject(needleRepresentation);
+	scene3DWidget->addObject(pointerRepresentation);
+
+	identityTransform.SetToIdentity(igstk::TimeStamp::GetLongestPossibleTime());
+	referenceAxes->RequestSetTransformAndParent(identityTransform, sceneOrigin);
 
 	scene3DWidget->qtDisplay->RequestEnableInteractions();
 
 	scene3DWidget->Show();
 
 	configTrackerFlag = false;
+
+	// default needle tip, replaced by the last pivot calibration if it was saved
+	needleTip[0] = -22.644;
+	needleTip[1] = -84.378;
+	needleTip[2] = -66.223;
+
+	pivotCalibration = 0;
+	frameSource = 0;
+	frameRecorder = 0;
+	trackingSession = 0;
+	trackingLog = 0;
+	replaySpeed = 1;
+	needleCalibrationFilename = "NeedleCalibrationParameters.txt";
+
+	// the render window reports when each frame is submitted and presented
+	latencyMonitor = LatencyMonitor::New();
+
+	vtkSmartPointer<vtkCallbackCommand> renderStart = vtkSmartPointer<vtkCallbackCommand>::New();
+	renderStart->SetCallback(renderStartCallback);
+	renderStart->SetClientData(latencyMonitor);
+	scene3DWidget->qtDisplay->GetRenderWindow()->AddObserver(vtkCommand::StartEvent, renderStart);
+
+	vtkSmartPointer<vtkCallbackCommand> renderEnd = vtkSmartPointer<vtkCallbackCommand>::New();
+	renderEnd->SetCallback(renderEndCallback);
+	renderEnd->SetClientData(latencyMonitor);
+	scene3DWidget->qtDisplay->GetRenderWindow()->AddObserver(vtkCommand::EndEvent, renderEnd);
+
+	for(int t=0; t<4; t++)
+		poseFilters.push_back(PoseFilter::New());
+	posePrediction = false;
+	poseFilterFilename = "PoseFilterParameters.txt";
+
+	if(!loadNeedleCalibration(needleCalibrationFilename))
+		std::cout<<"No Needle Calibration Data Loaded, using the default needle tip"<<std::endl;
+
+	if(!loadPoseFilterParameters(poseFilterFilename))
+		std::cout<<"No Pose Filter Parameters Loaded, using the default motion filters"<<std::endl;
+}
+
+void Scene3D::setNeedleTransform()
+{
+	igstk::Transform::VectorType needleTranslation;
+	igstk::Transform::VersorType needleRotation;
+
+	igstk::Transform::ErrorType errorValue;
+	errorValue=10;
+
+	needleTranslation[0] = needleTip[0];
+	needleTranslation[1] = needleTip[1];
+	needleTranslation[2] = needleTip[2];
+	needleRotation.Set(0.0, 0.0, 0.0, 1.0 );
+	needleTransform.SetTranslationAndRotation(needleTranslation, needleRotation, errorValue,
+		igstk::TimeStamp::GetLongestPossibleTime());
+
+	poseFilters[Needle]->setReferencePoint(needleTip);
+}
+
+void Scene3D::setPosePrediction(bool posePrediction)
+{
+	if(this->posePrediction == posePrediction)
+		return;
+
+	this->posePrediction = posePrediction;
+
+	// the tracking loop shows the measured poses from the next sample
+	if(posePrediction || !configTrackerFlag)
+		return;
+
+	printPredictionReport();
+}
+
+bool Scene3D::loadPoseFilterParameters(QString filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QTextStream stream(&file);
+	while (!stream.atEnd())
+	{
+		QStringList lineList = stream.readLine().split(" ", QString::SkipEmptyParts);
+		if (lineList.size() < 5)
+			continue;
+
+		int tool = lineList.at(0).toInt();
+		if (tool < 0 || tool >= (int)poseFilters.size())
+			continue;
+
+		poseFilters[tool]->setProcessNoise(lineList.at(1).toDouble());
+		poseFilters[tool]->setMeasurementNoise(lineList.at(2).toDouble());
+		poseFilters[tool]->setRotationGain(lineList.at(3).toDouble());
+		poseFilters[tool]->setHorizon(lineList.at(4).toDouble());
+
+		std::cout<<"Pose filter of tool "<<tool<<" loaded, display delay "<<lineList.at(4).toDouble()<<" ms"<<std::endl;
+	}
+	file.close();
+
+	return true;
+}
+
+bool Scene3D::exportLatency(QString filename)
+{
+	if(!latencyMonitor->exportCSV(filename))
+	{
+		std::cout<<"Could not open File to save the latency"<<std::endl;
+		return false;
+	}
+
+	std::cout<<"Latency saved in "<<filename.toAscii().data()<<std::endl;
+	return true;
+}
+
+bool Scene3D::startRecording(QStringList imageFilenames)
+{
+	if(!configTrackerFlag)
+	{
+		QErrorMessage errorMessage;
+		errorMessage.showMessage("Tracker is not configure, </ br> please configure tracker first");
+		errorMessage.exec();
+		return false;
+	}
+
+	stopRecording();
+
+	// the images or the synthetic frames stand in for the frame grabber
+	if(imageFilenames.isEmpty())
+		frameSource = new SyntheticFrameSource();
+	else
+		frameSource = new FileFrameSource(imageFilenames);
+
+	QString filename = "Recording_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".frames";
+	frameRecorder = new FrameRecorder(filename, frameSource, trackingSession->getRing());
+	if(!frameRecorder->open())
+	{
+		stopRecording();
+		return false;
+	}
+
+	return true;
+}
+
+void Scene3D::stopRecording()
+{
+	if(frameRecorder)
+		frameRecorder->close();
+
+	delete frameRecorder;
+	frameRecorder = 0;
+	delete frameSource;
+	frameSource = 0;
+}
+
+void Scene3D::printPredictionReport()
+{
+	const char * toolNames[4] = {"Reference", "Ultrasound probe", "Needle", "Pointer"};
+
+	std::cout<<"Pose prediction error at the display time"<<std::endl;
+	for(unsigned int t=0; t<poseFilters.size(); t++)
+	{
+		if(poseFilters[t]->getNumberOfPredictions() == 0)
+			continue;
+
+		std::cout<<"	"<<toolNames[t]<<": "<<poseFilters[t]->getPredictionError()<<" mm RMS predicted, "
+			<<poseFilters[t]->getHoldError()<<" mm RMS without prediction, "
+			<<poseFilters[t]->getNumberOfPredictions()<<" frames "
+			<<poseFilters[t]->getHorizon()<<" ms ahead"<<std::endl;
+	}
+}
+
+bool Scene3D::isTracked(const TrackingSample & sample, int instrument)
+{
+	int tool = instrumentTools[instrument];
+	return tool >= 0 && tool < sample.numberOfTools && sample.valid[tool];
+}
+
+void Scene3D::showPoses(const TrackingSample & sample, double now)
+{
+	setToolTransform(Probe, usProbe, probeTransform, sample, now);
+	setToolTransform(Needle, needle, needleTransform, sample, now);
+	setToolTransform(Pointer, pointer, pointerTransform, sample, now);
+}
+
+void Scene3D::setToolTransform(int instrument, igstk::SpatialObject * object, const igstk::Transform & objectTransform,
+							   const TrackingSample & sample, double now)
+{
+	// the scene is in the reference coordinates, the objects expire while the reference is not seen
+	if(!isTracked(sample, Reference))
+		return;
+	int reference = instrumentTools[Reference];
+
+	double translation[3];
+	double rotation[9];
+	double referenceTranslation[3];
+	double referenceRotation[9];
+	if(posePrediction)
+	{
+		// the reference is predicted at the same display time as the tool, its motion is not an error
+		double displayTime = now + poseFilters[instrument]->getHorizon();
+		if(!poseFilters[instrument]->predict(displayTime, translation, rotation) ||
+		   !poseFilters[Reference]->predict(displayTime, referenceTranslation, referenceRotation))
+			return;
+	}
+	else
+	{
+		if(!isTracked(sample, instrument))
+			return;
+
+		int tool = instrumentTools[instrument];
+		for(int i=0; i<3; i++)
+		{
+			translation[i] = sample.translation[tool][i];
+			referenceTranslation[i] = sample.translation[reference][i];
+		}
+		for(int i=0; i<9; i++)
+		{
+			rotation[i] = sample.rotation[tool][i];
+			referenceRotation[i] = sample.rotation[reference][i];
+		}
+	}
+
+	// the tool pose in the reference coordinates, the inverse of the reference pose composed with it
+	igstk::Transform::VersorType::MatrixType toolRotation;
+	igstk::Transform::VectorType toolTranslation;
+	for(int i=0; i<3; i++)
+	{
+		toolTranslation[i] = 0;
+		for(int k=0; k<3; k++)
+			toolTranslation[i] += referenceRotation[3*k + i]*(translation[k] - referenceTranslation[k]);
+
+		for(int j=0; j<3; j++)
+		{
+			toolRotation(i,j) = 0;
+			for(int k=0; k<3; k++)
+				toolRotation(i,j) += referenceRotation[3*k + i]*rotation[3*k + j];
+		}
+	}
+
+	// the object transform in the tool composed with the tool pose
+	igstk::Transform::VersorType::MatrixType objectRotation = toolRotation*objectTransform.GetRotation().GetMatrix();
+	igstk::Transform::VectorType objectTranslation = toolRotation*objectTransform.GetTranslation() + toolTranslation;
+
+	igstk::Transform::VersorType versor;
+	versor.Set(objectRotation);
+
+	// the transform expires like the tracker transforms if the tool is lost
+	igstk::Transform toolTransform;
+	toolTransform.SetTranslationAndRotation(objectTranslation, versor, objectTransform.GetError(), 100);
+
+	object->RequestSetTransformAndParent(toolTransform, sceneOrigin);
+}
+
+bool Scene3D::loadNeedleCalibration(QString filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QTextStream stream(&file);
+	double tip[3];
+
+	for(int i=0;i<3;i++)
+	{
+		bool ok = false;
+		tip[i] = stream.readLine().toDouble(&ok);
+		if(!ok)
+		{
+			std::cout<<"Invalid Needle Calibration File "<<filename.toAscii().data()<<std::endl;
+			return false;
+		}
+	}
+	file.close();
+
+	needleTip[0] = tip[0];
+	needleTip[1] = tip[1];
+	needleTip[2] = tip[2];
+
+	std::cout<<"Needle tip loaded: "<<tip[0]<<", "<<tip[1]<<", "<<tip[2]<<std::endl;
+
+	return true;
+}
+
+bool Scene3D::loadTrackerRegistration(QString filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QStringList values = QString(file.readAll()).split(QRegExp("\\s+"), QString::SkipEmptyParts);
+	file.close();
+
+	if (values.size() < 12 || trackingSession->getNumberOfDevices() < 2)
+	{
+		std::cout<<"Invalid Tracker Registration File "<<filename.toAscii().data()<<std::endl;
+		return false;
+	}
+
+	double rotation[9];
+	double translation[3];
+	for(int i=0; i<9; i++)
+		rotation[i] = values.at(i).toDouble();
+	for(int i=0; i<3; i++)
+		translation[i] = values.at(9 + i).toDouble();
+
+	trackingSession->setRegistration(1, rotation, translation);
+
+	std::cout<<"Tracker registration loaded, translation: "<<translation[0]<<", "<<translation[1]<<", "
+		<<translation[2]<<std::endl;
+
+	return true;
+}
+
+bool Scene3D::saveNeedleCalibration(QString filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	{
+		std::cout<<"Could not open File to save the needle calibration"<<std::endl;
+		return false;
+	}
+
+	QTextStream out(&file);
+	out.setRealNumberPrecision(10);
+	out<<needleTip[0]<<"\n"<<needleTip[1]<<"\n"<<needleTip[2]<<"\n";
+	file.close();
+
+	return true;
+}
+
+void Scene3D::startPivotCalibration()
+{
+	delete pivotCalibration;
+	pivotCalibration = PivotCalibration::New();
+
+	lastPivotTime = 0;
+	lastPivotTip.set_size(3);
+	lastPivotTip.fill(1e300);
+
+	std::cout<<"Pivot calibration started, pivot the needle about its tip"<<std::endl;
+}
+
+void Scene3D::stopPivotCalibration()
+{
+	if(!pivotCalibration)
+		return;
+
+	if(pivotCalibration->isWellConditioned() && pivotCalibration->getNumberOfInliers() > 0)
+	{
+		vnl_vector<double> tip = pivotCalibration->getTip();
+		needleTip[0] = tip[0];
+		needleTip[1] = tip[1];
+		needleTip[2] = tip[2];
+
+		std::cout<<"Needle tip: "<<tip[0]<<", "<<tip[1]<<", "<<tip[2]<<" RMS: "<<pivotCalibration->getRMS()
+			<<" mm with "<<pivotCalibration->getNumberOfInliers()<<" of "<<pivotCalibration->getNumberOfPoses()
+			<<" poses"<<std::endl;
+
+		setNeedleTransform();
+		if(saveNeedleCalibration(needleCalibrationFilename))
+			std::cout<<"Needle calibration saved in "<<needleCalibrationFilename.toAscii().data()<<std::endl;
+	}
+	else
+	{
+		std::cout<<"Pivot calibration cancelled, the needle was not pivoted enough"<<std::endl;
+	}
+
+	delete pivotCalibration;
+	pivotCalibration = 0;
+
+	scene3DWidget->pivotCalibrationFinished();
+}
+
+void Scene3D::addPivotPose(const TrackingSample & sample)
+{
+	int tool = instrumentTools[Needle];
+
+	// the samples repeat the needle pose when only the other tools were updated
+	if(sample.toolTime[tool] == lastPivotTime)
+		return;
+	lastPivotTime = sample.toolTime[tool];
+
+	vnl_matrix<double> rotation(3,3);
+	vnl_vector<double> translation(3);
+	for(int i=0; i<3; i++)
+	{
+		for(int j=0; j<3; j++)
+			rotation(i,j) = sample.rotation[tool][3*i + j];
+		translation[i] = sample.translation[tool][i];
+	}
+
+	if(!pivotCalibration->addPose(rotation, translation))
+		return;
+
+	int poses = pivotCalibration->getNumberOfPoses();
+	scene3DWidget->setPivotCalibration(pivotCalibration->getTip(), pivotCalibration->getRMS(),
+		pivotCalibration->getNumberOfInliers(), poses);
+
+	// finished when the tip moves less than 0.05 mm in 100 poses
+	if(poses%100 == 0 && pivotCalibration->isWellConditioned())
+	{
+		bool converged = (pivotCalibration->getTip() - lastPivotTip).magnitude() < 0.05;
+		lastPivotTip = pivotCalibration->getTip();
+
+		if(converged)
+			stopPivotCalibration();
+	}
 }
 
 void Scene3D::addVolumeToScene(std::string volumeFilename)
@@ -319,7 +933,7 @@ void Scene3D::addVolumeToScene(std::string volumeFilename)
 	usVolumeRotation.Set(0.0, 0.0, 0.0, 1.0 );
 	usVolumeTransform.SetTranslationAndRotation(usVolumeTranslation, usVolumeRotation, errorValue, validityTimeInMilliseconds);
 
-	scene3DWidget->View->RequestAddObject(usVolumeRepresentation);
-	usVolume->RequestSetTransformAndParent(usVolumeTransform, referenceTool);
+	scene3DWidget->addObject(usVolumeRepresentation);
+	usVolume->RequestSetTransformAndParent(usVolumeTransform, sceneOrigin);
 
 }
@@ -3,8 +3,10 @@
 
 #include <iostream>
 
-#include "igstkPolarisTracker.h"
-#include "igstkPolarisTrackerTool.h"
+#include <QStringList>
+
+#include "igstkTracker.h"
+#include "igstkTrackerTool.h"
 
 #include "igstkTransformObserver.h"
 
@@ -15,9 +17,19 @@
 #include "igstkUSImageObject.h"
 
 #include "Scene3DWidget.h"
+#include "PivotCalibration.h"
+#include "PoseRing.h"
+#include "PoseFilter.h"
+#include "LatencyMonitor.h"
 
 using namespace  std;
 
+class PolarisTracker;
+class TrackingSession;
+class TrackingLog;
+class FrameSource;
+class FrameRecorder;
+
 //!3D sCene
 /*!
   This class has the main objects and configuration to create a virtual representation of  a needle biopsy.
@@ -27,7 +39,7 @@ class Scene3D
 
 public:
 
-	typedef igstk::PolarisTrackerTool         TrackerToolType;
+	typedef igstk::TrackerTool                TrackerToolType;
 	typedef TrackerToolType::TransformType    TransformType;
 	typedef igstk::TransformObserver          ObserverType;
 
@@ -40,44 +52,126 @@ public:
 	/** \brief Initialize the 3D scene, creates all the scene objects*/
     void init3DScene();
 
-	/** \brief Configure the Polaris tracker
+	/** \brief Configure the Polaris tracker, and the Ascension 3DG needle sensor if it is built
 	* \param[in] ROM files*/
 	void configTracker(std::string, std::string, std::string, std::string, QString);
 	
 	/** \brief Start Tracking*/
 	void startTracking();
 
+	/** \brief Replay a recorded serial stream instead of the Polaris in the next configTracker()
+	* \param[in] stream file recorded by PolarisTracker and replay speed, 1 is real time*/
+	void setReplaySession(QString, double);
+
+	/** \brief Record the serial stream of the Polaris in the next configTracker(), for a replay
+	* \param[in] stream file, empty to not record*/
+	void setCaptureFilename(QString);
+
 	/** \brief Initialize the tracker logger*/
 	void initLogger();
 
 	/** \brief Add an ultrasound volume to the scene*/
 	void addVolumeToScene(std::string);
 
+	/** \brief Start the needle pivot calibration, the poses are added while tracking*/
+	void startPivotCalibration();
+
+	/** \brief Stop the needle pivot calibration, use and save the tip if it was estimated*/
+	void stopPivotCalibration();
+
+	/** \brief Load the needle tip in the tool coordinates
+	* \param[in] file with the x, y and z of the tip in one line each*/
+	bool loadNeedleCalibration(QString);
+
+	/** \brief Save the needle tip in the tool coordinates*/
+	bool saveNeedleCalibration(QString);
+
+	/** \brief Load the pose of the electromagnetic tracker in the Polaris coordinates
+	* \param[in] file with the rotation matrix row major and the translation, 12 numbers*/
+	bool loadTrackerRegistration(QString);
+
+	/** \brief Show the instruments where the motion filters predict them at the display time
+	* \param[in] true to predict, false to show the last measured poses*/
+	void setPosePrediction(bool);
+
+	/** \brief Load the motion filter parameters of the tools
+	* \param[in] file with one line per tool: tool number, acceleration noise in mm/s^2,
+	* position noise in mm, rotation gain and display delay in ms*/
+	bool loadPoseFilterParameters(QString);
+
+	/** \brief Print the prediction error of each tool, with and without prediction*/
+	void printPredictionReport();
+
+	/** \brief Save the time of each stage of the displayed frames and the latency histograms
+	* \param[in] CSV file*/
+	bool exportLatency(QString);
+
+	/** \brief Start recording the ultrasound frames with the tracker poses in a new file
+	* \param[in] image files played as the frames, synthetic frames if it is empty*/
+	bool startRecording(QStringList);
+
+	/** \brief Stop recording, the buffered frames and the frame index are written*/
+	void stopRecording();
+
 private:
 
+	/** \brief Set the needle object transform in the needle tool to the needle tip*/
+	void setNeedleTransform();
+
+	/** \brief Add the needle pose of a tracking sample to the pivot calibration*/
+	void addPivotPose(const TrackingSample &);
+
+	/** \brief Returns true if a sample has a valid pose of an instrument, false if it has no tool*/
+	bool isTracked(const TrackingSample &, int);
+
+	/** \brief Place the instruments at the poses of a sample, or predicted for the display time with the
+	* reference predicted at the same time
+	* \param[in] newest sample and current time*/
+	void showPoses(const TrackingSample &, double);
+
+	/** \brief Place an object at the pose of its tool in the reference coordinates
+	* \param[in] instrument, object, object transform in the tool, newest sample and current time*/
+	void setToolTransform(int, igstk::SpatialObject *, const igstk::Transform &, const TrackingSample &, double);
+
+	/** Instruments of the scene, their tools are found by name in the tracking session */
+	enum Instrument { Reference, Probe, Needle, Pointer, NumberOfInstruments };
+
 	bool configTrackerFlag; ///<Indicates of the tracker is configure
 	TransformType identityTransform; ///<Transformation for the tracked objects
+	TransformType probeTransform; ///<Ultrasound image in the probe tool coordinates
+	TransformType needleTransform; ///<Needle tip in the needle tool coordinates
+	TransformType pointerTransform; ///<Pointer tip in the pointer tool coordinates
 
+	igstk::AxesObject::Pointer   sceneOrigin; ///<Reference coordinates, the parent of the View and the objects
 	igstk::AxesObject::Pointer   referenceAxes; ///<Refrence axes object
 	igstk::USProbeObject::Pointer usProbe; ///<Ultrasound Probe object
     igstk::NeedleObject::Pointer needle; ///<Biopsy needle object
 	igstk::PolarisPointerObject::Pointer pointer; ///<Polaris pointer object
 	igstk::USImageObject::Pointer usVolume; ///<Ultrasound volume object
 
-	TrackerToolType::Pointer referenceTool; ///<Tool for the reference axes
-	TrackerToolType::Pointer ultrasoundProbeTool; ///<Tool to track the us probe
-	TrackerToolType::Pointer needleTool; ///<Tool to track the biopsy needle
-	TrackerToolType::Pointer pointerTool; ///<Tool to track the polaris pointer
-
-	igstk::PolarisTracker::Pointer tracker; ///<Tracker object
-
-	ObserverType::Pointer coordSystemAObserverReferenceTool; ///<Oberver for the reference tool events
-	ObserverType::Pointer coordSystemAObserverUltrasoundProbe; ///<Oberver for the ultrasound probe events
-	ObserverType::Pointer coordSystemAObserverNeedle; ///<Oberver for the needle events
-	ObserverType::Pointer coordSystemAObserverPointer; ///<Oberver for the ponter events
+	igstk::Tracker::Pointer tracker; ///<Polaris tracker object, the coordinates of the scene
+	PolarisTracker * polarisTracker; ///<Polaris configuration
+	TrackingSession * trackingSession; ///<Devices of the session, starts and stops tracking
+	int instrumentTools[NumberOfInstruments]; ///<Number of the tool of each instrument in the samples
+	TrackingLog * trackingLog; ///<Binary log of the tracking session, NULL if it could not be created
 
 	Scene3DWidget * scene3DWidget; ///<User inteface
 
+	double needleTip[3]; ///<Needle tip in the needle tool coordinates
+	QString needleCalibrationFilename; ///<File with the needle tip, loaded at startup
+	QString replayFilename; ///<Recorded serial stream to replay, empty to use the Polaris
+	double replaySpeed; ///<Replay speed, 1 is real time
+	QString captureFilename; ///<File to record the serial stream, empty to not record
+	PivotCalibration * pivotCalibration; ///<Needle pivot calibration, NULL if not calibrating
+	double lastPivotTime; ///<Time of the last needle pose added to the pivot calibration
+	vnl_vector<double> lastPivotTip; ///<Tip estimate at the last convergence check
+	std::vector<PoseFilter *> poseFilters; ///<Motion filter of each instrument
+	bool posePrediction; ///<The instruments are shown at the predicted poses
+	QString poseFilterFilename; ///<File with the motion filter parameters, loaded at startup
+	LatencyMonitor * latencyMonitor; ///<Latency and rate of the tracking and the display
+	FrameSource * frameSource; ///<Ultrasound frames of the recording
+	FrameRecorder * frameRecorder; ///<Frame and pose recording, NULL if not recording
+
 
 };
 #endif // SCENE3D_H
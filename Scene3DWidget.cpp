@@ -7,6 +7,8 @@
 #include <QMainWindow>
 #include <QtGui>
 
+#include "vtkRenderWindow.h"
+
 Scene3DWidget::Scene3DWidget(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::Scene3DWidget)
@@ -25,6 +27,11 @@ Scene3DWidget::Scene3DWidget(QWidget *parent) :
 
 	ui->initLoggetBt->setEnabled(false);
 	ui->startTrackingBt->setEnabled(false);
+	ui->pivotBt->setEnabled(false);
+
+	// the overlay is shown with the latency check box
+	ui->latencyLabel->raise();
+	ui->latencyLabel->setVisible(false);
 
     this->quit =  false;
 }
@@ -41,17 +48,36 @@ void Scene3DWidget::Show()
     this->View->RequestStart();
 }
 
+void Scene3DWidget::addObject(igstk::ObjectRepresentation * representation)
+{
+	this->View->RequestAddObject(representation);
+	representations.push_back(representation);
+}
+
+void Scene3DWidget::render()
+{
+	// what the View does on each pulse, the pulses would run in any thread that dispatches them
+	igstk::TimeStamp renderTime;
+	renderTime.SetStartTimeNowAndExpireAfter(0);
+
+	const igstk::CoordinateSystem * viewCoordinates =
+		igstk::Friends::CoordinateSystemHelper::GetCoordinateSystem(this->View.GetPointer());
+	for(unsigned int i = 0; i < representations.size(); i++)
+		representations[i]->RequestUpdateRepresentation(renderTime, viewCoordinates);
+
+	this->qtDisplay->GetRenderWindow()->Render();
+}
+
 void Scene3DWidget::Quit()
 {
+	// tracking is stopped by the acquisition thread when the tracking loop ends
     this->View->RequestStop();
-	this->m_Tracker->RequestStopTracking();
     this->quit = true;
     this->hide();
 }
 
 void Scene3DWidget::startTracking()
 {
-    this->m_Tracker->RequestStartTracking();
 	scene3D->startTracking();
 }
 
@@ -68,6 +94,13 @@ void Scene3DWidget::configTracker()
 	QString probeCalibrationFilename = QFileDialog::getOpenFileName(this, tr("Open Probe Calibration File"),
         QDir::currentPath(),tr("Text (*.txt)"));
 
+	// the capture writes every serial reply, it is only on when the session is recorded for a replay
+	QString captureFilename;
+	if(ui->captureCheckBox->isChecked())
+		captureFilename = QFileDialog::getSaveFileName(this, tr("Save Serial Stream"),
+			QDir::currentPath(), tr("Text (*.txt)"));
+	scene3D->setCaptureFilename(captureFilename);
+
     std::string referenceToolFilename = std::string(qtReferenceToolFilename.toAscii().data());
     std::string ultrasoundProbeFilename = std::string(qtUltrasoundProbeFilename.toAscii().data());
     std::string needleFilename = std::string(qtNeedleFilename.toAscii().data());
@@ -78,6 +111,100 @@ void Scene3DWidget::configTracker()
 
 	ui->initLoggetBt->setEnabled(true);
 	ui->startTrackingBt->setEnabled(true);
+	ui->pivotBt->setEnabled(true);
+}
+
+void Scene3DWidget::pivotCalibration(bool checked)
+{
+	if(checked)
+	{
+		ui->pivotLabel->setText("Pivot the needle about its tip");
+		scene3D->startPivotCalibration();
+	}
+	else
+	{
+		scene3D->stopPivotCalibration();
+	}
+}
+
+void Scene3DWidget::posePrediction(bool checked)
+{
+	scene3D->setPosePrediction(checked);
+}
+
+void Scene3DWidget::setLatencySummary(QString summary)
+{
+	ui->latencyLabel->setText(summary);
+}
+
+void Scene3DWidget::exportLatency()
+{
+	QString filename = QFileDialog::getSaveFileName(this, tr("Save Latency"),
+        QDir::currentPath(),tr("CSV (*.csv)"));
+	if(filename.isEmpty())
+		return;
+
+	scene3D->exportLatency(filename);
+}
+
+void Scene3DWidget::recordFrames(bool checked)
+{
+	if(!checked)
+	{
+		scene3D->stopRecording();
+		return;
+	}
+
+	// without images the recording uses synthetic frames
+	QStringList imageFilenames = QFileDialog::getOpenFileNames(this, tr("Open Frames to Play as the Ultrasound"),
+		QDir::currentPath(), tr("Image Files (*.png *.jpg *.bmp)"));
+
+	if(scene3D->startRecording(imageFilenames))
+	{
+		ui->recordLabel->setText("Recording");
+		return;
+	}
+
+	ui->recordBt->blockSignals(true);
+	ui->recordBt->setChecked(false);
+	ui->recordBt->blockSignals(false);
+}
+
+void Scene3DWidget::setRecordingStatus(QString status)
+{
+	ui->recordLabel->setText(status);
+}
+
+void Scene3DWidget::pivotCalibrationFinished()
+{
+	ui->pivotBt->blockSignals(true);
+	ui->pivotBt->setChecked(false);
+	ui->pivotBt->blockSignals(false);
+}
+
+void Scene3DWidget::setPivotCalibration(vnl_vector<double> tip, double rms, int inliers, int poses)
+{
+	ui->pivotLabel->setText("Tip: " + QString::number(tip[0], 'f', 2) + ", " + QString::number(tip[1], 'f', 2) +
+		", " + QString::number(tip[2], 'f', 2) + "\nRMS: " + QString::number(rms, 'f', 3) + " mm\nPoses: " +
+		QString::number(inliers) + " of " + QString::number(poses));
+}
+
+void Scene3DWidget::replaySession()
+{
+	QString streamFilename = QFileDialog::getOpenFileName(this, tr("Open Recorded Serial Stream"),
+        QDir::currentPath(),tr("Text (*.txt)"));
+	if(streamFilename.isEmpty())
+		return;
+
+	bool ok = false;
+	double speed = QInputDialog::getDouble(this, tr("Replay Session"), tr("Replay speed (1 is real time)"),
+		1.0, 0.1, 1.0, 1, &ok);
+	if(!ok)
+		return;
+
+	// the rom files must be selected in the same order as in the recorded session
+	scene3D->setReplaySession(streamFilename, speed);
+	configTracker();
 }
 
 void Scene3DWidget::openVolume()
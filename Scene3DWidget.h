@@ -5,7 +5,11 @@
 #include "igstkView3D.h"
 #include "igstkQTWidget.h"
 #include "igstkTracker.h"
+#include "igstkObjectRepresentation.h"
 #include "igstkConfigure.h"
+
+#include <vnl/vnl_vector.h>
+#include <vector>
 //
 
 class Scene3D;
@@ -37,6 +41,13 @@ public:
 	/** \brief Show the widget nd start displaying the scene*/
     void Show();
 
+	/** \brief Add an object representation to the View, it is updated by render()*/
+	void addObject(igstk::ObjectRepresentation *);
+
+	/** \brief Update the representations to their objects and render the scene in this thread
+	* While tracking the View pulses are stopped, the scene is only rendered by this function*/
+	void render();
+
 	/** \brief Returns the quit flag*/
 	bool HasQuitted();
 
@@ -50,12 +61,26 @@ public:
 	/** \brief Set the instruments coords in the widget*/
 	void setCoords(std::vector<double>);
 
+	/** \brief Show the needle tip estimated by the pivot calibration
+	* \param[in] tip, RMS in mm, inlier poses and poses*/
+	void setPivotCalibration(vnl_vector<double>, double, int, int);
+
+	/** \brief Release the pivot calibration button when the calibration finished*/
+	void pivotCalibrationFinished();
+
+	/** \brief Show the tracker and render rates and the latency over the scene*/
+	void setLatencySummary(QString);
+
+	/** \brief Show the frames recorded and dropped*/
+	void setRecordingStatus(QString);
+
 private:
 
     Ui::Scene3DWidget *ui; ///<The User Interface
     bool quit; ///<Quit Flag
     TrackerPointer m_Tracker; ///<Polaris Tracker
 	Scene3D* scene3D; ///<Scene3D object with the IGSTK objects
+	std::vector<igstk::ObjectRepresentation::Pointer> representations; ///<Representations added to the View
 
 private slots:
 
@@ -68,11 +93,26 @@ private slots:
 	/** \brief Config the polaris tracker*/
 	void configTracker();
 
+	/** \brief Config the tracker to replay a recorded serial stream*/
+	void replaySession();
+
 	/** \brief Init the tracker logger*/
 	void initLogger();
 
 	/** \brief Open ultrasound volume*/
 	void openVolume();
+
+	/** \brief Start or stop the needle pivot calibration*/
+	void pivotCalibration(bool);
+
+	/** \brief Show the instruments at the poses predicted for the display time*/
+	void posePrediction(bool);
+
+	/** \brief Save the latency of the displayed frames in a CSV file*/
+	void exportLatency();
+
+	/** \brief Start or stop recording the ultrasound frames with the tracker poses*/
+	void recordFrames(bool);
 };
 
 #endif // SCENE3DWIDGET_H
@@ -5,25 +5,63 @@
 
 SphereFunction::SphereFunction(vnl_matrix<double> * points)
     : vnl_least_squares_function(4, points->rows(),
-                                vnl_least_squares_function::no_gradient)
+                                vnl_least_squares_function::use_gradient)
 {
-    this->_data = points;
+    // the coordinates are stored by axis so the residual loops are contiguous
+    int nPoints = points->rows();
+    this->_x.resize(nPoints);
+    this->_y.resize(nPoints);
+    this->_z.resize(nPoints);
+
+    for(int i=0; i<nPoints; i++){
+        this->_x[i] = (*points)(i,0);
+        this->_y[i] = (*points)(i,1);
+        this->_z[i] = (*points)(i,2);
+    }
 }
 
 SphereFunction::~SphereFunction(){}
 
 void SphereFunction::f(const vnl_vector<double> &x, vnl_vector<double> &fx)
 {
-    double xh = x[0];
-    double yh = x[1];
-    double zh = x[2];
-    double r = x[3];
+    const double xh = x[0];
+    const double yh = x[1];
+    const double zh = x[2];
+    const double r2 = x[3]*x[3];
 
-    for(int i=0; i< _data->rows(); i++){
-		
-		vnl_vector<double> point = _data->get_row(i);
-		fx[i] = pow(point[0] - xh,2) + pow(point[1] - yh,2) + pow(point[2] - zh,2) - pow(r,2);
+    const int nPoints = _x.size();
+    const double * px = &_x[0];
+    const double * py = &_y[0];
+    const double * pz = &_z[0];
+    double * residuals = fx.data_block();
 
+    for(int i=0; i<nPoints; i++){
+        const double dx = px[i] - xh;
+        const double dy = py[i] - yh;
+        const double dz = pz[i] - zh;
+        residuals[i] = dx*dx + dy*dy + dz*dz - r2;
     }
 }
 
+void SphereFunction::gradf(const vnl_vector<double> &x, vnl_matrix<double> &J)
+{
+    const double xh = x[0];
+    const double yh = x[1];
+    const double zh = x[2];
+    const double dr = -2*x[3];
+
+    const int nPoints = _x.size();
+    const double * px = &_x[0];
+    const double * py = &_y[0];
+    const double * pz = &_z[0];
+
+    // J is row major, 4 columns for each point
+    double * row = J.data_block();
+
+    for(int i=0; i<nPoints; i++, row+=4){
+        row[0] = -2*(px[i] - xh);
+        row[1] = -2*(py[i] - yh);
+        row[2] = -2*(pz[i] - zh);
+        row[3] = dr;
+    }
+}
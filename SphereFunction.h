@@ -27,10 +27,15 @@ public:
 	/** \brief The general equation of a sphere */
     virtual void f(vnl_vector<double> const &p, vnl_vector<double> &fx);
 
+	/** \brief Analytic jacobian of the general equation of a sphere */
+    virtual void gradf(vnl_vector<double> const &p, vnl_matrix<double> &J);
+
 private:
 
-	/** \brief Surface Points */
-    vnl_matrix<double> * _data;
+	/** \brief Surface Points coordinates, one array for each axis */
+    std::vector<double> _x;
+    std::vector<double> _y;
+    std::vector<double> _z;
 
 };
 
@@ -0,0 +1,314 @@
+#include "SphereSegmentation.h"
+#include "GaussianFilter.h"
+
+#include <vtkMath.h>
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+
+/** Segments the sphere in one image of the stack */
+class SphereSegmentationTask : public QRunnable
+{
+public:
+
+	SphereSegmentationTask(SphereSegmentation *segmentation, vtkImageData *image,
+						   vtkPoints *outline, SphereSegmentation::Circle *circle)
+		: segmentation(segmentation), image(image), outline(outline), circle(circle)
+	{
+	}
+
+	void run()
+	{
+		*circle = segmentation->segmentImage(image, outline);
+	}
+
+private:
+
+	SphereSegmentation *segmentation;
+	vtkImageData *image;
+	vtkPoints *outline;
+	SphereSegmentation::Circle *circle;
+};
+
+/** An edge pixel and its unit gradient */
+struct EdgePixel
+{
+	int x;
+	int y;
+	double gx;
+	double gy;
+};
+
+/** Algebraic circle fit x^2+y^2 = 2ax + 2by + c of the selected edges */
+static bool fitCircle(const std::vector<EdgePixel> &edges, const std::vector<int> &selected,
+					  double &x, double &y, double &radius)
+{
+	if(selected.size() < 3)
+		return false;
+
+	// normal equations of a 3x3 system solved by Cramer's rule
+	double a[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+	double b[3] = {0,0,0};
+
+	for(unsigned int k=0; k<selected.size(); k++){
+		const EdgePixel &edge = edges[selected[k]];
+		double row[3] = {2.0*edge.x, 2.0*edge.y, 1};
+		double rhs = (double)edge.x*edge.x + (double)edge.y*edge.y;
+		for(int r=0; r<3; r++){
+			for(int c=0; c<3; c++)
+				a[r][c] += row[r]*row[c];
+			b[r] += row[r]*rhs;
+		}
+	}
+
+	double det = vtkMath::Determinant3x3(a[0], a[1], a[2]);
+	if(fabs(det) < 1e-9)
+		return false;
+
+	double solution[3];
+	for(int c=0; c<3; c++){
+		double m[3][3];
+		for(int r=0; r<3; r++)
+			for(int k=0; k<3; k++)
+				m[r][k] = k == c ? b[r] : a[r][k];
+		solution[c] = vtkMath::Determinant3x3(m[0], m[1], m[2])/det;
+	}
+
+	double r2 = solution[2] + solution[0]*solution[0] + solution[1]*solution[1];
+	if(r2 <= 0)
+		return false;
+
+	x = solution[0];
+	y = solution[1];
+	radius = sqrt(r2);
+
+	return true;
+}
+
+SphereSegmentation::SphereSegmentation()
+{
+	minimumRadius = 5;
+	maximumRadius = 100;
+	sigma = 1.5;
+	numberOfThreads = QThread::idealThreadCount();
+}
+
+void SphereSegmentation::segment()
+{
+	std::cout<<"Segmenting the sphere in "<<imageStack.size()<<" images"<<std::endl;
+
+	circles.assign(imageStack.size(), Circle());
+	outlines.clear();
+
+	for(unsigned int i=0; i<imageStack.size(); i++)
+		outlines.push_back(vtkSmartPointer<vtkPoints>::New());
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(numberOfThreads);
+
+	for(unsigned int i=0; i<imageStack.size(); i++)
+		pool.start(new SphereSegmentationTask(this, imageStack.at(i), outlines.at(i), &circles.at(i)));
+
+	pool.waitForDone();
+
+	for(unsigned int i=0; i<imageStack.size(); i++)
+		if(!circles.at(i).found)
+			outlines.at(i) = NULL;
+}
+
+SphereSegmentation::Circle SphereSegmentation::segmentImage(vtkImageData *image, vtkPoints *outline)
+{
+	Circle circle;
+	circle.found = false;
+	circle.x = 0;
+	circle.y = 0;
+	circle.radius = 0;
+	circle.coverage = 0;
+
+	int *extent = image->GetExtent();
+	int width = extent[1] - extent[0] + 1;
+	int height = extent[3] - extent[2] + 1;
+
+	if(width < 8 || height < 8)
+		return circle;
+
+	std::vector<float> buffer(width*height);
+	for(int j=0; j<height; j++)
+		for(int i=0; i<width; i++)
+			buffer[j*width + i] = image->GetScalarComponentAsDouble(extent[0] + i, extent[2] + j, extent[4], 0);
+
+	GaussianFilter::smooth(buffer, width, height, sigma);
+
+	// sobel gradient, the edges are the pixels with a strong gradient
+	std::vector<float> magnitude(width*height, 0);
+	double mean = 0, meanSquares = 0;
+
+	for(int j=1; j<height - 1; j++){
+		for(int i=1; i<width - 1; i++){
+			int idx = j*width + i;
+			double gx = buffer[idx - width + 1] + 2*buffer[idx + 1] + buffer[idx + width + 1]
+					  - buffer[idx - width - 1] - 2*buffer[idx - 1] - buffer[idx + width - 1];
+			double gy = buffer[idx + width - 1] + 2*buffer[idx + width] + buffer[idx + width + 1]
+					  - buffer[idx - width - 1] - 2*buffer[idx - width] - buffer[idx - width + 1];
+			magnitude[idx] = sqrt(gx*gx + gy*gy);
+			mean += magnitude[idx];
+			meanSquares += magnitude[idx]*magnitude[idx];
+		}
+	}
+
+	mean /= width*height;
+	double threshold = mean + 2*sqrt(std::max(0.0, meanSquares/(width*height) - mean*mean));
+
+	std::vector<EdgePixel> edges;
+	for(int j=1; j<height - 1; j++){
+		for(int i=1; i<width - 1; i++){
+			int idx = j*width + i;
+			if(magnitude[idx] <= threshold)
+				continue;
+
+			// only the local maxima across the edge are kept
+			double gx = (buffer[idx + 1] - buffer[idx - 1])/2;
+			double gy = (buffer[idx + width] - buffer[idx - width])/2;
+			double norm = sqrt(gx*gx + gy*gy);
+			if(norm <= 0)
+				continue;
+
+			int di = vtkMath::Round(gx/norm);
+			int dj = vtkMath::Round(gy/norm);
+			if(magnitude[idx] < magnitude[idx + dj*width + di] || magnitude[idx] < magnitude[idx - dj*width - di])
+				continue;
+
+			EdgePixel edge;
+			edge.x = i;
+			edge.y = j;
+			edge.gx = gx/norm;
+			edge.gy = gy/norm;
+			edges.push_back(edge);
+		}
+	}
+
+	if(edges.size() < 10)
+		return circle;
+
+	// each edge votes for the centers along its gradient, both sides as the sphere can be brighter or darker
+	std::vector<float> centers(width*height, 0);
+	int radiusSteps = (int)(maximumRadius - minimumRadius) + 1;
+
+	for(unsigned int e=0; e<edges.size(); e++){
+		for(int s=-1; s<=1; s+=2){
+			for(int r=0; r<radiusSteps; r++){
+				double distance = s*(minimumRadius + r);
+				int cx = vtkMath::Round(edges[e].x + distance*edges[e].gx);
+				int cy = vtkMath::Round(edges[e].y + distance*edges[e].gy);
+				if(cx < 0 || cx >= width || cy < 0 || cy >= height)
+					continue;
+				centers[cy*width + cx] += 1;
+			}
+		}
+	}
+
+	// the votes are spread over a few pixels, the peak is found on the smoothed accumulator
+	GaussianFilter::smooth(centers, width, height, 1.0);
+	int peak = std::max_element(centers.begin(), centers.end()) - centers.begin();
+	double x = peak%width;
+	double y = peak/width;
+
+	// the radius is the most common distance of the edges to the center
+	std::vector<int> radiusVotes(radiusSteps, 0);
+	for(unsigned int e=0; e<edges.size(); e++){
+		int r = vtkMath::Round(sqrt((edges[e].x - x)*(edges[e].x - x) + (edges[e].y - y)*(edges[e].y - y)) - minimumRadius);
+		if(r >= 0 && r < radiusSteps)
+			radiusVotes[r]++;
+	}
+
+	// the peak of the histogram smoothed over three radii
+	int best = 0;
+	int bestVotes = -1;
+	for(int r=0; r<radiusSteps; r++){
+		int votes = radiusVotes[r] + (r > 0 ? radiusVotes[r - 1] : 0) + (r + 1 < radiusSteps ? radiusVotes[r + 1] : 0);
+		if(votes > bestVotes){
+			bestVotes = votes;
+			best = r;
+		}
+	}
+
+	double radius = minimumRadius + best;
+
+	// refine with the edges close to the circle
+	std::vector<int> selected;
+	for(int iteration=0; iteration<3; iteration++){
+
+		selected.clear();
+		for(unsigned int e=0; e<edges.size(); e++){
+			double distance = sqrt((edges[e].x - x)*(edges[e].x - x) + (edges[e].y - y)*(edges[e].y - y));
+			if(fabs(distance - radius) < 2 + sigma)
+				selected.push_back(e);
+		}
+
+		if(!fitCircle(edges, selected, x, y, radius))
+			return circle;
+	}
+
+	if(radius < minimumRadius || radius > maximumRadius)
+		return circle;
+
+	// fraction of 36 sectors of the circle with edges
+	bool sectors[36] = {false};
+	for(unsigned int k=0; k<selected.size(); k++){
+		double angle = atan2(edges[selected[k]].y - y, edges[selected[k]].x - x) + vtkMath::DoublePi();
+		sectors[std::min(35, (int)(angle*36/(2*vtkMath::DoublePi())))] = true;
+	}
+	int covered = 0;
+	for(int k=0; k<36; k++)
+		covered += sectors[k] ? 1 : 0;
+
+	circle.coverage = covered/36.0;
+	if(circle.coverage < 0.5)
+		return circle;
+
+	circle.found = true;
+	circle.x = x;
+	circle.y = y;
+	circle.radius = radius;
+
+	for(unsigned int k=0; k<selected.size(); k++)
+		outline->InsertNextPoint(edges[selected[k]].x, edges[selected[k]].y, 0);
+
+	return circle;
+}
+
+std::vector<SphereSegmentation::Circle> SphereSegmentation::getCircles()
+{
+	return circles;
+}
+
+std::vector< vtkSmartPointer<vtkPoints> > SphereSegmentation::getOutlines()
+{
+	return outlines;
+}
+
+void SphereSegmentation::setImageStack(std::vector< vtkSmartPointer<vtkImageData> > imageStack)
+{
+	this->imageStack = imageStack;
+}
+
+void SphereSegmentation::setRadiusRange(double minimumRadius, double maximumRadius)
+{
+	this->minimumRadius = std::max(1.0, minimumRadius);
+	this->maximumRadius = std::max(this->minimumRadius, maximumRadius);
+}
+
+void SphereSegmentation::setSigma(double sigma)
+{
+	this->sigma = sigma > 0.5 ? sigma : 0.5;
+}
+
+void SphereSegmentation::setNumberOfThreads(int numberOfThreads)
+{
+	this->numberOfThreads = std::max(1, numberOfThreads);
+}
@@ -0,0 +1,96 @@
+#ifndef SPHERESEGMENTATION_H
+#define SPHERESEGMENTATION_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPoints.h>
+
+#include <vector>
+
+//!Finds the outline of the sphere phantom in the images
+/*!
+  This class replaces the manual tracing of the sphere outline used by CheckCalibrationErrorWidget.h.
+  In each image the edges of the smoothed image vote for the circle center along their gradient
+  direction (a circle Hough transform), the radius is the peak of the histogram of the edge distances
+  to the best center and the circle is refined with an algebraic fit of the edge pixels close to it.
+  The images are processed in parallel. The outline of each image is returned as vtkPoints in the
+  same coordinates as the points of vtkTracerInteractorStyle.h.
+*/
+class SphereSegmentation
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static SphereSegmentation *New()
+	{
+			return new SphereSegmentation;
+	}
+
+    /** The circle found in one image */
+	struct Circle
+	{
+		bool found; ///<A circle was found
+		double x; ///<Column of the center
+		double y; ///<Row of the center, from the bottom of the image
+		double radius; ///<Radius in pixels
+		double coverage; ///<Fraction of the circle with edges, from 0 to 1
+	};
+
+    /**
+     * \brief Set the images to segment
+     */
+	void setImageStack(std::vector< vtkSmartPointer<vtkImageData> >);
+
+    /**
+     * \brief Set the minimum and maximum radius in pixels of the sphere section
+     */
+	void setRadiusRange(double, double);
+
+    /**
+     * \brief Set the standard deviation in pixels of the smoothing
+     */
+	void setSigma(double);
+
+    /**
+     * \brief Set the number of threads, each one processes whole images
+     */
+	void setNumberOfThreads(int);
+
+    /**
+     * \brief Find the sphere outline in all the images
+     */
+	void segment();
+
+    /**
+     * \brief Returns the circle of each image found by segment()
+     */
+	std::vector<Circle> getCircles();
+
+    /**
+     * \brief Returns the outline points of each image found by segment(), NULL if not found
+     */
+	std::vector< vtkSmartPointer<vtkPoints> > getOutlines();
+
+    /**
+     * \brief Find the sphere outline in one image, returns the edge points on the circle
+     */
+	Circle segmentImage(vtkImageData *, vtkPoints *);
+
+private:
+
+	SphereSegmentation();
+
+	std::vector< vtkSmartPointer<vtkImageData> > imageStack; ///<Images to segment
+	std::vector<Circle> circles; ///<Circle of each image
+	std::vector< vtkSmartPointer<vtkPoints> > outlines; ///<Outline points of each image
+	double minimumRadius; ///<Minimum radius in pixels
+	double maximumRadius; ///<Maximum radius in pixels
+	double sigma; ///<Smoothing in pixels
+	int numberOfThreads; ///<Number of threads
+
+};
+
+#endif // SPHERESEGMENTATION_H
@@ -0,0 +1,317 @@
+#include "StreamingVolumeReconstruction.h"
+
+#include <vtkImageReader2.h>
+#include <vtkImageReader2Factory.h>
+#include <vtkImageFlip.h>
+#include <vtkMath.h>
+#include <itkTimeProbe.h>
+
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <deque>
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+/** Reads the images in order keeping at most windowSize decoded images waiting */
+class ImageDecoderThread : public QThread
+{
+public:
+
+	ImageDecoderThread(QStringList imageFilenames, int windowSize)
+		: imageFilenames(imageFilenames), windowSize(windowSize)
+	{
+	}
+
+	void run()
+	{
+		for(int i=0; i<imageFilenames.size(); i++){
+
+			vtkSmartPointer<vtkImageData> image = StreamingVolumeReconstruction::readImage(imageFilenames.at(i));
+
+			QMutexLocker locker(&mutex);
+
+			while((int)window.size() >= windowSize)
+				notFull.wait(&mutex);
+
+			// the reference is handed to the window while locked, vtk reference counts are not atomic
+			window.push_back(image);
+			image = NULL;
+			notEmpty.wakeAll();
+		}
+	}
+
+	/** Returns the next image, NULL if it could not be read */
+	vtkSmartPointer<vtkImageData> takeImage()
+	{
+		QMutexLocker locker(&mutex);
+
+		while(window.empty())
+			notEmpty.wait(&mutex);
+
+		vtkSmartPointer<vtkImageData> image = window.front();
+		window.pop_front();
+		notFull.wakeAll();
+
+		return image;
+	}
+
+private:
+
+	QStringList imageFilenames;
+	int windowSize;
+
+	std::deque< vtkSmartPointer<vtkImageData> > window;
+	QMutex mutex;
+	QWaitCondition notFull;
+	QWaitCondition notEmpty;
+};
+
+StreamingVolumeReconstruction::StreamingVolumeReconstruction()
+{
+	resolution = 1;
+	windowSize = 4;
+}
+
+vtkSmartPointer<vtkImageData> StreamingVolumeReconstruction::readImage(QString imageFilename)
+{
+	vtkSmartPointer<vtkImageReader2Factory> readerFactory = vtkSmartPointer<vtkImageReader2Factory>::New();
+
+	vtkImageReader2 * reader = readerFactory->CreateImageReader2(imageFilename.toAscii().data());
+	if(!reader)
+		return NULL;
+
+	reader->SetFileName(imageFilename.toAscii().data());
+	reader->Update();
+
+	vtkSmartPointer<vtkImageFlip> flipYFilter = vtkSmartPointer<vtkImageFlip>::New();
+	flipYFilter->SetFilteredAxis(1);
+	flipYFilter->SetInput(reader->GetOutput());
+	flipYFilter->Update();
+
+	// copy the output so the reader and filter buffers are released with the pipeline
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->DeepCopy(flipYFilter->GetOutput());
+
+	reader->Delete();
+
+	return image;
+}
+
+bool StreamingVolumeReconstruction::calcVolumeBounds()
+{
+	int images = std::min(imageFilenames.size(), (int)transformStack.size());
+	if(images == 0)
+		return false;
+
+	vtkSmartPointer<vtkImageReader2Factory> readerFactory = vtkSmartPointer<vtkImageReader2Factory>::New();
+
+	vnl_vector<double> volumeMin(3, 1e300);
+	vnl_vector<double> volumeMax(3, -1e300);
+
+	vnl_vector<double> point(4);
+	point[2] = 0;
+	point[3] = 1;
+
+	std::cout<<"Calculating images bounds from the image headers"<<std::endl;
+
+	for(int i=0; i<images; i++){
+
+		vtkImageReader2 * reader = readerFactory->CreateImageReader2(imageFilenames.at(i).toAscii().data());
+		if(!reader){
+			std::cout<<"Could not read "<<imageFilenames.at(i).toAscii().data()<<std::endl;
+			return false;
+		}
+
+		// only the header is read
+		reader->SetFileName(imageFilenames.at(i).toAscii().data());
+		reader->UpdateInformation();
+		int * extent = reader->GetOutput()->GetWholeExtent();
+		int imageSize[2] = {extent[1] - extent[0] + 1, extent[3] - extent[2] + 1};
+		reader->Delete();
+
+		for(int corner=0; corner<4; corner++){
+
+			point[0] = scale[0]*imageSize[0]*(corner%2);
+			point[1] = scale[1]*imageSize[1]*(corner/2);
+
+			vnl_vector<double> transformedPoint = transformStack.at(i)*point;
+
+			for(int d=0; d<3; d++){
+				volumeMin[d] = std::min(volumeMin[d], transformedPoint[d]);
+				volumeMax[d] = std::max(volumeMax[d], transformedPoint[d]);
+			}
+		}
+	}
+
+	volumeOrigin = volumeMin;
+
+	volumeSize.set_size(3);
+	for(int d=0; d<3; d++)
+		volumeSize[d] = vtkMath::Round((volumeMax[d] - volumeMin[d])/(scale[0]*resolution)) + 1;
+
+	std::cout<<"Volume origin coords: "<<volumeOrigin[0]<<","<<volumeOrigin[1]<<","<<volumeOrigin[2]<<std::endl;
+	std::cout<<"Volume size: "<<volumeSize[0]<<","<<volumeSize[1]<<","<<volumeSize[2]<<std::endl;
+
+	return true;
+}
+
+vtkSmartPointer<vtkImageData> StreamingVolumeReconstruction::generateVolume()
+{
+	if(volumeSize.size() != 3 && !calcVolumeBounds())
+		return NULL;
+
+	int images = std::min(imageFilenames.size(), (int)transformStack.size());
+	int voxels = volumeSize[0]*volumeSize[1]*volumeSize[2];
+
+	std::cout<<std::endl<<"Streaming "<<images<<" images with a window of "<<windowSize<<" images"<<std::flush;
+
+	itk::TimeProbe clock;
+	clock.Start();
+
+	std::vector<float> accumulator(voxels, 0);
+	std::vector<float> weights(voxels, 0);
+
+	ImageDecoderThread decoder(imageFilenames.mid(0, images), windowSize);
+	decoder.start();
+
+	for(int i=0; i<images; i++){
+
+		vtkSmartPointer<vtkImageData> image = decoder.takeImage();
+
+		if(image.GetPointer() == NULL){
+			std::cout<<std::endl<<"Could not read "<<imageFilenames.at(i).toAscii().data()<<std::endl;
+			continue;
+		}
+
+		addImage(image, transformStack.at(i), accumulator, weights);
+
+		if(i%10 == 0)
+			std::cout<<"."<<std::flush;
+	}
+
+	decoder.wait();
+
+	vtkSmartPointer<vtkImageData> volumeData = vtkSmartPointer<vtkImageData>::New();
+	volumeData->SetNumberOfScalarComponents(1);
+	volumeData->SetScalarType(VTK_UNSIGNED_CHAR);
+	volumeData->SetOrigin(0,0,0);
+	volumeData->SetDimensions(volumeSize[0],volumeSize[1],volumeSize[2]);
+	volumeData->SetSpacing(scale[0]*resolution,scale[0]*resolution,scale[0]*resolution);
+	volumeData->AllocateScalars();
+
+	weightData = vtkSmartPointer<vtkImageData>::New();
+	weightData->SetNumberOfScalarComponents(1);
+	weightData->SetScalarType(VTK_FLOAT);
+	weightData->SetOrigin(0,0,0);
+	weightData->SetDimensions(volumeSize[0],volumeSize[1],volumeSize[2]);
+	weightData->SetSpacing(scale[0]*resolution,scale[0]*resolution,scale[0]*resolution);
+	weightData->AllocateScalars();
+
+	unsigned char * volumePointer = static_cast<unsigned char *>(volumeData->GetScalarPointer());
+	float * weightPointer = static_cast<float *>(weightData->GetScalarPointer());
+
+	for(int v=0; v<voxels; v++){
+		volumePointer[v] = weights[v] > 0 ? (unsigned char)(accumulator[v]/weights[v] + 0.5) : 0;
+		weightPointer[v] = weights[v];
+	}
+
+	clock.Stop();
+	std::cout<<std::endl<<"Time elapsed: "<<clock.GetMean()*1000<<" ms"<<std::endl;
+
+	return volumeData;
+}
+
+void StreamingVolumeReconstruction::addImage(vtkImageData * image, vnl_matrix<double> transform,
+											 std::vector<float> & accumulator, std::vector<float> & weights)
+{
+	int dims[3];
+	image->GetDimensions(dims);
+
+	int components = image->GetNumberOfScalarComponents();
+	bool isUnsignedChar = image->GetScalarType() == VTK_UNSIGNED_CHAR;
+	unsigned char * pixels = static_cast<unsigned char *>(image->GetScalarPointer());
+
+	double spacing = scale[0]*resolution;
+	int size[3] = {(int)volumeSize[0], (int)volumeSize[1], (int)volumeSize[2]};
+
+	// voxel coords of the image origin and steps along the image x and y axes
+	double origin[3];
+	double stepX[3];
+	double stepY[3];
+	for(int d=0; d<3; d++){
+		origin[d] = (transform[d][3] - volumeOrigin[d])/spacing + 0.5;
+		stepX[d] = transform[d][0]*scale[0]/spacing;
+		stepY[d] = transform[d][1]*scale[1]/spacing;
+	}
+
+	for(int y=0; y<dims[1]; y++){
+		for(int x=0; x<dims[0]; x++){
+
+			int voxel[3];
+			bool inside = true;
+			for(int d=0; d<3; d++){
+				voxel[d] = (int)floor(origin[d] + x*stepX[d] + y*stepY[d]);
+				inside = inside && voxel[d] >= 0 && voxel[d] < size[d];
+			}
+
+			if(!inside)
+				continue;
+
+			double value = isUnsignedChar ? pixels[(y*dims[0] + x)*components]
+										  : image->GetScalarComponentAsDouble(x,y,0,0);
+
+			int idx = (voxel[2]*size[1] + voxel[1])*size[0] + voxel[0];
+			accumulator[idx] += value;
+			weights[idx] += 1;
+		}
+	}
+}
+
+vnl_vector<double> StreamingVolumeReconstruction::getVolumeOrigin()
+{
+	return this->volumeOrigin;
+}
+
+vtkSmartPointer<vtkImageData> StreamingVolumeReconstruction::getWeightVolume()
+{
+	return this->weightData;
+}
+
+void StreamingVolumeReconstruction::setImageFilenames(QStringList imageFilenames)
+{
+	this->imageFilenames = imageFilenames;
+}
+
+void StreamingVolumeReconstruction::setTransformStack(std::vector< vnl_matrix<double> > transformStack)
+{
+    this->transformStack = transformStack;
+}
+
+void StreamingVolumeReconstruction::setScale(vnl_vector<double> scale)
+{
+    this->scale = scale;
+}
+
+void StreamingVolumeReconstruction::setResolution(int resolution)
+{
+    this->resolution = resolution;
+}
+
+void StreamingVolumeReconstruction::setWindowSize(int windowSize)
+{
+    this->windowSize = std::max(1, windowSize);
+}
+
+void StreamingVolumeReconstruction::setVolumeSize(vnl_vector<double> volumeSize)
+{
+    this->volumeSize = volumeSize;
+}
+
+void StreamingVolumeReconstruction::setVolumeOrigin(vnl_vector<double> volumeOrigin)
+{
+    this->volumeOrigin = volumeOrigin;
+}
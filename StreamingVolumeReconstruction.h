@@ -0,0 +1,118 @@
+#ifndef STREAMINGVOLUMERECONSTRUCTION_H
+#define STREAMINGVOLUMERECONSTRUCTION_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <QStringList>
+
+#include <vector>
+
+//!Generate a volume streaming the images from disk
+/*!
+  This class generates a volume with a pixel based method without loading the whole sweep.
+  A decoder thread reads the images in acquisition order and keeps at most a small window of
+  decoded images, while the calling thread adds each pixel of the image to its nearest voxel
+  and releases the image. The memory used by the images does not depend on the length of the
+  sweep and decoding overlaps with the reconstruction. Each voxel is the mean of the pixels that
+  fall in it, voxels without pixels are left at 0 with weight 0.
+*/
+class StreamingVolumeReconstruction
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static StreamingVolumeReconstruction *New()
+	{
+			return new StreamingVolumeReconstruction;
+	}
+
+    /**
+     * \brief Set the image files in acquisition order
+     */
+	void setImageFilenames(QStringList);
+
+    /**
+     * \brief Set the transformation for each image used in the reconstruction
+     */
+    void setTransformStack(std::vector< vnl_matrix<double> >);
+
+    /**
+     * \brief Set the scale of the images
+     */
+    void setScale(vnl_vector<double>);
+
+    /**
+     * \brief Set the resolution of the volume
+     */
+    void setResolution(int);
+
+    /**
+     * \brief Set the maximum number of decoded images in memory
+     */
+    void setWindowSize(int);
+
+    /**
+     * \brief Set the size of the volume data
+     */
+	void setVolumeSize(vnl_vector<double>);
+
+    /**
+     * \brief Set the volume data orgin in the 3D scene
+     */
+	void setVolumeOrigin(vnl_vector<double>);
+
+    /**
+     * \brief Computes the volume origin and size from the image headers and the transformations
+     * \param[out] false if an image can not be read
+     */
+	bool calcVolumeBounds();
+
+    /**
+     * \brief Returns the volume data origin in the 3D scene
+     */
+	vnl_vector<double> getVolumeOrigin();
+
+    /**
+     * \brief Returns the new volume data
+     */
+	vtkSmartPointer<vtkImageData> generateVolume();
+
+    /**
+     * \brief Returns the number of pixels added to each voxel of the last generated volume
+     */
+	vtkSmartPointer<vtkImageData> getWeightVolume();
+
+    /**
+     * \brief Read an image the same way the volume images are loaded for display
+     */
+	static vtkSmartPointer<vtkImageData> readImage(QString);
+
+private:
+
+	StreamingVolumeReconstruction();
+
+	QStringList imageFilenames; ///<Image files in acquisition order
+    std::vector< vnl_matrix<double> > transformStack; ///<Transformation of each image
+	vnl_vector<double> scale; ///<Scale of the images
+	vnl_vector<double> volumeSize; ///<Size of the volume
+	vnl_vector<double> volumeOrigin; ///<Where the volume data begins in the 3D scene
+	int resolution; ///<Resolution of the volume
+	int windowSize; ///<Maximum number of decoded images
+
+	vtkSmartPointer<vtkImageData> weightData; ///<Number of pixels of each voxel
+
+    /**
+     * \brief Add the pixels of one image to the accumulator and weight buffers
+     */
+	void addImage(vtkImageData *, vnl_matrix<double>, std::vector<float> &, std::vector<float> &);
+
+};
+
+#endif // STREAMINGVOLUMERECONSTRUCTION_H
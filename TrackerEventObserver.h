@@ -0,0 +1,109 @@
+#ifndef TRACKEREVENTOBSERVER_H
+#define TRACKEREVENTOBSERVER_H
+
+#include <string>
+
+#include "itkCommand.h"
+#include "igstkEvents.h"
+#include "igstkTrackerTool.h"
+#include "igstkPulseGenerator.h"
+#include "igstkRealTimeClock.h"
+
+//!Waits for the tracker events
+/*!
+  This command records the start and stop tracking events of a tracker and the error events. The events are sent inside the start and stop
+  requests, the wait functions sleep until they arrive or the timeout expires. They do not dispatch
+  the IGSTK pulses, which would render the View and update the other trackers in this thread.
+*/
+class TrackerEventObserver : public itk::Command
+{
+public:
+  typedef  TrackerEventObserver        Self;
+  typedef  itk::Command                Superclass;
+  typedef itk::SmartPointer<Self>      Pointer;
+  itkNewMacro( Self );
+
+protected:
+  TrackerEventObserver()
+  {
+    Reset();
+  }
+
+public:
+  void Execute(itk::Object *caller, const itk::EventObject & event)
+  {
+    Execute( (const itk::Object *)caller, event);
+  }
+
+  void Execute(const itk::Object * object, const itk::EventObject & event)
+  {
+    if (igstk::TrackerStartTrackingEvent().CheckEvent(&event))
+      started = true;
+    else if (igstk::TrackerStopTrackingEvent().CheckEvent(&event))
+      stopped = true;
+    else if (igstk::TrackerStartTrackingErrorEvent().CheckEvent(&event) ||
+             igstk::TrackerStopTrackingErrorEvent().CheckEvent(&event) ||
+             igstk::IGSTKErrorEvent().CheckEvent(&event))
+      error = event.GetEventName();
+  }
+
+  /** \brief Forget the events received */
+  void Reset()
+  {
+    started = false;
+    stopped = false;
+    error.clear();
+  }
+
+  /** \brief Wait until the tracker reports that tracking started
+  * \param[in] timeout in milliseconds
+  * \return false on error or timeout, see GetErrorMessage() */
+  bool WaitForStartTracking(double timeout)
+  {
+    return Wait(true, timeout);
+  }
+
+  /** \brief Wait until tracking stopped
+  * \param[in] timeout in milliseconds
+  * \return false on error or timeout, see GetErrorMessage() */
+  bool WaitForStopTracking(double timeout)
+  {
+    return Wait(false, timeout);
+  }
+
+  /** \brief Returns the error of the last wait */
+  std::string GetErrorMessage()
+  {
+    return error;
+  }
+
+private:
+
+  bool Wait(bool start, double timeout)
+  {
+    double deadline = igstk::RealTimeClock::GetTimeStamp() + timeout;
+
+    while (error.empty())
+    {
+      if (start ? started : stopped)
+        return true;
+
+      if (igstk::RealTimeClock::GetTimeStamp() > deadline)
+      {
+        error = start ? "Timeout waiting for the tracker to start"
+                      : "Timeout waiting for the tracker to stop";
+        break;
+      }
+
+      igstk::PulseGenerator::Sleep(5);
+    }
+
+    return false;
+  }
+
+  bool started;
+  bool stopped;
+  std::string error;
+};
+
+#endif // TRACKEREVENTOBSERVER_H
@@ -0,0 +1,79 @@
+#include "TrackingDevice.h"
+
+#include "itkVector.h"
+#include "itkVersor.h"
+
+#include <algorithm>
+
+TrackingDevice::TrackingDevice()
+	: mutex(QMutex::Recursive)
+{
+}
+
+QMutex * TrackingDevice::getMutex()
+{
+	return &mutex;
+}
+
+std::string TrackingDevice::getToolName(int tool)
+{
+	return this->toolNames.at(tool);
+}
+
+void TrackingDevice::updateStatus()
+{
+	// the global pulse dispatch would also render the View and update the other trackers
+	getIGSTKTracker()->RequestUpdateStatus();
+}
+
+int TrackingDevice::getToolIndex(std::string name)
+{
+	for(unsigned int t = 0; t < toolNames.size(); t++)
+		if(toolNames[t] == name)
+			return t;
+
+	return -1;
+}
+
+void TrackingDevice::readTool(igstk::TrackerTool * tool, igstk::TransformObserver * observer,
+	TrackingSample & sample, int t)
+{
+	sample.valid[t] = false;
+
+	observer->Clear();
+	tool->RequestGetTransformToParent();
+
+	if(!observer->GotTransform())
+		return;
+
+	const igstk::Transform & transform = observer->GetTransform();
+	if(!transform.IsValidNow())
+		return;
+
+	itk::Vector<double, 3> position = transform.GetTranslation();
+	itk::Versor<double>::MatrixType matrix = transform.GetRotation().GetMatrix();
+
+	for(int i = 0; i < 3; i++)
+	{
+		sample.translation[t][i] = position[i];
+		for(int j = 0; j < 3; j++)
+			sample.rotation[t][3*i + j] = matrix(i,j);
+	}
+
+	sample.valid[t] = true;
+	sample.toolTime[t] = transform.GetStartTime();
+}
+
+void TrackingDevice::setSnapshotTime(TrackingSample & sample, double frequency)
+{
+	sample.time = -1;
+	for(int t = 0; t < sample.numberOfTools; t++)
+		if(sample.valid[t])
+			sample.time = std::max(sample.time, sample.toolTime[t]);
+
+	// a tool still valid from an older frame was not seen in the newest one
+	double halfFrame = 500/frequency;
+	for(int t = 0; t < sample.numberOfTools; t++)
+		if(sample.valid[t] && sample.toolTime[t] < sample.time - halfFrame)
+			sample.valid[t] = false;
+}
@@ -0,0 +1,114 @@
+#ifndef TRACKINGDEVICE_H
+#define TRACKINGDEVICE_H
+
+#include <QMutex>
+
+#include <string>
+#include <vector>
+
+#include "igstkTracker.h"
+#include "igstkTrackerTool.h"
+#include "igstkTransformObserver.h"
+
+#include "TrackingSample.h"
+
+//!Interface of the tracking devices
+/*!
+  A configured tracker with its tools attached, e.g. the optical PolarisTracker.h or the
+  electromagnetic MedSafeTracker.h. The tools have names, so the instruments are found by name
+  whatever device tracks them, and all the tools of a device are read in one snapshot.
+  TrackingSession.h polls several devices at the same time and merges their snapshots. IGSTK
+  objects are not thread safe, every call to the IGSTK objects of a device while it is tracking
+  holds its mutex, so the devices are polled without waiting for each other.
+*/
+class TrackingDevice
+{
+
+public:
+
+	virtual ~TrackingDevice() {}
+
+    /**
+     * \brief Returns the mutex of the IGSTK calls to this device
+     */
+	QMutex * getMutex();
+
+    /**
+     * \brief Returns the name of the device
+     */
+	virtual std::string getDeviceName() = 0;
+
+    /**
+     * \brief Start Tracking, waits until the tracker reports that tracking started
+     * \param[in] timeout in milliseconds
+     * \return false if the tracker reported an error or the timeout expired
+     */
+	virtual bool startTracking(double timeout = 5000) = 0;
+
+    /**
+     * \brief Stop Tracking, waits until the tracker stopped
+     * \param[in] timeout in milliseconds
+     * \return false if the tracker reported an error or the timeout expired
+     */
+	virtual bool stopTracking(double timeout = 5000) = 0;
+
+    /**
+     * \brief Update the tools of this tracker with its newest replies, without the other IGSTK pulses
+     */
+	void updateStatus();
+
+    /**
+     * \brief Read all the tools in one call, the tools not seen in the newest frame are not valid
+     * \return false if no tool has a valid transform
+     */
+	virtual bool getSnapshot(TrackingSample &) = 0;
+
+    /**
+     * \brief Return number of tools attached to tracker
+     */
+	virtual int getNumberofTools() = 0;
+
+    /**
+     * \brief Returns a tool, the parent of the objects it tracks in the scene
+     */
+	virtual igstk::TrackerTool * getTrackerTool(int) = 0;
+
+    /**
+     * \brief Returns the IGSTK tracker, the parent of its tools in the scene
+     */
+	virtual igstk::Tracker * getIGSTKTracker() = 0;
+
+    /**
+     * \brief Returns the name of a tool
+     */
+	std::string getToolName(int);
+
+    /**
+     * \brief Returns the number of the tool with a name, -1 if there is none
+     */
+	int getToolIndex(std::string);
+
+protected:
+
+	TrackingDevice();
+
+    /**
+     * \brief Read the transform of one tool of the snapshot
+     * \param[in] tool, its observer, snapshot and number of the tool in the snapshot
+     */
+	static void readTool(igstk::TrackerTool *, igstk::TransformObserver *, TrackingSample &, int);
+
+    /**
+     * \brief Set the snapshot time to the newest tool and invalidate the tools of older frames
+     * \param[in] snapshot and tracker frequency
+     */
+	static void setSnapshotTime(TrackingSample &, double);
+
+	std::vector<std::string> toolNames; ///<Name of each tool, in the order they were initialized
+
+private:
+
+	QMutex mutex; ///<Serializes the IGSTK calls to the tracker and its tools
+};
+
+#endif // TRACKINGDEVICE_H
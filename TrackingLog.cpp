@@ -0,0 +1,247 @@
+#include "TrackingLog.h"
+
+#include <string.h>
+#include <iostream>
+
+const char TrackingLog::fileMagic[8] = {'T','R','K','L','O','G','1','\0'};
+
+TrackingLog::TrackingLog(QString filename, int capacity)
+	: filename(filename), dequeuePosition(0), sequence(0), lastTime(0), stopRequested(false)
+{
+	unsigned int size = 2;
+	while((int)size < capacity)
+		size <<= 1;
+
+	entries.resize(size);
+	mask = size - 1;
+
+	for(unsigned int i=0; i<size; i++)
+		entries[i].sequence = i;
+
+	enqueuePosition = 0;
+	droppedSamples = 0;
+	droppedEvents = 0;
+	writtenDrops[0] = 0;
+	writtenDrops[1] = 0;
+}
+
+TrackingLog::~TrackingLog()
+{
+	close();
+}
+
+bool TrackingLog::open()
+{
+	file.open(filename.toAscii().data(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!file.is_open()){
+		std::cout<<"Could not create the tracking log "<<filename.toAscii().data()<<std::endl;
+		return false;
+	}
+
+	file.write(fileMagic, sizeof(fileMagic));
+
+	stopRequested = false;
+	start(QThread::LowPriority);
+
+	return true;
+}
+
+void TrackingLog::close()
+{
+	if(!isRunning())
+		return;
+
+	stopRequested = true;
+	wait();
+
+	file.close();
+
+	if(getDroppedSamples() > 0 || getDroppedEvents() > 0)
+		std::cout<<"Tracking log dropped "<<getDroppedSamples()<<" samples and "
+			<<getDroppedEvents()<<" events, the buffer was full"<<std::endl;
+}
+
+TrackingLog::Entry * TrackingLog::reserve()
+{
+	int position = enqueuePosition.fetchAndAddAcquire(0);
+
+	while(true){
+
+		Entry &entry = entries[position & mask];
+		int difference = entry.sequence.fetchAndAddAcquire(0) - position;
+
+		if(difference == 0){
+			if(enqueuePosition.testAndSetOrdered(position, position + 1))
+				return &entry;
+		}
+		else if(difference < 0){
+			// the writer thread did not free the slot yet
+			return NULL;
+		}
+
+		position = enqueuePosition.fetchAndAddAcquire(0);
+	}
+}
+
+bool TrackingLog::logSample(const TrackingSample &sample)
+{
+	Entry *entry = reserve();
+	if(!entry){
+		droppedSamples.fetchAndAddOrdered(1);
+		return false;
+	}
+
+	int position = entry->sequence;
+	entry->type = SampleRecord;
+	entry->level = 0;
+	entry->time = sample.time;
+	entry->sample = sample;
+	entry->sequence.fetchAndStoreRelease(position + 1);
+
+	return true;
+}
+
+bool TrackingLog::logEvent(double time, int level, const char *text)
+{
+	Entry *entry = reserve();
+	if(!entry){
+		droppedEvents.fetchAndAddOrdered(1);
+		return false;
+	}
+
+	int position = entry->sequence;
+	entry->type = EventRecord;
+	entry->level = level;
+	entry->time = time;
+	strncpy(entry->text, text, TRACKING_LOG_TEXT_SIZE);
+	entry->text[TRACKING_LOG_TEXT_SIZE] = '\0';
+	entry->sequence.fetchAndStoreRelease(position + 1);
+
+	return true;
+}
+
+unsigned int TrackingLog::getDroppedSamples()
+{
+	return (unsigned int)droppedSamples.fetchAndAddAcquire(0);
+}
+
+unsigned int TrackingLog::getDroppedEvents()
+{
+	return (unsigned int)droppedEvents.fetchAndAddAcquire(0);
+}
+
+void TrackingLog::run()
+{
+	output.reserve(64*1024);
+
+	while(true){
+
+		// read the flag before emptying the buffer, the records queued before close() are written
+		bool stopping = stopRequested;
+
+		int written = 0;
+		while(true){
+
+			Entry &entry = entries[dequeuePosition & mask];
+			if(entry.sequence.fetchAndAddAcquire(0) != (int)(dequeuePosition + 1))
+				break;
+
+			encode(entry);
+			entry.sequence.fetchAndStoreRelease(dequeuePosition + mask + 1);
+			dequeuePosition++;
+			written++;
+		}
+
+		encodeDrops();
+		flush();
+
+		if(stopping)
+			break;
+
+		// the producers do not signal, the buffer is polled
+		if(written == 0)
+			msleep(10);
+	}
+}
+
+void TrackingLog::encode(const Entry &entry)
+{
+	RecordHeader header;
+	header.type = (unsigned char)entry.type;
+	header.count = 0;
+	header.length = 0;
+	header.sequence = sequence++;
+	header.time = entry.time;
+	lastTime = entry.time;
+
+	unsigned int start = output.size();
+	output.resize(start + sizeof(RecordHeader));
+
+	if(entry.type == SampleRecord){
+
+		const TrackingSample &sample = entry.sample;
+
+		for(int t=0; t<sample.numberOfTools; t++){
+
+			if(!sample.valid[t])
+				continue;
+
+			unsigned char tool = (unsigned char)t;
+			float rotation[9];
+			for(int k=0; k<9; k++)
+				rotation[k] = (float)sample.rotation[t][k];
+
+			unsigned int offset = output.size();
+			output.resize(offset + 1 + sizeof(double) + sizeof(sample.translation[t]) + sizeof(rotation));
+
+			char *data = &output[offset];
+			memcpy(data, &tool, 1);
+			memcpy(data + 1, &sample.toolTime[t], sizeof(double));
+			memcpy(data + 1 + sizeof(double), sample.translation[t], sizeof(sample.translation[t]));
+			memcpy(data + 1 + sizeof(double) + sizeof(sample.translation[t]), rotation, sizeof(rotation));
+
+			header.count++;
+		}
+	}
+	else{
+
+		unsigned int length = strlen(entry.text);
+		header.count = (unsigned char)entry.level;
+		output.insert(output.end(), entry.text, entry.text + length);
+	}
+
+	header.length = (unsigned short)(output.size() - start - sizeof(RecordHeader));
+	memcpy(&output[start], &header, sizeof(RecordHeader));
+}
+
+void TrackingLog::encodeDrops()
+{
+	unsigned int drops[2] = {getDroppedSamples(), getDroppedEvents()};
+	if(drops[0] == writtenDrops[0] && drops[1] == writtenDrops[1])
+		return;
+
+	writtenDrops[0] = drops[0];
+	writtenDrops[1] = drops[1];
+
+	RecordHeader header;
+	header.type = DropRecord;
+	header.count = 0;
+	header.length = sizeof(drops);
+	header.sequence = sequence++;
+	header.time = lastTime;
+
+	const char *headerBytes = reinterpret_cast<const char *>(&header);
+	const char *dropBytes = reinterpret_cast<const char *>(drops);
+	output.insert(output.end(), headerBytes, headerBytes + sizeof(RecordHeader));
+	output.insert(output.end(), dropBytes, dropBytes + sizeof(drops));
+}
+
+void TrackingLog::flush()
+{
+	if(output.empty())
+		return;
+
+	file.write(&output[0], output.size());
+	file.flush();
+	output.clear();
+}
@@ -0,0 +1,142 @@
+#ifndef TRACKINGLOG_H
+#define TRACKINGLOG_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QString>
+
+#include "TrackingSample.h"
+
+#include <vector>
+#include <fstream>
+
+/** Maximum length of the text of a logged event */
+#define TRACKING_LOG_TEXT_SIZE 240
+
+//!Binary log of the tracking session written by a background thread
+/*!
+  The tracking samples and the tracker events are queued in a bounded lock-free buffer and written
+  to disk by this thread, so the acquisition never waits for the disk. When the buffer is full the
+  record is dropped and counted, the drop counters are written to the log when they change so the
+  overflow is visible in the file. Any number of threads can log at the same time.
+
+  File format, native byte order: the 8 bytes of fileMagic, then one record after another, each
+  one with a RecordHeader followed by length bytes of payload:
+  - SampleRecord: count valid tools, each one with the tool number (1 byte), the tool time
+    (double), the translation (3 doubles) and the rotation matrix row major (9 floats).
+  - EventRecord: count is the priority level, the payload is the text.
+  - DropRecord: the samples and the events dropped since the log was opened (2 unsigned ints).
+
+  TrackingLogConverter.cpp prints a log as text.
+*/
+class TrackingLog : public QThread
+{
+
+public:
+
+	enum RecordType { SampleRecord = 1, EventRecord = 2, DropRecord = 3 };
+
+	/** Header of each record in the file */
+	struct RecordHeader
+	{
+		unsigned char type; ///<RecordType
+		unsigned char count; ///<Tools of a sample or level of an event
+		unsigned short length; ///<Bytes of payload after the header
+		unsigned int sequence; ///<Number of the record, the dropped records are not numbered
+		double time; ///<Time in milliseconds of igstk::RealTimeClock
+	};
+
+	static const char fileMagic[8]; ///<First bytes of the file
+
+    /**
+     * \brief Constructor
+     * \param[in] file to write
+     * \param[in] number of records the buffer holds, rounded up to a power of two
+     */
+	TrackingLog(QString, int capacity = 4096);
+
+	~TrackingLog();
+
+    /**
+     * \brief Open the file and start the writer thread
+     * \return false if the file could not be created
+     */
+	bool open();
+
+    /**
+     * \brief Write the queued records, the drop counters and close the file
+     */
+	void close();
+
+    /**
+     * \brief Queue a tracking sample, never blocks
+     * \return false if the buffer is full and the sample was dropped
+     */
+	bool logSample(const TrackingSample &);
+
+    /**
+     * \brief Queue an event, the text is truncated to TRACKING_LOG_TEXT_SIZE, never blocks
+     * \param[in] time in milliseconds, priority level and text
+     * \return false if the buffer is full and the event was dropped
+     */
+	bool logEvent(double, int, const char *);
+
+    /**
+     * \brief Returns the number of samples dropped because the buffer was full
+     */
+	unsigned int getDroppedSamples();
+
+    /**
+     * \brief Returns the number of events dropped because the buffer was full
+     */
+	unsigned int getDroppedEvents();
+
+protected:
+
+	/** \brief Write the queued records until the log is closed */
+	void run();
+
+private:
+
+	/** A queued record, the sequence is the Vyukov bounded queue ticket */
+	struct Entry
+	{
+		QAtomicInt sequence; ///<Position the slot is ready for
+		int type; ///<RecordType
+		int level; ///<Level of an event
+		double time; ///<Time of the record
+		union
+		{
+			TrackingSample sample;
+			char text[TRACKING_LOG_TEXT_SIZE + 1];
+		};
+	};
+
+	/** \brief Reserve a slot for a writer, NULL if the buffer is full */
+	Entry * reserve();
+
+	/** \brief Encode the record of a slot in the output buffer */
+	void encode(const Entry &);
+
+	/** \brief Encode the drop counters if they changed */
+	void encodeDrops();
+
+	/** \brief Write the output buffer to the file */
+	void flush();
+
+	QString filename; ///<Log file
+	std::ofstream file; ///<Log file stream
+	std::vector<Entry> entries; ///<The buffer
+	unsigned int mask; ///<Capacity - 1
+	QAtomicInt enqueuePosition; ///<Next slot for the producers
+	unsigned int dequeuePosition; ///<Next slot for the writer thread
+	QAtomicInt droppedSamples; ///<Samples dropped
+	QAtomicInt droppedEvents; ///<Events dropped
+	unsigned int writtenDrops[2]; ///<Drop counters in the file
+	unsigned int sequence; ///<Next record number
+	double lastTime; ///<Time of the last record written, the drop records have this time
+	std::vector<char> output; ///<Encoded records waiting to be written
+	volatile bool stopRequested; ///<The log is closing
+};
+
+#endif // TRACKINGLOG_H
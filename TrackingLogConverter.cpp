@@ -0,0 +1,139 @@
+#include "TrackingLog.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string.h>
+
+/*
+  Prints a binary tracking log written by TrackingLog.h as text.
+
+  Usage: TrackingLogConverter logFile [outputFile]
+
+  One line per record, the fields separated by spaces:
+  sample sequence time numberOfTools, then for each tool: tool toolTime x y z r00 r01 ... r22
+  event sequence time level text
+  drops sequence time droppedSamples droppedEvents
+
+  The number of records, the records missing from the sequence and the final drop counters
+  are printed at the end.
+*/
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr<<"Usage: "<<argv[0]<<" logFile [outputFile]"<<std::endl;
+		return 1;
+	}
+
+	std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+	if (!input.is_open())
+	{
+		std::cerr<<"Could not open "<<argv[1]<<std::endl;
+		return 1;
+	}
+
+	char magic[sizeof(TrackingLog::fileMagic)];
+	if (!input.read(magic, sizeof(magic)) || memcmp(magic, TrackingLog::fileMagic, sizeof(magic)) != 0)
+	{
+		std::cerr<<argv[1]<<" is not a tracking log"<<std::endl;
+		return 1;
+	}
+
+	std::ofstream outputFile;
+	if (argc > 2)
+	{
+		outputFile.open(argv[2]);
+		if (!outputFile.is_open())
+		{
+			std::cerr<<"Could not create "<<argv[2]<<std::endl;
+			return 1;
+		}
+	}
+	std::ostream &output = argc > 2 ? outputFile : std::cout;
+	output.precision(10);
+
+	const unsigned int toolSize = 1 + sizeof(double) + 3*sizeof(double) + 9*sizeof(float);
+
+	TrackingLog::RecordHeader header;
+	std::vector<char> payload;
+	unsigned int records = 0;
+	unsigned int missing = 0;
+	unsigned int expected = 0;
+	unsigned int drops[2] = {0, 0};
+
+	while (input.read(reinterpret_cast<char *>(&header), sizeof(header)))
+	{
+		payload.resize(header.length);
+		if (header.length > 0 && !input.read(&payload[0], header.length))
+		{
+			std::cerr<<"The last record is truncated"<<std::endl;
+			break;
+		}
+
+		if (header.sequence != expected)
+			missing += header.sequence - expected;
+		expected = header.sequence + 1;
+		records++;
+
+		if (header.type == TrackingLog::SampleRecord)
+		{
+			if (header.length != header.count*toolSize)
+			{
+				std::cerr<<"Record "<<header.sequence<<" has a wrong length"<<std::endl;
+				continue;
+			}
+
+			output<<"sample "<<header.sequence<<" "<<header.time<<" "<<(int)header.count;
+
+			for (int t = 0; t < header.count; t++)
+			{
+				const char *data = &payload[t*toolSize];
+
+				unsigned char tool;
+				double toolTime;
+				double translation[3];
+				float rotation[9];
+				memcpy(&tool, data, 1);
+				memcpy(&toolTime, data + 1, sizeof(double));
+				memcpy(translation, data + 1 + sizeof(double), sizeof(translation));
+				memcpy(rotation, data + 1 + sizeof(double) + sizeof(translation), sizeof(rotation));
+
+				output<<" "<<(int)tool<<" "<<toolTime;
+				for (int k = 0; k < 3; k++)
+					output<<" "<<translation[k];
+				for (int k = 0; k < 9; k++)
+					output<<" "<<rotation[k];
+			}
+			output<<"\n";
+		}
+		else if (header.type == TrackingLog::EventRecord)
+		{
+			std::string text(payload.begin(), payload.end());
+
+			// one line per event
+			for (unsigned int c = 0; c < text.size(); c++)
+				if (text[c] == '\n' || text[c] == '\r')
+					text[c] = ' ';
+
+			output<<"event "<<header.sequence<<" "<<header.time<<" "<<(int)header.count<<" "<<text<<"\n";
+		}
+		else if (header.type == TrackingLog::DropRecord && header.length == sizeof(drops))
+		{
+			memcpy(drops, &payload[0], sizeof(drops));
+			output<<"drops "<<header.sequence<<" "<<header.time<<" "<<drops[0]<<" "<<drops[1]<<"\n";
+		}
+		else
+		{
+			std::cerr<<"Record "<<header.sequence<<" has an unknown type "<<(int)header.type<<std::endl;
+		}
+	}
+
+	output.flush();
+
+	std::cerr<<records<<" records, "<<missing<<" missing from the sequence, "
+		<<drops[0]<<" samples and "<<drops[1]<<" events dropped while logging"<<std::endl;
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef TRACKINGLOGOUTPUT_H
+#define TRACKINGLOGOUTPUT_H
+
+#include <string>
+
+#include "itkLogOutput.h"
+#include "igstkRealTimeClock.h"
+
+#include "TrackingLog.h"
+
+//!Output of an IGSTK logger to a TrackingLog
+/*!
+  The entries of the logger are queued as events of the binary tracking log instead of being
+  written to a text stream in the thread that logs, so logging the serial communication and the
+  tracker state machines does not wait for the disk. Entries are dropped if the log is full.
+*/
+class TrackingLogOutput : public itk::LogOutput
+{
+public:
+  typedef  TrackingLogOutput           Self;
+  typedef  itk::LogOutput              Superclass;
+  typedef itk::SmartPointer<Self>      Pointer;
+  itkNewMacro( Self );
+
+  /** \brief Set the log the entries are queued in */
+  void SetTrackingLog(TrackingLog * log)
+  {
+    trackingLog = log;
+  }
+
+  /** \brief The log thread writes to disk, nothing to flush here */
+  void Flush()
+  {
+  }
+
+  /** \brief The entries are timestamped when they are queued */
+  void Write(double)
+  {
+  }
+
+  void Write(const std::string & content)
+  {
+    Write(content, igstk::RealTimeClock::GetTimeStamp());
+  }
+
+  void Write(const std::string & content, double timestamp)
+  {
+    if (trackingLog)
+      trackingLog->logEvent(timestamp, 0, content.c_str());
+  }
+
+protected:
+  TrackingLogOutput() : trackingLog(NULL) {}
+
+private:
+  TrackingLog * trackingLog;
+};
+
+#endif // TRACKINGLOGOUTPUT_H
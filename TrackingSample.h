@@ -0,0 +1,19 @@
+#ifndef TRACKINGSAMPLE_H
+#define TRACKINGSAMPLE_H
+
+/** Maximum number of tools in a tracking sample */
+#define TRACKING_SAMPLE_MAX_TOOLS 8
+
+//!Poses of all the tools read in one tracker update
+struct TrackingSample
+{
+	double time; ///<Time in milliseconds of igstk::RealTimeClock of the tracker frame
+	double readTime; ///<Time the acquisition thread read the frame from the tool observers
+	int numberOfTools; ///<Tools in the sample
+	bool valid[TRACKING_SAMPLE_MAX_TOOLS]; ///<The tool was seen in the tracker frame
+	double toolTime[TRACKING_SAMPLE_MAX_TOOLS]; ///<Time of the tool transform, repeated if the tool was not updated
+	double translation[TRACKING_SAMPLE_MAX_TOOLS][3]; ///<Tool position in the tracker coordinates
+	double rotation[TRACKING_SAMPLE_MAX_TOOLS][9]; ///<Tool rotation matrix, row major
+};
+
+#endif // TRACKINGSAMPLE_H
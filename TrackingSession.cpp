@@ -0,0 +1,229 @@
+#include "TrackingSession.h"
+#include "TrackingDevice.h"
+#include "TrackingThread.h"
+#include "TrackingLog.h"
+
+#include <QMutexLocker>
+
+#include "igstkTransform.h"
+#include "igstkTimeStamp.h"
+
+#include <iostream>
+#include <algorithm>
+
+TrackingSession::TrackingSession()
+	: trackingLog(0)
+{
+	merged.time = -1;
+	merged.readTime = -1;
+	merged.numberOfTools = 0;
+}
+
+TrackingSession::~TrackingSession()
+{
+	stopTracking();
+}
+
+void TrackingSession::addDevice(TrackingDevice * device)
+{
+	firstTools.push_back(getNumberofTools());
+	devices.push_back(device);
+
+	Registration identity;
+	for(int i = 0; i < 9; i++)
+		identity.rotation[i] = i%4 == 0 ? 1 : 0;
+	for(int i = 0; i < 3; i++)
+		identity.translation[i] = 0;
+	registrations.push_back(identity);
+
+	if(getNumberofTools() > TRACKING_SAMPLE_MAX_TOOLS)
+		std::cout<<"	Only the first "<<TRACKING_SAMPLE_MAX_TOOLS<<" tools are tracked"<<std::endl;
+}
+
+int TrackingSession::getNumberOfDevices()
+{
+	return devices.size();
+}
+
+TrackingDevice * TrackingSession::getDevice(int device)
+{
+	return devices.at(device);
+}
+
+void TrackingSession::setRegistration(int device, const double rotation[9], const double translation[3])
+{
+	{
+		QMutexLocker locker(&mergeMutex);
+		Registration & registration = registrations.at(device);
+		for(int i = 0; i < 9; i++)
+			registration.rotation[i] = rotation[i];
+		for(int i = 0; i < 3; i++)
+			registration.translation[i] = translation[i];
+	}
+
+	if(device == 0)
+		return;
+
+	igstk::Transform::VersorType::MatrixType matrix;
+	igstk::Transform::VectorType vector;
+	for(int i = 0; i < 3; i++)
+	{
+		vector[i] = translation[i];
+		for(int j = 0; j < 3; j++)
+			matrix(i,j) = rotation[3*i + j];
+	}
+
+	igstk::Transform::VersorType versor;
+	versor.Set(matrix);
+
+	igstk::Transform transform;
+	transform.SetTranslationAndRotation(vector, versor, 0, igstk::TimeStamp::GetLongestPossibleTime());
+
+	QMutexLocker deviceLocker(devices[device]->getMutex());
+	devices[device]->getIGSTKTracker()->RequestSetTransformAndParent(transform, devices[0]->getIGSTKTracker());
+}
+
+int TrackingSession::getNumberofTools()
+{
+	int tools = 0;
+	for(unsigned int d = 0; d < devices.size(); d++)
+		tools += devices[d]->getNumberofTools();
+
+	return tools;
+}
+
+int TrackingSession::getToolIndex(std::string name)
+{
+	for(unsigned int d = 0; d < devices.size(); d++)
+	{
+		int tool = devices[d]->getToolIndex(name);
+		if(tool >= 0)
+			return firstTools[d] + tool;
+	}
+
+	return -1;
+}
+
+std::string TrackingSession::getToolName(int tool)
+{
+	if(tool < 0)
+		return "";
+
+	for(int d = devices.size() - 1; d >= 0; d--)
+		if(tool >= firstTools[d])
+			return devices[d]->getToolName(tool - firstTools[d]);
+
+	return "";
+}
+
+igstk::TrackerTool * TrackingSession::getTrackerTool(int tool)
+{
+	if(tool < 0)
+		return 0;
+
+	for(int d = devices.size() - 1; d >= 0; d--)
+		if(tool >= firstTools[d])
+			return devices[d]->getTrackerTool(tool - firstTools[d]);
+
+	return 0;
+}
+
+void TrackingSession::setTrackingLog(TrackingLog * trackingLog)
+{
+	this->trackingLog = trackingLog;
+}
+
+bool TrackingSession::startTracking()
+{
+	stopTracking();
+
+	{
+		QMutexLocker locker(&mergeMutex);
+		merged.time = -1;
+		merged.readTime = -1;
+		merged.numberOfTools = std::min(getNumberofTools(), TRACKING_SAMPLE_MAX_TOOLS);
+		for(int t = 0; t < merged.numberOfTools; t++)
+		{
+			merged.valid[t] = false;
+			merged.toolTime[t] = -1;
+		}
+	}
+
+	for(unsigned int d = 0; d < devices.size(); d++)
+	{
+		std::cout<<"	Starting "<<devices[d]->getDeviceName()<<std::endl;
+
+		TrackingThread * thread = new TrackingThread(this, d);
+		if(!thread->startTracking())
+		{
+			thread->wait();
+			delete thread;
+			stopTracking();
+			return false;
+		}
+
+		threads.push_back(thread);
+	}
+
+	return true;
+}
+
+void TrackingSession::stopTracking()
+{
+	for(unsigned int d = 0; d < threads.size(); d++)
+	{
+		threads[d]->stopTracking();
+		delete threads[d];
+	}
+
+	threads.clear();
+}
+
+PoseRing * TrackingSession::getRing()
+{
+	return &ring;
+}
+
+void TrackingSession::addSample(int device, const TrackingSample & sample)
+{
+	QMutexLocker locker(&mergeMutex);
+
+	const Registration & registration = registrations[device];
+	int first = firstTools[device];
+
+	for(int t = 0; t < sample.numberOfTools && first + t < merged.numberOfTools; t++)
+	{
+		int tool = first + t;
+
+		merged.valid[tool] = sample.valid[t];
+		if(!sample.valid[t])
+			continue;
+
+		merged.toolTime[tool] = sample.toolTime[t];
+
+		// pose of the tool in the coordinates of the first device
+		const double * R = registration.rotation;
+		for(int i = 0; i < 3; i++)
+		{
+			merged.translation[tool][i] = registration.translation[i];
+			for(int k = 0; k < 3; k++)
+				merged.translation[tool][i] += R[3*i + k]*sample.translation[t][k];
+
+			for(int j = 0; j < 3; j++)
+			{
+				merged.rotation[tool][3*i + j] = 0;
+				for(int k = 0; k < 3; k++)
+					merged.rotation[tool][3*i + j] += R[3*i + k]*sample.rotation[t][3*k + j];
+			}
+		}
+	}
+
+	merged.time = sample.time;
+	merged.readTime = sample.readTime;
+
+	ring.push(merged);
+
+	// queued for the log thread, a full log drops the sample instead of waiting
+	if(trackingLog)
+		trackingLog->logSample(merged);
+}
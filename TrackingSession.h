@@ -0,0 +1,138 @@
+#ifndef TRACKINGSESSION_H
+#define TRACKINGSESSION_H
+
+#include <QMutex>
+
+#include "PoseRing.h"
+#include "TrackingSample.h"
+
+#include <string>
+#include <vector>
+
+#include "igstkTrackerTool.h"
+
+class TrackingDevice;
+class TrackingThread;
+class TrackingLog;
+
+//!Tracking with several devices at the same time
+/*!
+  The tools of all the devices are numbered in the order the devices were added, the tools of the
+  first device first, and they are found by name. Each device is polled by its own
+  TrackingThread, which only updates and locks its own device, so a slow device does not lower
+  the update rate of the others, they only share the short merge of the samples. Each snapshot of
+  a device is merged with the last poses of the other devices in one TrackingSample, transformed
+  to the coordinates of the first device, and pushed to a single PoseRing, so the readers see one
+  stream of timestamped samples of all the tools. Only the tools of the device that produced the
+  sample have a new toolTime, the others repeat their last pose.
+*/
+class TrackingSession
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static TrackingSession *New()
+	{
+			return new TrackingSession;
+	}
+
+	~TrackingSession();
+
+    /**
+     * \brief Add a configured device with its tools attached, before tracking
+     */
+	void addDevice(TrackingDevice *);
+
+    /**
+     * \brief Returns the number of devices
+     */
+	int getNumberOfDevices();
+
+    /**
+     * \brief Returns a device
+     */
+	TrackingDevice * getDevice(int);
+
+    /**
+     * \brief Set the pose of a device in the coordinates of the first device, the identity by default
+     * The IGSTK tracker of the device is attached to the tracker of the first device with the same
+     * transform, so the objects of its tools are shown in the common coordinates.
+     * \param[in] device number, rotation matrix row major and translation
+     */
+	void setRegistration(int, const double[9], const double[3]);
+
+    /**
+     * \brief Returns the number of tools of all the devices
+     */
+	int getNumberofTools();
+
+    /**
+     * \brief Returns the number of the tool with a name in the samples, -1 if there is none
+     */
+	int getToolIndex(std::string);
+
+    /**
+     * \brief Returns the name of a tool
+     */
+	std::string getToolName(int);
+
+    /**
+     * \brief Returns a tool, NULL if there is none
+     * \param[in] number of the tool in the samples
+     */
+	igstk::TrackerTool * getTrackerTool(int);
+
+    /**
+     * \brief Set the binary log of the merged samples
+     * \param[in] open log, NULL to not log
+     */
+	void setTrackingLog(TrackingLog *);
+
+    /**
+     * \brief Start tracking all the devices, each in its thread
+     * \return false if a device could not be started, the other devices are stopped
+     */
+	bool startTracking();
+
+    /**
+     * \brief Stop tracking all the devices and wait for their threads
+     */
+	void stopTracking();
+
+    /**
+     * \brief Returns the ring with the merged samples
+     */
+	PoseRing * getRing();
+
+    /**
+     * \brief Merge a snapshot of a device and push it, called by the tracking threads
+     * \param[in] device number and its snapshot in the device coordinates
+     */
+	void addSample(int, const TrackingSample &);
+
+private:
+
+	TrackingSession();
+
+	/** Pose of a device in the common coordinates */
+	struct Registration
+	{
+		double rotation[9]; ///<Rotation matrix row major
+		double translation[3]; ///<Translation
+	};
+
+	std::vector<TrackingDevice *> devices; ///<Devices in the order they were added
+	std::vector<int> firstTools; ///<Number of the first tool of each device in the samples
+	std::vector<Registration> registrations; ///<Pose of each device in the common coordinates
+	std::vector<TrackingThread *> threads; ///<Acquisition thread of each device while tracking
+
+	QMutex mergeMutex; ///<The threads merge one sample at a time, the ring has a single writer
+	TrackingSample merged; ///<Last poses of all the tools
+	PoseRing ring; ///<Merged samples
+	TrackingLog * trackingLog; ///<Binary log of the merged samples, NULL to not log
+};
+
+#endif // TRACKINGSESSION_H
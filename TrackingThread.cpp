@@ -0,0 +1,76 @@
+#include "TrackingThread.h"
+#include "TrackingSession.h"
+#include "TrackingDevice.h"
+
+#include <QMutexLocker>
+
+TrackingThread::TrackingThread(TrackingSession * session, int device)
+	: session(session), device(device), trackingDevice(session->getDevice(device)),
+	started(false), finished(false), stopRequested(false)
+{
+}
+
+bool TrackingThread::startTracking()
+{
+	stopRequested = false;
+	started = false;
+	finished = false;
+
+	start(QThread::HighPriority);
+
+	QMutexLocker locker(&mutex);
+	while(!finished)
+		startedCondition.wait(&mutex);
+
+	return started;
+}
+
+void TrackingThread::stopTracking()
+{
+	stopRequested = true;
+	wait();
+}
+
+void TrackingThread::run()
+{
+	bool ok;
+	{
+		QMutexLocker deviceLocker(trackingDevice->getMutex());
+		ok = trackingDevice->startTracking();
+	}
+
+	{
+		QMutexLocker locker(&mutex);
+		started = ok;
+		finished = true;
+		startedCondition.wakeAll();
+	}
+
+	if(!ok)
+		return;
+
+	TrackingSample sample;
+	double lastTime = -1;
+
+	while(!stopRequested){
+
+		bool updated;
+		{
+			QMutexLocker deviceLocker(trackingDevice->getMutex());
+			trackingDevice->updateStatus();
+			updated = trackingDevice->getSnapshot(sample) && sample.time != lastTime;
+		}
+
+		if(updated)
+		{
+			lastTime = sample.time;
+			session->addSample(device, sample);
+		}
+
+		// the tracker updates at 60 Hz, the thread sleeps between the pulses
+		msleep(1);
+	}
+
+	QMutexLocker deviceLocker(trackingDevice->getMutex());
+	trackingDevice->stopTracking();
+}
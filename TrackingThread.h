@@ -0,0 +1,63 @@
+#ifndef TRACKINGTHREAD_H
+#define TRACKINGTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+class TrackingSession;
+class TrackingDevice;
+
+//!Acquisition thread of a tracking device
+/*!
+  This thread owns one device of a TrackingSession while tracking: it starts tracking, updates the
+  tools of its tracker, without the global IGSTK pulse dispatch, reads a snapshot of all the tools of the device in each tracker update and
+  passes one TrackingSample for each update to the session, which merges it with the other devices
+  in its PoseRing, so the tracking rate does not depend on the rendering, the user interface or
+  the other devices. Rendering, recording and reconstruction read the ring at their own pace.
+  IGSTK objects are not thread safe, any other thread that calls the device while this thread
+  runs must hold TrackingDevice::getMutex(). Each thread only locks and updates its own device, so
+  the devices do not wait for each other. The scene never uses the trackers while tracking, it is
+  placed and rendered by the user interface thread from the ring. The devices read their serial
+  or USB replies in the IGSTK tracker threads, the mutex is only held to copy the transforms.
+*/
+class TrackingThread : public QThread
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     * \param[in] session and number of its device, configured with its tools attached and their observers
+     */
+	TrackingThread(TrackingSession *, int);
+
+    /**
+     * \brief Start tracking in the thread and wait until it started
+     * \return false if tracking could not be started
+     */
+	bool startTracking();
+
+    /**
+     * \brief Stop tracking and wait for the thread to finish
+     */
+	void stopTracking();
+
+protected:
+
+	void run();
+
+private:
+
+	TrackingSession * session; ///<Session that merges the samples
+	int device; ///<Number of the device in the session
+	TrackingDevice * trackingDevice; ///<The tracker
+
+	QMutex mutex; ///<Protects the state flags
+	QWaitCondition startedCondition; ///<Signaled when tracking started or failed
+	bool started; ///<Tracking started
+	bool finished; ///<Start finished, with or without success
+	volatile bool stopRequested; ///<The thread must stop
+};
+
+#endif // TRACKINGTHREAD_H
@@ -0,0 +1,212 @@
+#include "VolumeCache.h"
+
+#include <vtkMetaImageReader.h>
+#include <vtkMetaImageWriter.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <iostream>
+
+/** Change this value if the reconstruction method changes, so old volumes are not used */
+static const char * cacheVersion = "VolumeReconstruction-1";
+
+VolumeCache::VolumeCache()
+{
+	cacheDirectory = QDir::homePath() + "/.TrackingVolumeCache";
+	maximumSize = qint64(2048)*1024*1024;
+	readIndex();
+}
+
+void VolumeCache::setCacheDirectory(QString cacheDirectory)
+{
+	this->cacheDirectory = cacheDirectory;
+	readIndex();
+}
+
+void VolumeCache::setMaximumSize(qint64 maximumSize)
+{
+	this->maximumSize = maximumSize;
+}
+
+QString VolumeCache::computeKey(std::vector< vtkSmartPointer<vtkImageData> > images,
+								std::vector< vnl_matrix<double> > transforms,
+								vnl_vector<double> scale, int resolution, QString method,
+								vnl_vector<double> origin, vnl_vector<double> size)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+
+	hash.addData(cacheVersion);
+	hash.addData(method.toAscii());
+	hash.addData((const char *)&resolution, sizeof(int));
+	hash.addData((const char *)scale.data_block(), scale.size()*sizeof(double));
+	hash.addData((const char *)origin.data_block(), origin.size()*sizeof(double));
+	hash.addData((const char *)size.data_block(), size.size()*sizeof(double));
+
+	for(unsigned int i=0; i<transforms.size(); i++)
+		hash.addData((const char *)transforms.at(i).data_block(), transforms.at(i).size()*sizeof(double));
+
+	for(unsigned int i=0; i<images.size(); i++){
+
+		vtkImageData * image = images.at(i);
+		int * dims = image->GetDimensions();
+		int scalarType = image->GetScalarType();
+
+		hash.addData((const char *)dims, 3*sizeof(int));
+		hash.addData((const char *)&scalarType, sizeof(int));
+		hash.addData((const char *)image->GetScalarPointer(),
+					 image->GetNumberOfPoints()*image->GetNumberOfScalarComponents()*image->GetScalarSize());
+	}
+
+	return QString(hash.result().toHex());
+}
+
+bool VolumeCache::load(QString key, vtkSmartPointer<vtkImageData> &volume,
+					   vtkSmartPointer<vtkImageData> &weights)
+{
+	if(!index.contains(key))
+		return false;
+
+	if(!QFile::exists(filePath(key, ".mhd")) || !QFile::exists(filePath(key, "_weights.mhd"))){
+		index.remove(key);
+		writeIndex();
+		return false;
+	}
+
+	std::cout<<std::endl<<"Loading cached volume "<<key.toAscii().data()<<std::endl;
+
+	volume = readImage(filePath(key, ".mhd"));
+	weights = readImage(filePath(key, "_weights.mhd"));
+
+	index[key].lastUsed = QDateTime::currentDateTime().toTime_t();
+	writeIndex();
+
+	return true;
+}
+
+void VolumeCache::store(QString key, vtkSmartPointer<vtkImageData> volume,
+						vtkSmartPointer<vtkImageData> weights)
+{
+	QDir().mkpath(cacheDirectory);
+
+	std::cout<<std::endl<<"Storing volume in cache "<<key.toAscii().data()<<std::endl;
+
+	writeImage(volume, filePath(key, ".mhd"), filePath(key, ".raw"));
+	writeImage(weights, filePath(key, "_weights.mhd"), filePath(key, "_weights.raw"));
+
+	Entry entry;
+	entry.lastUsed = QDateTime::currentDateTime().toTime_t();
+	entry.size = QFileInfo(filePath(key, ".mhd")).size() + QFileInfo(filePath(key, ".raw")).size()
+		+ QFileInfo(filePath(key, "_weights.mhd")).size() + QFileInfo(filePath(key, "_weights.raw")).size();
+
+	index.insert(key, entry);
+
+	evict();
+	writeIndex();
+}
+
+void VolumeCache::evict()
+{
+	qint64 totalSize = 0;
+
+	QMap<QString, Entry>::const_iterator it;
+	for(it = index.constBegin(); it != index.constEnd(); ++it)
+		totalSize += it.value().size;
+
+	while(totalSize > maximumSize && index.size() > 1){
+
+		QString oldestKey = index.constBegin().key();
+		for(it = index.constBegin(); it != index.constEnd(); ++it){
+			if(it.value().lastUsed < index.value(oldestKey).lastUsed)
+				oldestKey = it.key();
+		}
+
+		std::cout<<"Removing cached volume "<<oldestKey.toAscii().data()<<std::endl;
+
+		QFile::remove(filePath(oldestKey, ".mhd"));
+		QFile::remove(filePath(oldestKey, ".raw"));
+		QFile::remove(filePath(oldestKey, "_weights.mhd"));
+		QFile::remove(filePath(oldestKey, "_weights.raw"));
+
+		totalSize -= index.value(oldestKey).size;
+		index.remove(oldestKey);
+	}
+}
+
+void VolumeCache::readIndex()
+{
+	index.clear();
+
+	QFile file(cacheDirectory + "/index.txt");
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return;
+
+	QTextStream stream(&file);
+	while(!stream.atEnd())
+	{
+		QStringList lineList = stream.readLine().split(" ");
+		if(lineList.size() != 3)
+			continue;
+
+		Entry entry;
+		entry.lastUsed = lineList.at(1).toUInt();
+		entry.size = lineList.at(2).toLongLong();
+		index.insert(lineList.at(0), entry);
+	}
+
+	file.close();
+}
+
+void VolumeCache::writeIndex()
+{
+	QFile file(cacheDirectory + "/index.txt");
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+		std::cout<<"Could not write the volume cache index"<<std::endl;
+		return;
+	}
+
+	QTextStream out(&file);
+
+	QMap<QString, Entry>::const_iterator it;
+	for(it = index.constBegin(); it != index.constEnd(); ++it)
+		out<<it.key()<<" "<<it.value().lastUsed<<" "<<it.value().size<<"\n";
+
+	file.close();
+}
+
+QString VolumeCache::filePath(QString key, QString suffix)
+{
+	return cacheDirectory + "/" + key + suffix;
+}
+
+vtkSmartPointer<vtkImageData> VolumeCache::readImage(QString filename)
+{
+	vtkSmartPointer<vtkMetaImageReader> reader = vtkSmartPointer<vtkMetaImageReader>::New();
+	reader->SetFileName(filename.toAscii().data());
+	reader->Update();
+
+	vtkSmartPointer<vtkImageData> image = reader->GetOutput();
+	return image;
+}
+
+void VolumeCache::writeImage(vtkSmartPointer<vtkImageData> image, QString mhdFilename, QString rawFilename)
+{
+	std::string mhdFile = std::string(mhdFilename.toAscii().data());
+	std::string rawFile = std::string(rawFilename.toAscii().data());
+
+	vtkSmartPointer<vtkMetaImageWriter> writer = vtkSmartPointer<vtkMetaImageWriter>::New();
+	writer->SetFileName(mhdFile.c_str());
+	writer->SetRAWFileName(rawFile.c_str());
+	writer->SetCompression(false);
+	writer->SetInputConnection(image->GetProducerPort());
+
+	try{
+	writer->Write();
+	}catch( std::exception& e){
+		std::cout<<e.what()<<std::endl;
+	}
+}
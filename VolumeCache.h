@@ -0,0 +1,117 @@
+#ifndef VOLUMECACHE_H
+#define VOLUMECACHE_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <QString>
+#include <QMap>
+
+#include <vector>
+
+//!On disk cache of reconstructed volumes
+/*!
+  This class keeps the volumes generated by VolumeReconstruction.h in a directory as .mhd and .raw files.
+  Each volume is stored under a key that is the hash of all the reconstruction inputs: the content
+  of the images, the transformation of each image (tracker and calibration data), the scale, the
+  resolution, the method and the volume origin and size. A repeated reconstruction with the same
+  inputs is read from disk instead of computed. When the cache grows over its maximum size the
+  least recently used volumes are deleted.
+*/
+class VolumeCache
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static VolumeCache *New()
+	{
+			return new VolumeCache;
+	}
+
+    /**
+     * \brief Set the directory where the volumes are stored
+     */
+	void setCacheDirectory(QString);
+
+    /**
+     * \brief Set the maximum size of the cache in bytes
+     */
+	void setMaximumSize(qint64);
+
+    /**
+     * \brief Computes the key of a reconstruction from all its inputs
+     * \param[in] images, transformations, scale, resolution, method name, volume origin and volume size
+     */
+	QString computeKey(std::vector< vtkSmartPointer<vtkImageData> >, std::vector< vnl_matrix<double> >,
+					   vnl_vector<double>, int, QString, vnl_vector<double>, vnl_vector<double>);
+
+    /**
+     * \brief Load a cached volume and its weights
+     * \param[out] true if the key was found in the cache
+     */
+	bool load(QString, vtkSmartPointer<vtkImageData> &, vtkSmartPointer<vtkImageData> &);
+
+    /**
+     * \brief Store a volume and its weights under the given key
+     */
+	void store(QString, vtkSmartPointer<vtkImageData>, vtkSmartPointer<vtkImageData>);
+
+private:
+
+	VolumeCache();
+
+    /** Last use and size of a cached volume */
+	struct Entry
+	{
+		uint lastUsed;
+		qint64 size;
+	};
+
+    /** Directory of the cache */
+	QString cacheDirectory;
+
+    /** Maximum size of the cache in bytes */
+	qint64 maximumSize;
+
+    /** The cached volumes */
+	QMap<QString, Entry> index;
+
+    /**
+     * \brief Read the index file of the cache directory
+     */
+	void readIndex();
+
+    /**
+     * \brief Write the index file of the cache directory
+     */
+	void writeIndex();
+
+    /**
+     * \brief Delete the least recently used volumes until the cache fits its maximum size
+     */
+	void evict();
+
+    /**
+     * \brief Returns the path of a cached file
+     */
+	QString filePath(QString key, QString suffix);
+
+    /**
+     * \brief Read a .mhd file
+     */
+	vtkSmartPointer<vtkImageData> readImage(QString);
+
+    /**
+     * \brief Write a .mhd and .raw file
+     */
+	void writeImage(vtkSmartPointer<vtkImageData>, QString, QString);
+
+};
+
+#endif // VOLUMECACHE_H
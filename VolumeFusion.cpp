@@ -0,0 +1,358 @@
+#include "VolumeFusion.h"
+
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <math.h>
+#include <time.h>
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+
+/** Linear interpolation of a float buffer, the point must be inside the buffer */
+float sampleBuffer(const std::vector<float> &buffer, const int *dims, double x, double y, double z)
+{
+	int i0 = dims[0] > 1 ? std::max(0, std::min((int)floor(x), dims[0]-2)) : 0;
+	int j0 = dims[1] > 1 ? std::max(0, std::min((int)floor(y), dims[1]-2)) : 0;
+	int k0 = dims[2] > 1 ? std::max(0, std::min((int)floor(z), dims[2]-2)) : 0;
+
+	int di = dims[0] > 1 ? 1 : 0;
+	int dj = dims[1] > 1 ? dims[0] : 0;
+	int dk = dims[2] > 1 ? dims[0]*dims[1] : 0;
+
+	double fx = di ? x - i0 : 0;
+	double fy = dj ? y - j0 : 0;
+	double fz = dk ? z - k0 : 0;
+
+	const float *p = &buffer[0] + (k0*dims[1] + j0)*dims[0] + i0;
+
+	double c00 = p[0]*(1-fx) + p[di]*fx;
+	double c10 = p[dj]*(1-fx) + p[dj+di]*fx;
+	double c01 = p[dk]*(1-fx) + p[dk+di]*fx;
+	double c11 = p[dk+dj]*(1-fx) + p[dk+dj+di]*fx;
+
+	double c0 = c00*(1-fy) + c10*fy;
+	double c1 = c01*(1-fy) + c11*fy;
+
+	return c0*(1-fz) + c1*fz;
+}
+
+/** Accumulates one sweep in a slab of the grid */
+class FusionSlabTask : public QRunnable
+{
+public:
+
+	FusionSlabTask(VolumeFusion::Grid *grid, const VolumeFusion::Sweep *sweep,
+				   const int *lower, const int *upper, int firstSlice, int lastSlice)
+		: grid(grid), sweep(sweep), firstSlice(firstSlice), lastSlice(lastSlice)
+	{
+		for(int d=0; d<3; d++){
+			this->lower[d] = lower[d];
+			this->upper[d] = upper[d];
+		}
+	}
+
+	void run()
+	{
+		const int *dims = grid->dimensions;
+
+		for(int k=firstSlice; k<=lastSlice; k++){
+
+			double z = (grid->origin[2] + k*grid->spacing - sweep->origin[2])/sweep->spacing[2];
+
+			for(int j=lower[1]; j<=upper[1]; j++){
+
+				double y = (grid->origin[1] + j*grid->spacing - sweep->origin[1])/sweep->spacing[1];
+				int idx = (k*dims[1] + j)*dims[0] + lower[0];
+
+				for(int i=lower[0]; i<=upper[0]; i++, idx++){
+
+					double x = (grid->origin[0] + i*grid->spacing - sweep->origin[0])/sweep->spacing[0];
+
+					float w = sampleBuffer(sweep->weights, sweep->dimensions, x, y, z);
+
+					if(w > 0){
+						grid->accumulator[idx] += sampleBuffer(sweep->accumulator, sweep->dimensions, x, y, z);
+						grid->weights[idx] += w;
+					}
+				}
+			}
+		}
+	}
+
+private:
+
+	VolumeFusion::Grid *grid;
+	const VolumeFusion::Sweep *sweep;
+	int lower[3];
+	int upper[3];
+	int firstSlice;
+	int lastSlice;
+};
+
+/** Copy the scalars of an image in a float buffer and fill the sweep geometry */
+void imageToBuffer(vtkImageData *image, vnl_vector<double> origin,
+				   std::vector<float> &buffer, VolumeFusion::Sweep &sweep)
+{
+	image->GetDimensions(sweep.dimensions);
+	image->GetSpacing(sweep.spacing);
+	sweep.origin[0] = origin[0];
+	sweep.origin[1] = origin[1];
+	sweep.origin[2] = origin[2];
+
+	vtkDataArray *scalars = image->GetPointData()->GetScalars();
+	vtkIdType n = scalars->GetNumberOfTuples();
+
+	buffer.resize(n);
+	for(vtkIdType i=0; i<n; i++)
+		buffer[i] = scalars->GetComponent(i, 0);
+}
+
+}
+
+
+VolumeFusion::VolumeFusion()
+{
+	numberOfSweeps = 0;
+	slabThickness = 4;
+	numberOfThreads = QThread::idealThreadCount();
+	grid.dimensions[0] = grid.dimensions[1] = grid.dimensions[2] = 0;
+	grid.spacing = 0;
+}
+
+void VolumeFusion::setOutputGrid(vnl_vector<double> origin, double spacing, vnl_vector<double> size)
+{
+	for(int d=0; d<3; d++){
+		grid.origin[d] = origin[d];
+		grid.dimensions[d] = (int)size[d];
+	}
+	grid.spacing = spacing;
+
+	int n = grid.dimensions[0]*grid.dimensions[1]*grid.dimensions[2];
+	grid.accumulator.assign(n, 0);
+	grid.weights.assign(n, 0);
+}
+
+void VolumeFusion::addVolume(vtkSmartPointer<vtkImageData> volume,
+							 vtkSmartPointer<vtkImageData> weights, vnl_vector<double> origin)
+{
+	Sweep sweep;
+	std::vector<float> values;
+
+	imageToBuffer(volume, origin, values, sweep);
+
+	if(weights.GetPointer() != NULL){
+		imageToBuffer(weights, origin, sweep.weights, sweep);
+	}else{
+		// voxels without data are left in zero by the reconstruction
+		sweep.weights.resize(values.size());
+		for(size_t i=0; i<values.size(); i++)
+			sweep.weights[i] = values[i] > 0 ? 1 : 0;
+	}
+
+	sweep.accumulator.resize(values.size());
+	for(size_t i=0; i<values.size(); i++)
+		sweep.accumulator[i] = values[i]*sweep.weights[i];
+
+	addSweep(sweep);
+}
+
+void VolumeFusion::addAccumulator(vtkSmartPointer<vtkImageData> accumulator,
+								  vtkSmartPointer<vtkImageData> weights, vnl_vector<double> origin)
+{
+	Sweep sweep;
+
+	imageToBuffer(accumulator, origin, sweep.accumulator, sweep);
+	imageToBuffer(weights, origin, sweep.weights, sweep);
+
+	addSweep(sweep);
+}
+
+void VolumeFusion::addSweep(const Sweep &sweep)
+{
+	std::cout<<std::endl<<"Fusing sweep "<<numberOfSweeps+1<<std::endl;
+	clock_t begin = clock();
+
+	double lowerBounds[3];
+	double upperBounds[3];
+
+	for(int d=0; d<3; d++){
+		lowerBounds[d] = sweep.origin[d];
+		upperBounds[d] = sweep.origin[d] + (sweep.dimensions[d]-1)*sweep.spacing[d];
+	}
+
+	if(grid.accumulator.empty()){
+		for(int d=0; d<3; d++){
+			grid.origin[d] = sweep.origin[d];
+			grid.dimensions[d] = sweep.dimensions[d];
+		}
+		grid.spacing = sweep.spacing[0];
+
+		int n = grid.dimensions[0]*grid.dimensions[1]*grid.dimensions[2];
+		grid.accumulator.assign(n, 0);
+		grid.weights.assign(n, 0);
+	}else{
+		growGrid(lowerBounds, upperBounds);
+	}
+
+	// voxels of the grid covered by the sweep
+	int lower[3];
+	int upper[3];
+
+	for(int d=0; d<3; d++){
+		lower[d] = std::max(0, (int)ceil((lowerBounds[d] - grid.origin[d])/grid.spacing));
+		upper[d] = std::min(grid.dimensions[d]-1, (int)floor((upperBounds[d] - grid.origin[d])/grid.spacing));
+
+		if(upper[d] < lower[d]){
+			std::cout<<"Sweep does not overlap the fused volume"<<std::endl;
+			return;
+		}
+	}
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(numberOfThreads);
+
+	for(int k=lower[2]; k<=upper[2]; k+=slabThickness){
+		int last = std::min(k + slabThickness - 1, upper[2]);
+		pool.start(new FusionSlabTask(&grid, &sweep, lower, upper, k, last));
+	}
+
+	pool.waitForDone();
+
+	numberOfSweeps++;
+
+	clock_t end = clock();
+	std::cout<<"Voxels updated: "<<(upper[0]-lower[0]+1)*(upper[1]-lower[1]+1)*(upper[2]-lower[2]+1)<<std::endl;
+	std::cout<<"Time elapsed: "<<double(end - begin)*1000/CLOCKS_PER_SEC<<" ms"<<std::endl;
+}
+
+void VolumeFusion::growGrid(const double *lowerBounds, const double *upperBounds)
+{
+	int shift[3];
+	int newDimensions[3];
+	bool grow = false;
+
+	for(int d=0; d<3; d++){
+		shift[d] = std::max(0, (int)ceil((grid.origin[d] - lowerBounds[d])/grid.spacing));
+		int last = (int)ceil((upperBounds[d] - grid.origin[d])/grid.spacing);
+		newDimensions[d] = std::max(grid.dimensions[d], last + 1) + shift[d];
+
+		if(newDimensions[d] != grid.dimensions[d])
+			grow = true;
+	}
+
+	if(!grow)
+		return;
+
+	std::cout<<"Enlarging fused volume to "<<newDimensions[0]<<","<<newDimensions[1]<<","<<newDimensions[2]<<std::endl;
+
+	int n = newDimensions[0]*newDimensions[1]*newDimensions[2];
+	std::vector<float> accumulator(n, 0);
+	std::vector<float> weights(n, 0);
+
+	for(int k=0; k<grid.dimensions[2]; k++){
+		for(int j=0; j<grid.dimensions[1]; j++){
+			int from = (k*grid.dimensions[1] + j)*grid.dimensions[0];
+			int to = ((k+shift[2])*newDimensions[1] + j+shift[1])*newDimensions[0] + shift[0];
+			std::copy(grid.accumulator.begin()+from, grid.accumulator.begin()+from+grid.dimensions[0],
+					  accumulator.begin()+to);
+			std::copy(grid.weights.begin()+from, grid.weights.begin()+from+grid.dimensions[0],
+					  weights.begin()+to);
+		}
+	}
+
+	for(int d=0; d<3; d++){
+		grid.origin[d] -= shift[d]*grid.spacing;
+		grid.dimensions[d] = newDimensions[d];
+	}
+
+	grid.accumulator.swap(accumulator);
+	grid.weights.swap(weights);
+}
+
+vtkSmartPointer<vtkImageData> VolumeFusion::getFusedVolume()
+{
+	vtkSmartPointer<vtkImageData> volumeData = vtkSmartPointer<vtkImageData>::New();
+	volumeData->SetNumberOfScalarComponents(1);
+	volumeData->SetScalarType(VTK_UNSIGNED_CHAR);
+	volumeData->SetOrigin(0,0,0);
+	volumeData->SetDimensions(grid.dimensions);
+	volumeData->SetSpacing(grid.spacing,grid.spacing,grid.spacing);
+	volumeData->AllocateScalars();
+
+	unsigned char *voxel = static_cast<unsigned char *>(volumeData->GetScalarPointer());
+
+	for(size_t i=0; i<grid.accumulator.size(); i++){
+		double value = 0;
+		if(grid.weights[i] > 0)
+			value = grid.accumulator[i]/grid.weights[i];
+		voxel[i] = (unsigned char)std::min(255.0, std::max(0.0, value + 0.5));
+	}
+
+	return volumeData;
+}
+
+vtkSmartPointer<vtkImageData> VolumeFusion::gridToImage(const std::vector<float> &buffer)
+{
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->SetNumberOfScalarComponents(1);
+	image->SetScalarType(VTK_FLOAT);
+	image->SetOrigin(0,0,0);
+	image->SetDimensions(grid.dimensions);
+	image->SetSpacing(grid.spacing,grid.spacing,grid.spacing);
+	image->AllocateScalars();
+
+	std::copy(buffer.begin(), buffer.end(), static_cast<float *>(image->GetScalarPointer()));
+
+	return image;
+}
+
+vtkSmartPointer<vtkImageData> VolumeFusion::getAccumulatorVolume()
+{
+	return gridToImage(grid.accumulator);
+}
+
+vtkSmartPointer<vtkImageData> VolumeFusion::getWeightVolume()
+{
+	return gridToImage(grid.weights);
+}
+
+vnl_vector<double> VolumeFusion::getVolumeOrigin()
+{
+	vnl_vector<double> origin;
+	origin.set_size(3);
+	origin[0] = grid.origin[0];
+	origin[1] = grid.origin[1];
+	origin[2] = grid.origin[2];
+
+	return origin;
+}
+
+int VolumeFusion::getNumberOfSweeps()
+{
+	return numberOfSweeps;
+}
+
+void VolumeFusion::setSlabThickness(int slabThickness)
+{
+	this->slabThickness = std::max(1, slabThickness);
+}
+
+void VolumeFusion::setNumberOfThreads(int numberOfThreads)
+{
+	this->numberOfThreads = std::max(1, numberOfThreads);
+}
+
+void VolumeFusion::clear()
+{
+	grid.accumulator.clear();
+	grid.weights.clear();
+	grid.dimensions[0] = grid.dimensions[1] = grid.dimensions[2] = 0;
+	numberOfSweeps = 0;
+}
@@ -0,0 +1,144 @@
+#ifndef VOLUMEFUSION_H
+#define VOLUMEFUSION_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vnl/vnl_vector.h>
+
+#include <vector>
+
+//!Fuse several reconstructed volumes in one grid
+/*!
+  This class merges several overlapping sweeps of the same region into one volume using
+  weighted compounding. The grid keeps a running sum of weighted intensities and a running
+  sum of weights, so each new sweep only visits the voxels it covers. The covered voxels are
+  split in slabs along z that are processed in parallel.
+  A sweep can be added as a reconstructed volume with its weights (VolumeReconstruction.h)
+  or as an accumulator and weight pair, for example the output of another VolumeFusion.
+*/
+class VolumeFusion
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static VolumeFusion *New()
+	{
+			return new VolumeFusion;
+	}
+
+    /**
+     * \brief Set the output grid. If it is not set, the first sweep defines it
+     * \param[in] origin of the grid in the 3D scene, spacing of the voxels and size of the grid
+     */
+	void setOutputGrid(vnl_vector<double>, double, vnl_vector<double>);
+
+    /**
+     * \brief Add a reconstructed volume to the fusion
+     * \param[in] volume data, weight of each voxel (can be NULL) and origin of the volume in the 3D scene
+     */
+	void addVolume(vtkSmartPointer<vtkImageData>, vtkSmartPointer<vtkImageData>, vnl_vector<double>);
+
+    /**
+     * \brief Add an accumulator and weight pair to the fusion
+     * \param[in] sum of weighted intensities, sum of weights and origin in the 3D scene
+     */
+	void addAccumulator(vtkSmartPointer<vtkImageData>, vtkSmartPointer<vtkImageData>, vnl_vector<double>);
+
+    /**
+     * \brief Returns the fused volume data, the accumulator divided by the weights
+     */
+	vtkSmartPointer<vtkImageData> getFusedVolume();
+
+    /**
+     * \brief Returns the sum of weighted intensities of all added sweeps
+     */
+	vtkSmartPointer<vtkImageData> getAccumulatorVolume();
+
+    /**
+     * \brief Returns the sum of weights of all added sweeps
+     */
+	vtkSmartPointer<vtkImageData> getWeightVolume();
+
+    /**
+     * \brief Returns the origin of the fused grid in the 3D scene
+     */
+	vnl_vector<double> getVolumeOrigin();
+
+    /**
+     * \brief Returns the number of sweeps added to the fusion
+     */
+	int getNumberOfSweeps();
+
+    /**
+     * \brief Set the number of z slices processed by each task
+     */
+	void setSlabThickness(int);
+
+    /**
+     * \brief Set the number of threads used to add a sweep
+     */
+	void setNumberOfThreads(int);
+
+    /**
+     * \brief Remove all sweeps and the output grid
+     */
+	void clear();
+
+    /** A sweep resampled in float buffers, x varies fastest */
+	struct Sweep
+	{
+		std::vector<float> accumulator;
+		std::vector<float> weights;
+		int dimensions[3];
+		double origin[3];
+		double spacing[3];
+	};
+
+    /** The grid where all sweeps are compounded, x varies fastest */
+	struct Grid
+	{
+		std::vector<float> accumulator;
+		std::vector<float> weights;
+		int dimensions[3];
+		double origin[3];
+		double spacing;
+	};
+
+private:
+
+	VolumeFusion();
+
+    /** The compounded grid */
+	Grid grid;
+
+    /** Number of sweeps added */
+	int numberOfSweeps;
+
+    /** Number of z slices of each parallel task */
+	int slabThickness;
+
+    /** Number of threads */
+	int numberOfThreads;
+
+    /**
+     * \brief Accumulate a sweep in the voxels of the grid that it covers
+     */
+	void addSweep(const Sweep &);
+
+    /**
+     * \brief Enlarge the grid so it contains the given bounds
+     */
+	void growGrid(const double *, const double *);
+
+    /**
+     * \brief Copy one buffer of the grid in a new float vtkImageData
+     */
+	vtkSmartPointer<vtkImageData> gridToImage(const std::vector<float> &);
+
+};
+
+#endif // VOLUMEFUSION_H
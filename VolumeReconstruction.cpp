@@ -3,34 +3,100 @@
 #include <vtkMath.h>
 #include <vtkMetaImageWriter.h>
 #include <vnl/vnl_inverse.h>
+#include <itkTimeProbe.h>
 #include <exception>
-#include <time.h>
+
+VolumeReconstruction::VolumeReconstruction()
+{
+	resolution = 1;
+	numberOfThreads = 1;
+	firstSlice = -1;
+	lastSlice = -1;
+}
 
 vtkSmartPointer<vtkImageData> VolumeReconstruction::generateVolume()
 {
 	std::cout<<"Generating Volume Data"<<std::endl;
+
+	int sliceBegin = 0;
+	int sliceEnd = volumeSize[2] - 1;
+
+	if(firstSlice >= 0 && lastSlice >= firstSlice){
+		sliceBegin = firstSlice;
+		sliceEnd = lastSlice;
+		std::cout<<"Generating slices "<<sliceBegin<<" to "<<sliceEnd<<std::endl;
+	}
 	
 
 	vtkSmartPointer<vtkImageData> volumeData = vtkSmartPointer<vtkImageData>::New();
 	volumeData->SetNumberOfScalarComponents(1);
 	volumeData->SetScalarType(VTK_UNSIGNED_CHAR);
 	volumeData->SetOrigin(0,0,0);
-	volumeData->SetDimensions(volumeSize[0],volumeSize[1],volumeSize[2]);
+	volumeData->SetDimensions(volumeSize[0],volumeSize[1],sliceEnd-sliceBegin+1);
 	volumeData->SetSpacing(scale[0]*resolution,scale[0]*resolution,scale[0]*resolution);
 	volumeData->AllocateScalars();
 
+	weightData = vtkSmartPointer<vtkImageData>::New();
+	weightData->SetNumberOfScalarComponents(1);
+	weightData->SetScalarType(VTK_FLOAT);
+	weightData->SetOrigin(0,0,0);
+	weightData->SetDimensions(volumeSize[0],volumeSize[1],sliceEnd-sliceBegin+1);
+	weightData->SetSpacing(scale[0]*resolution,scale[0]*resolution,scale[0]*resolution);
+	weightData->AllocateScalars();
+
 	calcImagePlane();
 	maxDistance = calcMaxDistance();
 
-	std::cout<<"Calculating voxel values"<<std::flush;
-	clock_t begin = clock();
-	
-	for(int i=0; i<volumeSize[0]; i++){
+	std::cout<<"Calculating voxel values with "<<numberOfThreads<<" threads"<<std::flush;
+	itk::TimeProbe clock;
+	clock.Start();
+
+	ThreadStruct threadStruct;
+	threadStruct.reconstructor = this;
+	threadStruct.volumeData = volumeData;
+	threadStruct.sliceBegin = sliceBegin;
+	threadStruct.sliceEnd = sliceEnd;
+
+	itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+	threader->SetNumberOfThreads(numberOfThreads);
+	threader->SetSingleMethod(reconstructThread, &threadStruct);
+	threader->SingleMethodExecute();
+
+	clock.Stop();
+	std::cout<<std::endl<<"Time elapsed: "<< clock.GetMean()*1000<<" ms" <<std::endl;
+
+	return volumeData;
+
+}
+
+ITK_THREAD_RETURN_TYPE VolumeReconstruction::reconstructThread(void * arg)
+{
+	itk::MultiThreader::ThreadInfoStruct * info = static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg);
+	ThreadStruct * threadStruct = static_cast<ThreadStruct *>(info->UserData);
+
+	VolumeReconstruction * reconstructor = threadStruct->reconstructor;
+
+	// each thread computes a range of columns in x
+	int columns = reconstructor->volumeSize[0];
+	int columnBegin = (info->ThreadID*columns)/info->NumberOfThreads;
+	int columnEnd = ((info->ThreadID + 1)*columns)/info->NumberOfThreads;
+
+	reconstructor->reconstructColumns(threadStruct->volumeData, columnBegin, columnEnd,
+									  threadStruct->sliceBegin, threadStruct->sliceEnd, info->ThreadID == 0);
+
+	return ITK_THREAD_RETURN_VALUE;
+}
+
+void VolumeReconstruction::reconstructColumns(vtkImageData * volumeData, int columnBegin, int columnEnd,
+											  int sliceBegin, int sliceEnd, bool showProgress)
+{
+	for(int i=columnBegin; i<columnEnd; i++){
 		
-		std::cout<<"."<<std::flush;
+		if(showProgress)
+			std::cout<<"."<<std::flush;
 
 		for(int j=0; j<volumeSize[1]; j++){
-			for(int k=0; k<volumeSize[2]; k++){
+			for(int k=sliceBegin; k<=sliceEnd; k++){
 
 				double voxel[3];
 				voxel[0] = i*scale[0]*resolution + volumeOrigin[0];
@@ -87,26 +153,22 @@ vtkSmartPointer<vtkImageData> VolumeReconstruction::generateVolume()
 				
 				crossPoints.push_back(crossPointVector);
 
-				double voxelValue = calcVoxelValue(crossPoints, distancePlane, distance);
+				double voxelWeight = 0;
+				double voxelValue = calcVoxelValue(crossPoints, distancePlane, distance, voxelWeight);
 
-				volumeData->SetScalarComponentFromDouble(i,j,k,0,voxelValue);
+				volumeData->SetScalarComponentFromDouble(i,j,k-sliceBegin,0,voxelValue);
+				weightData->SetScalarComponentFromDouble(i,j,k-sliceBegin,0,voxelWeight);
 			}
 		}
 	}
-
-	clock_t end = clock();
-	double diffticks = end - begin;
-	double diffms = (diffticks * 10) / CLOCKS_PER_SEC;
-	std::cout<<std::endl<<"Time elapsed: "<< double(diffms)<<" ms" <<std::endl;
-
-	return volumeData;
-
 }
 
 double VolumeReconstruction::calcVoxelValue(std::vector< vnl_vector<double> > crossPoints, 
-											vnl_vector<double> distancePlane, vnl_vector<double> distance)
+											vnl_vector<double> distancePlane, vnl_vector<double> distance,
+											double &voxelWeight)
 {
 	double voxelValue = 0;
+	double weightSum = 0;
 	int prom = 0;
 	
 	for(int i=0; i<crossPoints.size(); i++){
@@ -146,6 +208,7 @@ double VolumeReconstruction::calcVoxelValue(std::vector< vnl_vector<double> > cr
 
 				pixelValue *= w;
 				voxelValue += pixelValue;
+				weightSum += w;
 
 			}
 		}
@@ -154,6 +217,11 @@ double VolumeReconstruction::calcVoxelValue(std::vector< vnl_vector<double> > cr
 
 	voxelValue /= prom;
 
+	if(prom > 0)
+		voxelWeight = weightSum/prom;
+	else
+		voxelWeight = 0;
+
 	return voxelValue;
 
 }
@@ -251,7 +319,23 @@ void VolumeReconstruction::setVolumeOrigin(vnl_vector<double> volumeOrigin)
     this->volumeOrigin = volumeOrigin;
 }
 
+vtkSmartPointer<vtkImageData> VolumeReconstruction::getWeightVolume()
+{
+    return this->weightData;
+}
+
 void VolumeReconstruction::setResolution(int resolution)
 {
     this->resolution = resolution;
 }
+
+void VolumeReconstruction::setNumberOfThreads(int numberOfThreads)
+{
+    this->numberOfThreads = numberOfThreads > 0 ? numberOfThreads : 1;
+}
+
+void VolumeReconstruction::setSlab(int firstSlice, int lastSlice)
+{
+    this->firstSlice = firstSlice;
+    this->lastSlice = lastSlice;
+}
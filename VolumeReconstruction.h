@@ -8,6 +8,8 @@
 #include <vnl/vnl_matrix.h>
 #include <vnl/vnl_vector.h>
 
+#include <itkMultiThreader.h>
+
 #include <math.h>
 #include <vector>
 
@@ -70,13 +72,32 @@ public:
      */
     void setResolution(int);
 
+    /**
+     * \brief Set the number of threads, each one computes a range of columns of the volume
+     */
+    void setNumberOfThreads(int);
+
+    /**
+     * \brief Generate only the slices firstSlice to lastSlice (z axis) of the volume.
+     * The output volume has lastSlice-firstSlice+1 slices. Used to split the volume between workers
+     */
+    void setSlab(int, int);
+
     /**
      * \brief Returns the new volume data with the voxel based method
      */
 	vtkSmartPointer<vtkImageData> generateVolume();
 
+    /**
+     * \brief Returns the weight of each voxel of the last generated volume,
+     * zero where no image contributed. Used by VolumeFusion.h to compound sweeps
+     */
+	vtkSmartPointer<vtkImageData> getWeightVolume();
+
 private:
 
+	VolumeReconstruction();
+
      /** Size of the volume */
 	vnl_vector<double> volumeSize;
 
@@ -108,6 +129,16 @@ private:
         /** The resolution of the volume*/
         int resolution;
 
+    /** Number of threads to compute the voxel values */
+	int numberOfThreads;
+
+    /** First and last slice to generate, -1 to generate the whole volume */
+	int firstSlice;
+	int lastSlice;
+
+    /** The weight of each voxel of the generated volume */
+	vtkSmartPointer<vtkImageData> weightData;
+
     /**
      * \brief Compute the plane equation for each image
      */
@@ -120,9 +151,28 @@ private:
 	double calcMaxDistance();
 
 
+    /** Data shared by the reconstruction threads */
+	struct ThreadStruct
+	{
+		VolumeReconstruction * reconstructor;
+		vtkImageData * volumeData;
+		int sliceBegin;
+		int sliceEnd;
+	};
+
+    /**
+     * \brief Thread callback, computes the columns of one thread
+     */
+	static ITK_THREAD_RETURN_TYPE reconstructThread(void *);
+
+    /**
+     * \brief Computes the voxel values of the columns columnBegin to columnEnd-1
+     */
+	void reconstructColumns(vtkImageData *, int, int, int, int, bool);
+
     /**
      * \brief Computes the voxel value using three lineal interpolation
      */
-	double calcVoxelValue(std::vector< vnl_vector<double> >, vnl_vector<double>, vnl_vector<double>);
+	double calcVoxelValue(std::vector< vnl_vector<double> >, vnl_vector<double>, vnl_vector<double>, double &);
 
 };
@@ -0,0 +1,157 @@
+#include "VolumeReconstructionJob.h"
+
+#include <vtkMetaImageReader.h>
+#include <vtkMetaImageWriter.h>
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <exception>
+
+VolumeReconstructionJob::VolumeReconstructionJob()
+{
+	resolution = 1;
+	firstSlice = 0;
+	lastSlice = 0;
+}
+
+bool VolumeReconstructionJob::write(std::string filename)
+{
+	std::ofstream file(filename.c_str());
+	if(!file.is_open()){
+		std::cout<<"Could not open job file "<<filename<<std::endl;
+		return false;
+	}
+
+	file<<std::setprecision(17);
+	file<<"origin "<<volumeOrigin[0]<<" "<<volumeOrigin[1]<<" "<<volumeOrigin[2]<<"\n";
+	file<<"size "<<volumeSize[0]<<" "<<volumeSize[1]<<" "<<volumeSize[2]<<"\n";
+	file<<"scale "<<scale[0]<<" "<<scale[1]<<"\n";
+	file<<"resolution "<<resolution<<"\n";
+	file<<"slab "<<firstSlice<<" "<<lastSlice<<"\n";
+	file<<"output "<<outputFilename<<"\n";
+	file<<"images "<<imageFilenames.size()<<"\n";
+
+	for(unsigned int i=0; i<imageFilenames.size(); i++){
+
+		file<<imageFilenames.at(i)<<"\n";
+
+		for(int r=0; r<4; r++)
+			for(int c=0; c<4; c++)
+				file<<transformStack.at(i)[r][c]<<(c<3 ? " " : "\n");
+
+		for(int b=0; b<4; b++)
+			file<<imageBoundsXStack.at(i)[b]<<(b<3 ? " " : "\n");
+		for(int b=0; b<4; b++)
+			file<<imageBoundsYStack.at(i)[b]<<(b<3 ? " " : "\n");
+		for(int b=0; b<4; b++)
+			file<<imageBoundsZStack.at(i)[b]<<(b<3 ? " " : "\n");
+	}
+
+	file.close();
+	return true;
+}
+
+bool VolumeReconstructionJob::read(std::string filename)
+{
+	std::ifstream file(filename.c_str());
+	if(!file.is_open()){
+		std::cout<<"Could not open job file "<<filename<<std::endl;
+		return false;
+	}
+
+	std::string tag;
+	unsigned int numberOfImages = 0;
+
+	volumeOrigin.set_size(3);
+	volumeSize.set_size(3);
+	scale.set_size(2);
+
+	file>>tag>>volumeOrigin[0]>>volumeOrigin[1]>>volumeOrigin[2];
+	file>>tag>>volumeSize[0]>>volumeSize[1]>>volumeSize[2];
+	file>>tag>>scale[0]>>scale[1];
+	file>>tag>>resolution;
+	file>>tag>>firstSlice>>lastSlice;
+	file>>tag>>std::ws;
+	std::getline(file, outputFilename);
+	file>>tag>>numberOfImages;
+
+	imageFilenames.clear();
+	transformStack.clear();
+	imageBoundsXStack.clear();
+	imageBoundsYStack.clear();
+	imageBoundsZStack.clear();
+
+	for(unsigned int i=0; i<numberOfImages; i++){
+
+		std::string imageFilename;
+		file>>std::ws;
+		std::getline(file, imageFilename);
+
+		vnl_matrix<double> transform(4,4);
+		for(int r=0; r<4; r++)
+			for(int c=0; c<4; c++)
+				file>>transform[r][c];
+
+		vnl_vector<double> boundsX(4);
+		vnl_vector<double> boundsY(4);
+		vnl_vector<double> boundsZ(4);
+		for(int b=0; b<4; b++)
+			file>>boundsX[b];
+		for(int b=0; b<4; b++)
+			file>>boundsY[b];
+		for(int b=0; b<4; b++)
+			file>>boundsZ[b];
+
+		imageFilenames.push_back(imageFilename);
+		transformStack.push_back(transform);
+		imageBoundsXStack.push_back(boundsX);
+		imageBoundsYStack.push_back(boundsY);
+		imageBoundsZStack.push_back(boundsZ);
+	}
+
+	if(file.fail()){
+		std::cout<<"Malformed job file "<<filename<<std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::vector< vtkSmartPointer<vtkImageData> > VolumeReconstructionJob::readImages()
+{
+	std::vector< vtkSmartPointer<vtkImageData> > images;
+	images.reserve(imageFilenames.size());
+
+	for(unsigned int i=0; i<imageFilenames.size(); i++)
+		images.push_back(readImage(imageFilenames.at(i)));
+
+	return images;
+}
+
+vtkSmartPointer<vtkImageData> VolumeReconstructionJob::readImage(std::string filename)
+{
+	vtkSmartPointer<vtkMetaImageReader> reader = vtkSmartPointer<vtkMetaImageReader>::New();
+	reader->SetFileName(filename.c_str());
+	reader->Update();
+
+	vtkSmartPointer<vtkImageData> image = reader->GetOutput();
+	return image;
+}
+
+void VolumeReconstructionJob::writeImage(vtkSmartPointer<vtkImageData> image, std::string filename)
+{
+	std::string rawFilename = filename.substr(0, filename.rfind(".mhd")) + ".raw";
+
+	vtkSmartPointer<vtkMetaImageWriter> writer = vtkSmartPointer<vtkMetaImageWriter>::New();
+	writer->SetFileName(filename.c_str());
+	writer->SetRAWFileName(rawFilename.c_str());
+	writer->SetCompression(false);
+	writer->SetInputConnection(image->GetProducerPort());
+
+	try{
+	writer->Write();
+	}catch( std::exception& e){
+		std::cout<<e.what()<<std::endl;
+	}
+}
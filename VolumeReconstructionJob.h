@@ -0,0 +1,82 @@
+#ifndef VOLUMERECONSTRUCTIONJOB_H
+#define VOLUMERECONSTRUCTIONJOB_H
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_vector.h>
+
+#include <string>
+#include <vector>
+
+//!Description of a slab reconstruction for a worker process
+/*!
+  This class contains everything a worker needs to reconstruct one slab of a volume with
+  VolumeReconstruction.h: the volume geometry, the slab, and for each image that intersects
+  the slab its .mhd file, its transformation and its bounds. It is written in a text file by
+  DistributedVolumeReconstruction.h and read by the VolumeReconstructionWorker program.
+*/
+class VolumeReconstructionJob
+{
+
+public:
+
+    /**
+     * \brief Constructor
+     */
+	static VolumeReconstructionJob *New()
+	{
+			return new VolumeReconstructionJob;
+	}
+
+    /**
+     * \brief Write the job in a text file
+     * \param[out] false if the file could not be written
+     */
+	bool write(std::string);
+
+    /**
+     * \brief Read the job from a text file
+     * \param[out] false if the file could not be read
+     */
+	bool read(std::string);
+
+    /**
+     * \brief Read the images of the job
+     */
+	std::vector< vtkSmartPointer<vtkImageData> > readImages();
+
+    /**
+     * \brief Read a .mhd file
+     */
+	static vtkSmartPointer<vtkImageData> readImage(std::string);
+
+    /**
+     * \brief Write a .mhd and .raw file
+     * \param[in] image, mhd filename
+     */
+	static void writeImage(vtkSmartPointer<vtkImageData>, std::string);
+
+	vnl_vector<double> volumeOrigin; ///<Origin of the whole volume
+	vnl_vector<double> volumeSize; ///<Size of the whole volume
+	vnl_vector<double> scale; ///<Scale of the images
+	int resolution; ///<Resolution of the volume
+	int firstSlice; ///<First slice of the slab
+	int lastSlice; ///<Last slice of the slab
+
+	std::string outputFilename; ///<mhd file for the slab, the weights are saved with a _weights suffix
+
+	std::vector< std::string > imageFilenames; ///<mhd file of each image
+	std::vector< vnl_matrix<double> > transformStack; ///<Transformation of each image
+	std::vector< vnl_vector<double> > imageBoundsXStack; ///<Bounds in x of each image
+	std::vector< vnl_vector<double> > imageBoundsYStack; ///<Bounds in y of each image
+	std::vector< vnl_vector<double> > imageBoundsZStack; ///<Bounds in z of each image
+
+private:
+
+	VolumeReconstructionJob();
+
+};
+
+#endif // VOLUMERECONSTRUCTIONJOB_H
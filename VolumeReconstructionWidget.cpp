@@ -1,15 +1,25 @@
 #include "VolumeReconstructionWidget.h"
 #include "ui_VolumeReconstructionWidget.h"
 #include "VolumeReconstruction.h"
+#include "VolumeFusion.h"
+#include "VolumeCache.h"
+#include "DistributedVolumeReconstruction.h"
+#include "ReconstructionCostModel.h"
+#include "StreamingVolumeReconstruction.h"
 #include "vtkMetaImageWriter.h"
 
 #include <QString>
+#include <QThread>
 
 VolumeReconstructionWidget::VolumeReconstructionWidget(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::VolumeReconstructionWidget)
 {
 
+	mainWindow = 0;
+	roiScale = 1;
+	costModel = ReconstructionCostModel::New();
+
 	ui->setupUi(this);
 	this->setAttribute(Qt::WA_DeleteOnClose);
         ui->resolution->show();
@@ -20,12 +30,14 @@ VolumeReconstructionWidget::VolumeReconstructionWidget(QWidget *parent) :
 
 VolumeReconstructionWidget::~VolumeReconstructionWidget()
 {
+    delete costModel;
     delete ui;
 }
 
 void VolumeReconstructionWidget::setMainWindow(MainWindow* mainwindow)
 {
     this->mainWindow = mainwindow;
+    updatePredictedTime();
 }
 
 
@@ -33,28 +45,80 @@ void VolumeReconstructionWidget::generate()
 {
 
 	volumeData = vtkSmartPointer<vtkImageData>::New();
+	weightData = NULL;
 
 	if(ui->pixelMethod->isChecked()){
-		
-		calcImageCoords();
-		calcVolumeSize(true);
+
+		// the images are read again from disk, only a few of them are decoded at the same time
+		if(roiScale < 1)
+			std::cout<<"The region of interest is only used by the voxel based method"<<std::endl;
+		StreamingVolumeReconstruction * reconstructor = StreamingVolumeReconstruction::New();
+
+		scale = mainWindow->getDisplayWidget()->getTransformScale();
+
+		reconstructor->setImageFilenames(mainWindow->getVolumeImagesFilenames());
+		reconstructor->setTransformStack(transformStack);
+		reconstructor->setScale(scale);
+		reconstructor->setResolution(res);
+
+		if(reconstructor->calcVolumeBounds()){
+			volumeData = reconstructor->generateVolume();
+			weightData = reconstructor->getWeightVolume();
+			volumeOrigin = reconstructor->getVolumeOrigin();
+		}
+
+		delete reconstructor;
 
 	}else if(ui->voxelMethod->isChecked()){
 		
 		calcImageBounds();
 		calcVolumeSize(false);
 
-		VolumeReconstruction * reconstructor = VolumeReconstruction::New();
+		VolumeCache * cache = VolumeCache::New();
+		// the workers get all the images, their stitched slabs are the volume of a single process
+		QString key = cache->computeKey(volumeImageStack, transformStack, scale, res,
+										"VoxelBasedMethod", volumeOrigin, volumeSize);
 
-		reconstructor->setImageBoundsStack(imageBoundsXStack, imageBoundsYStack, imageBoundsZStack);
-		reconstructor->setScale(scale);
-		reconstructor->setTransformStack(transformStack);
-		reconstructor->setVolumeImageStack(volumeImageStack);
-		reconstructor->setVolumeOrigin(volumeOrigin);
-		reconstructor->setVolumeSize(volumeSize);
-                reconstructor->setResolution(res);
-		
-		volumeData = reconstructor->generateVolume();
+		if(!cache->load(key, volumeData, weightData)){
+
+			if(ui->useWorkers->isChecked()){
+
+				DistributedVolumeReconstruction * reconstructor = DistributedVolumeReconstruction::New();
+
+				reconstructor->setImageBoundsStack(imageBoundsXStack, imageBoundsYStack, imageBoundsZStack);
+				reconstructor->setScale(scale);
+				reconstructor->setTransformStack(transformStack);
+				reconstructor->setVolumeImageStack(volumeImageStack);
+				reconstructor->setVolumeOrigin(volumeOrigin);
+				reconstructor->setVolumeSize(volumeSize);
+				reconstructor->setResolution(res);
+
+				volumeData = reconstructor->generateVolume();
+				weightData = reconstructor->getWeightVolume();
+				delete reconstructor;
+
+			}else{
+
+				VolumeReconstruction * reconstructor = VolumeReconstruction::New();
+
+				reconstructor->setImageBoundsStack(imageBoundsXStack, imageBoundsYStack, imageBoundsZStack);
+				reconstructor->setScale(scale);
+				reconstructor->setTransformStack(transformStack);
+				reconstructor->setVolumeImageStack(volumeImageStack);
+				reconstructor->setVolumeOrigin(volumeOrigin);
+				reconstructor->setVolumeSize(volumeSize);
+				reconstructor->setResolution(res);
+				reconstructor->setNumberOfThreads(QThread::idealThreadCount());
+
+				volumeData = reconstructor->generateVolume();
+				weightData = reconstructor->getWeightVolume();
+				delete reconstructor;
+			}
+
+			cache->store(key, volumeData, weightData);
+		}
+
+		delete cache;
 
 	}
 
@@ -72,6 +136,14 @@ void VolumeReconstructionWidget::setVolumeImageStack(std::vector< vtkSmartPointe
     this->volumeImageStack = volumeImageStack;
 }
 
+void VolumeReconstructionWidget::setStreamingOnly()
+{
+    ui->pixelMethod->setChecked(true);
+    ui->voxelMethod->setEnabled(false);
+    ui->useWorkers->setEnabled(false);
+    ui->autoResolution->setEnabled(false);
+}
+
 void VolumeReconstructionWidget::calcImageCoords()
 {
 	vnl_vector<double> point;
@@ -122,6 +194,10 @@ void VolumeReconstructionWidget::calcImageBounds()
 {
 	std::cout<<"Calculating images bounds"<<std::endl;
 
+	imageBoundsXStack.clear();
+	imageBoundsYStack.clear();
+	imageBoundsZStack.clear();
+
 	for(int i=0; i<volumeImageStack.size(); i++){	
 
 		int * imageSize = volumeImageStack.at(i)->GetDimensions();		
@@ -240,6 +316,16 @@ void VolumeReconstructionWidget::calcVolumeSize(bool usePixelMethod)
 	volumeFinal[2] = zMax.max_value();
 	std::cout<<"Volume final coords: "<<volumeFinal[0]<<","<<volumeFinal[1]<<","<<volumeFinal[2]<<std::endl;
 
+	if(roiScale < 1){
+		for(int d=0; d<3; d++){
+			double center = (volumeOrigin[d] + volumeFinal[d])/2;
+			double halfExtent = roiScale*(volumeFinal[d] - volumeOrigin[d])/2;
+			volumeOrigin[d] = center - halfExtent;
+			volumeFinal[d] = center + halfExtent;
+		}
+		std::cout<<"Region of interest: "<<roiScale*100<<"% of the volume extent"<<std::endl;
+	}
+
 	volumeSize.set_size(3);
 	volumeSize[0] = vtkMath::Round((volumeFinal[0] - volumeOrigin[0])/(scale[0]*res));
 	volumeSize[1] = vtkMath::Round((volumeFinal[1] - volumeOrigin[1])/(scale[0]*res));
@@ -285,7 +371,89 @@ void VolumeReconstructionWidget::save()
 	}
 }
 
+void VolumeReconstructionWidget::fuse()
+{
+	if(weightData.GetPointer() == NULL){
+		QErrorMessage errorMessage;
+		errorMessage.showMessage(
+			"No volume generated, </ br> please generate a volume with the voxel based method first");
+		errorMessage.exec();
+		return;
+	}
+
+	VolumeFusion * fusion = mainWindow->getVolumeFusion();
+	fusion->addVolume(volumeData, weightData, volumeOrigin);
+
+	QString str;
+	mainWindow->addLogText("Sweeps in fused volume: <b>" + str.setNum(fusion->getNumberOfSweeps()) + "</b>");
+
+	volumeData = fusion->getFusedVolume();
+	volumeOrigin = fusion->getVolumeOrigin();
+	weightData = NULL;
+
+	mainWindow->getDisplayWidget()->setAndDisplayVolume(volumeData);
+	mainWindow->getDisplayWidget()->setVolumeOrigin(volumeOrigin);
+}
+
 void VolumeReconstructionWidget::setResolution(int idx)
 {
+    // a resolution chosen by hand is for the whole volume, the region of autoResolution() is dropped
     res = idx;
+    roiScale = 1;
+    updatePredictedTime();
+}
+
+void VolumeReconstructionWidget::updatePredictedTime()
+{
+	if(mainWindow == 0 || volumeImageStack.size() < 2 || transformStack.size() != volumeImageStack.size())
+		return;
+
+	calcImageBounds();
+	calcVolumeSize(false);
+
+	int threads = QThread::idealThreadCount();
+
+	if(!costModel->isCalibrated()){
+		costModel->setImageBoundsStack(imageBoundsXStack, imageBoundsYStack, imageBoundsZStack);
+		costModel->setScale(scale);
+		costModel->setTransformStack(transformStack);
+		costModel->setVolumeImageStack(volumeImageStack);
+		costModel->calibrate(volumeOrigin, volumeFinal, threads);
+	}
+
+	double predictedTime = costModel->predictTime(volumeOrigin, volumeFinal, res, 1, threads);
+
+	QString str;
+	QString text = "Predicted time: " + str.setNum(predictedTime, 'f', 1) + " s";
+	if(roiScale < 1)
+		text += " (ROI " + str.setNum(roiScale*100, 'f', 0) + "%)";
+
+	ui->predictedTime->setText(text);
+}
+
+void VolumeReconstructionWidget::autoResolution()
+{
+	if(mainWindow == 0 || volumeImageStack.size() < 2)
+		return;
+
+	// the budget is for the whole volume
+	roiScale = 1;
+	updatePredictedTime();
+
+	if(!costModel->isCalibrated())
+		return;
+
+	ReconstructionCostModel::Parameters parameters = costModel->selectParameters(
+		ui->timeBudget->value(), volumeOrigin, volumeFinal, QThread::idealThreadCount());
+
+	// the slider resets the region, it is set after the resolution
+	ui->resolution->setValue(parameters.resolution);
+	roiScale = parameters.roiScale;
+
+	QString str;
+	mainWindow->addLogText("Selected resolution: <b>" + str.setNum(parameters.resolution) + "</b>");
+	if(roiScale < 1)
+		mainWindow->addLogText("Region of interest: <b>" + str.setNum(roiScale*100, 'f', 0) + "%</b>");
+
+	updatePredictedTime();
 }
\ No newline at end of file
@@ -19,6 +19,8 @@
 #include <vnl/vnl_matrix.h>
 #include <vnl/vnl_vector.h>
 
+class ReconstructionCostModel;
+
 namespace Ui {
 class VolumeReconstructionWidget;
 }
@@ -46,6 +48,9 @@ public:
 
 	/** Set the image data stack */
 	void setVolumeImageStack(std::vector< vtkSmartPointer<vtkImageData> >);
+
+	/** Only allow the pixel based method, the images are not loaded and are streamed from disk */
+	void setStreamingOnly();
     
 private:
     Ui::VolumeReconstructionWidget *ui;
@@ -79,6 +84,9 @@ private:
     /** Data of the volume */
 	vtkSmartPointer<vtkImageData> volumeData;
 
+    /** Weight of each voxel of the volume data */
+	vtkSmartPointer<vtkImageData> weightData;
+
     /** Main volume properties */
 	vtkSmartPointer<vtkVolumeProperty> volumeProperty;
 
@@ -97,6 +105,12 @@ private:
     /** The relation between voxel:pixel, example res:1*/    
         int res;
 
+    /** Fraction of the volume extent reconstructed in each axis, centered */
+	double roiScale;
+
+    /** Predicts the reconstruction time on this machine */
+	ReconstructionCostModel * costModel;
+
     /**
      * \brief Computes every pixel coord of each image in the 3D space
      */
@@ -134,6 +148,12 @@ private:
      */
 	void displayVolume();
 
+    /**
+     * \brief Show the predicted reconstruction time for the current resolution,
+     * the cost model is calibrated the first time
+     */
+	void updatePredictedTime();
+
 private slots:
 
     /**
@@ -151,6 +171,16 @@ private slots:
      */
     void setResolution(int idx);
 
+    /**
+     * \brief Adds the generated volume to the fused volume of the main window and displays it
+     */
+    void fuse();
+
+    /**
+     * \brief Select the finest resolution and region of interest that fit in the time budget
+     */
+    void autoResolution();
+
 };
 
 #endif // VOLUMERECONSTRUCTIONWIDGET_H
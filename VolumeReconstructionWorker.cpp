@@ -0,0 +1,49 @@
+#include "VolumeReconstruction.h"
+#include "VolumeReconstructionJob.h"
+
+#include <iostream>
+
+/*
+  Worker process of DistributedVolumeReconstruction.h
+  Reconstructs the slab described in a job file and writes it next to it.
+
+  Usage: VolumeReconstructionWorker jobFile
+*/
+int main(int argc, char * argv[])
+{
+	if(argc < 2){
+		std::cout<<"Usage: "<<argv[0]<<" jobFile"<<std::endl;
+		return 1;
+	}
+
+	VolumeReconstructionJob * job = VolumeReconstructionJob::New();
+
+	std::cout<<"Reading job "<<argv[1]<<std::endl;
+	if(!job->read(argv[1]))
+		return 1;
+
+	std::cout<<"Loading "<<job->imageFilenames.size()<<" images"<<std::endl;
+
+	VolumeReconstruction * reconstructor = VolumeReconstruction::New();
+
+	reconstructor->setImageBoundsStack(job->imageBoundsXStack, job->imageBoundsYStack, job->imageBoundsZStack);
+	reconstructor->setScale(job->scale);
+	reconstructor->setTransformStack(job->transformStack);
+	reconstructor->setVolumeImageStack(job->readImages());
+	reconstructor->setVolumeOrigin(job->volumeOrigin);
+	reconstructor->setVolumeSize(job->volumeSize);
+	reconstructor->setResolution(job->resolution);
+	reconstructor->setSlab(job->firstSlice, job->lastSlice);
+
+	vtkSmartPointer<vtkImageData> slab = reconstructor->generateVolume();
+
+	std::string weightsFilename = job->outputFilename.substr(0, job->outputFilename.rfind(".mhd")) + "_weights.mhd";
+
+	VolumeReconstructionJob::writeImage(reconstructor->getWeightVolume(), weightsFilename);
+	VolumeReconstructionJob::writeImage(slab, job->outputFilename);
+
+	delete reconstructor;
+	delete job;
+
+	return 0;
+}
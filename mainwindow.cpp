@@ -5,6 +5,7 @@
 #include "VolumeReconstructionWidget.h"
 #include "CropImagesWidget.h"
 #include "Scene3D.h"
+#include "VolumeFusion.h"
 
 #include <QVBoxLayout>
 #include <vtkEventQtSlotConnect.h>
@@ -30,10 +31,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
   // create the connections 
   Connections = vtkSmartPointer<vtkEventQtSlotConnect>::New();
 
+  this->volumeFusion = VolumeFusion::New();
 }
 
 MainWindow::~MainWindow()
 {
+  delete volumeFusion;
   delete ui;
 }
 
@@ -77,11 +80,8 @@ void MainWindow::addImages()
     }
 }
 
-void MainWindow::openVolumeData()
+bool MainWindow::selectVolumeData()
 {
-
-	std::cout<<"Loading Volume Data"<<std::endl;
-
     this->volumeImagesFilenames = QFileDialog::getOpenFileNames(this, tr("Open Volume Images"), 
 		QDir::currentPath(), tr("Image Files (*.png *.jpg *.bmp)"));
 	
@@ -93,8 +93,16 @@ void MainWindow::openVolumeData()
 	
 	this->volumeCalibrationData  = QFileDialog::getOpenFileName(this, tr("Open Volume Calibration Data"), 
 		QDir::currentPath(), tr("Txt (*.txt *.doc)"));
-    
-	if (!volumeImagesFilenames.isEmpty())
+
+	return !volumeImagesFilenames.isEmpty();
+}
+
+void MainWindow::openVolumeData()
+{
+
+	std::cout<<"Loading Volume Data"<<std::endl;
+
+	if (selectVolumeData())
       {
             this->displayWidget->setAndDisplayVolumeImages(volumeImagesFilenames, 
 				volumeRotationData, volumeTranslationData, volumeCalibrationData);
@@ -107,6 +115,16 @@ void MainWindow::openVolumeData()
 
 }
 
+void MainWindow::openVolumeDataFromDisk()
+{
+
+	std::cout<<"Loading Volume Data Transformations"<<std::endl;
+
+	if (selectVolumeData())
+		this->displayWidget->setVolumePoses(volumeImagesFilenames,
+			volumeRotationData, volumeTranslationData, volumeCalibrationData);
+}
+
 void MainWindow::openVolume()
 {
 
@@ -192,7 +210,12 @@ void MainWindow::volumeReconstruction()
 {
 
 	std::cout<<"VOLUME RECONSTRUCTION"<<std::endl<<std::endl;
-    if (!displayWidget->getVolumeImageStack().empty())
+
+	// the images opened from disk are only read by the pixel based method
+	bool imagesOnDisk = displayWidget->getVolumeImageStack().empty() && !volumeImagesFilenames.isEmpty()
+		&& displayWidget->getTransformStack().size() == volumeImagesFilenames.size();
+
+    if (!displayWidget->getVolumeImageStack().empty() || imagesOnDisk)
       {
        VolumeReconstructionWidget * volumeReconstruction = new VolumeReconstructionWidget();
 
@@ -205,6 +228,10 @@ void MainWindow::volumeReconstruction()
            volumeReconstruction->setVolumeImageStack(displayWidget->getVolumeImageStack());
 		   volumeReconstruction->setTransformStack(displayWidget->getTransformStack());
 		}
+		else if (imagesOnDisk){
+		   volumeReconstruction->setTransformStack(displayWidget->getTransformStack());
+		   volumeReconstruction->setStreamingOnly();
+		}
 
         volumeReconstruction->setMainWindow(this);
         volumeReconstruction->show();
@@ -269,6 +296,16 @@ QVTKImageWidget* MainWindow::getDisplayWidget()
   return this->displayWidget;
 }
 
+VolumeFusion* MainWindow::getVolumeFusion()
+{
+  return this->volumeFusion;
+}
+
+QStringList MainWindow::getVolumeImagesFilenames()
+{
+  return this->volumeImagesFilenames;
+}
+
 
 void MainWindow::addLogText(QString str)
 {
@@ -9,6 +9,7 @@
 
 
 class QAction;
+class VolumeFusion;
 
 namespace Ui
 {
@@ -34,6 +35,18 @@ public:
    */
   QVTKImageWidget* getDisplayWidget();
 
+  /**
+   * \brief return the fusion of all the reconstructed sweeps
+   * \param[out] this volume fusion
+   */
+  VolumeFusion* getVolumeFusion();
+
+  /**
+   * \brief return the filenames of the loaded volume images
+   * \param[out] the filenames in acquisition order
+   */
+  QStringList getVolumeImagesFilenames();
+
 
 
 
@@ -66,9 +79,18 @@ private:
    */
   QVTKImageWidget *displayWidget;
 
+  /** \brief Compounds the volumes reconstructed in this session */
+  VolumeFusion *volumeFusion;
+
 
   vtkSmartPointer<vtkEventQtSlotConnect> Connections;
 
+  /**
+   * \brief Ask for the image, rotation, translation and calibration parameters file names
+   * \param[out] false if no image was selected
+   */
+  bool selectVolumeData();
+
 private slots:
 
   /**
@@ -96,6 +118,12 @@ private slots:
    * \brief Set the image, rotation, translation and calibration parameters file name
    */
   void openVolumeData();
+
+  /**
+   * \brief Set the volume data file names and the image transformations without loading the
+   * images, the volume is reconstructed streaming the images from disk
+   */
+  void openVolumeDataFromDisk();
   
   /**
    * \brief Print message in logger